@@ -0,0 +1,311 @@
+/*******************************************************************************************
+ * fungi-bench.cpp
+ *******************************************************************************************
+ *
+ * benchmarks the sequential and parallel fungi simulations over a matrix of grid sizes,
+ * time steps, and thread counts, and writes the results in the layout of scalability.tsv
+ *
+ * each configuration is run a few times untimed (warmups) and then a fixed number of timed
+ * repetitions, all with fixed seeds so that every run of the benchmark simulates the same grids;
+ * the time reported by the engines themselves is used, so process startup is not counted
+ *
+ * strong scaling: every thread count runs the same grid, and
+ *      speedup = sequential time / parallel time, efficiency = speedup / threads
+ * weak scaling: the grid grows with the thread count so each thread has as many cells as the
+ *      sequential run (sides scale by the square root of the threads), and
+ *      efficiency = sequential time / parallel time, speedup = efficiency * threads
+ *
+ * the engines must be built with DEBUG and COLOR disabled so that they only print their runtime
+ *
+*/
+
+/* LIBRARIES */
+    #include <stdlib.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <ctype.h>
+    #include <math.h>
+    #include <vector>
+    #include <algorithm>
+
+/* UNIVERSAL CONSTANTS */
+    // defaults for the benchmark matrix
+    #define DEFAULT_SIZES "100,250,500"  // grid side lengths (grids are square)
+    #define DEFAULT_STEPS "100"          // time steps per run
+    #define DEFAULT_THREADS "1,2,4,8"    // thread counts for the parallel engine
+    #define DEFAULT_REPETITIONS 5        // timed runs per configuration
+    #define DEFAULT_WARMUPS 1            // untimed runs per configuration
+    #define DEFAULT_SEED 12345           // seed of the first repetition (repetition k uses seed + k)
+
+    // default engine paths
+    #define SEQ_ENGINE "./seq.fungi"
+    #define OMP_ENGINE "./omp.fungi"
+
+    // scaling modes
+    #define STRONG 1
+    #define WEAK 2
+
+/* FUNCTION DECLARATIONS */
+void getArguments(int argc, char *argv[], std::vector<int> * sizes, std::vector<int> * steps, std::vector<int> * threads, int * REPETITIONS, int * WARMUPS, long * SEED, int * MODE, const char ** output_path, const char ** seq_engine, const char ** omp_engine);
+std::vector<int> parseList(char *list, const char *option, char *program);
+double runEngine(const char * engine, int size, int time_steps, int threads, long seed);
+void benchmark(const char * engine, int size, int time_steps, int threads, int * REPETITIONS, int * WARMUPS, long * SEED, double * median, double * stddev);
+void writeRow(FILE * output, const char * threads, int size, int time_steps, double median, double stddev, double speedup, double efficiency, const char * scaling);
+
+/* main */
+int main(int argc, char **argv){
+
+    // declare variables
+    std::vector<int> sizes, steps, threads;  // benchmark matrix
+    int REPETITIONS, WARMUPS, MODE;  // hold command line arguments
+    long SEED;  // seed of the first repetition
+    const char *output_path, *seq_engine, *omp_engine;  // where to write results and which engines to run
+    FILE *output;  // results file
+    double seq_median, seq_stddev;  // sequential time at the current size
+    double omp_median, omp_stddev;  // parallel time at the current size and thread count
+    char thread_label[16];  // threads column of a row
+
+    // parse command line arguments
+    getArguments(argc, argv, &sizes, &steps, &threads, &REPETITIONS, &WARMUPS, &SEED, &MODE, &output_path, &seq_engine, &omp_engine);
+
+    // open the results file
+    output = (output_path == NULL) ? stdout : fopen(output_path, "w");
+    if (output == NULL) {
+        fprintf(stderr, "could not open %s for writing\n", output_path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(output, "threads\tproblem size\ttime\tstddev\ttime steps\tcells per second\tspeedup\tefficiency\tscaling\n");
+
+    for (int time_steps : steps) {  // for each number of time steps...
+        for (int size : sizes) {  // ...and each grid size...
+
+            // sequential reference
+            benchmark(seq_engine, size, time_steps, 0, &REPETITIONS, &WARMUPS, &SEED, &seq_median, &seq_stddev);
+            writeRow(output, "seq", size, time_steps, seq_median, seq_stddev, 1.0, 1.0, "reference");
+
+            // strong scaling: same grid, more threads
+            if (MODE & STRONG) {
+                for (int thread_count : threads) {
+                    benchmark(omp_engine, size, time_steps, thread_count, &REPETITIONS, &WARMUPS, &SEED, &omp_median, &omp_stddev);
+                    snprintf(thread_label, sizeof(thread_label), "%d", thread_count);
+                    writeRow(output, thread_label, size, time_steps, omp_median, omp_stddev, seq_median / omp_median, seq_median / omp_median / thread_count, "strong");
+                }
+            }
+
+            // weak scaling: same cells per thread
+            if (MODE & WEAK) {
+                for (int thread_count : threads) {
+                    int scaled_size = (int)lround(size * sqrt((double)thread_count));
+                    benchmark(omp_engine, scaled_size, time_steps, thread_count, &REPETITIONS, &WARMUPS, &SEED, &omp_median, &omp_stddev);
+                    snprintf(thread_label, sizeof(thread_label), "%d", thread_count);
+                    writeRow(output, thread_label, scaled_size, time_steps, omp_median, omp_stddev, thread_count * seq_median / omp_median, seq_median / omp_median, "weak");
+                }
+            }
+        }
+    }
+
+    // close the results file
+    if (output != stdout) { fclose(output); }
+
+    // return statement
+    return 0;
+
+}
+
+/* getArguments() */
+/* fetches and stores command line arguments for the benchmark matrix, repetitions, seed, scaling mode, output file, and engines */
+void getArguments(int argc, char *argv[], std::vector<int> * sizes, std::vector<int> * steps, std::vector<int> * threads, int * REPETITIONS, int * WARMUPS, long * SEED, int * MODE, const char ** output_path, const char ** seq_engine, const char ** omp_engine) {
+
+    // initialize variables
+    int c;
+    char default_sizes[] = DEFAULT_SIZES;
+    char default_steps[] = DEFAULT_STEPS;
+    char default_threads[] = DEFAULT_THREADS;
+    char *size_list = default_sizes;
+    char *step_list = default_steps;
+    char *thread_list = default_threads;
+    *REPETITIONS = DEFAULT_REPETITIONS;
+    *WARMUPS = DEFAULT_WARMUPS;
+    *SEED = DEFAULT_SEED;
+    *MODE = STRONG;
+    *output_path = NULL;
+    *seq_engine = SEQ_ENGINE;
+    *omp_engine = OMP_ENGINE;
+
+    // retrieve command line arguments
+    while ((c = getopt (argc, argv, "r:s:t:n:w:x:m:o:S:P:")) != -1) {
+        switch (c) {
+            case 'r':
+                size_list = optarg;
+                break;
+
+            case 's':
+                step_list = optarg;
+                break;
+
+            case 't':
+                thread_list = optarg;
+                break;
+
+            case 'n':
+                *REPETITIONS = atoi(optarg);
+                break;
+
+            case 'w':
+                *WARMUPS = atoi(optarg);
+                break;
+
+            case 'x':
+                *SEED = atol(optarg);
+                break;
+
+            case 'm':
+                if (strcmp(optarg, "strong") == 0) {
+                    *MODE = STRONG;
+                } else if (strcmp(optarg, "weak") == 0) {
+                    *MODE = WEAK;
+                } else if (strcmp(optarg, "both") == 0) {
+                    *MODE = STRONG | WEAK;
+                } else {
+                    fprintf(stderr, "Usage: %s -m scaling mode must be strong, weak, or both\n", argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'o':
+                *output_path = optarg;
+                break;
+
+            case 'S':
+                *seq_engine = optarg;
+                break;
+
+            case 'P':
+                *omp_engine = optarg;
+                break;
+
+            case '?':
+                if (strchr("rstnwxmoSP", optopt) != NULL) {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (isprint (optopt)) {
+                    fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                } else {
+                    fprintf (stderr, "Unknown option character `\\x%x'.\n", optopt);
+                }
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // check command line arguments
+    *sizes = parseList(size_list, "-r grid sizes", argv[0]);
+    *steps = parseList(step_list, "-s time steps", argv[0]);
+    *threads = parseList(thread_list, "-t thread counts", argv[0]);
+    if (*REPETITIONS < 1) {
+        fprintf(stderr, "Usage: %s -n number of repetitions must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*WARMUPS < 0) {
+        fprintf(stderr, "Usage: %s -w number of warmups must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*SEED < 0) {
+        fprintf(stderr, "Usage: %s -x seed must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* parseList() */
+/* parses a comma-separated list of positive integers, exiting with a usage message if it is malformed */
+std::vector<int> parseList(char *list, const char *option, char *program) {
+    std::vector<int> values;
+    for (char *item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {  // for each item in the list...
+        int value = atoi(item);
+        if (value < 1) {
+            fprintf(stderr, "Usage: %s %s must be comma-separated positive nonzero integers\n", program, option);
+            exit(EXIT_FAILURE);
+        }
+        values.push_back(value);  // ...keep it
+    }
+    if (values.empty()) {
+        fprintf(stderr, "Usage: %s %s must not be empty\n", program, option);
+        exit(EXIT_FAILURE);
+    }
+    return values;
+}
+
+/* runEngine() */
+/* runs one simulation and returns the runtime it reports (threads of 0 runs the sequential engine) */
+double runEngine(const char * engine, int size, int time_steps, int threads, long seed) {
+    char command[1024];  // engine command line
+    char result[256];  // engine output
+    size_t length;  // number of characters of output
+    char *end;  // end of the parsed runtime
+
+    // build the command line
+    if (threads == 0) {
+        snprintf(command, sizeof(command), "%s -r %d -c %d -s %d -x %ld", engine, size, size, time_steps, seed);
+    } else {
+        snprintf(command, sizeof(command), "%s -r %d -c %d -s %d -x %ld -t %d", engine, size, size, time_steps, seed, threads);
+    }
+
+    // run it and collect its output
+    FILE *pipe = popen(command, "r");
+    if (pipe == NULL) {
+        fprintf(stderr, "could not run %s\n", command);
+        exit(EXIT_FAILURE);
+    }
+    length = fread(result, 1, sizeof(result) - 1, pipe);
+    result[length] = '\0';
+    if (pclose(pipe) != 0) {
+        fprintf(stderr, "%s failed\n", command);
+        exit(EXIT_FAILURE);
+    }
+
+    // the engine should have printed nothing but its runtime
+    double runtime = strtod(result, &end);
+    if (end == result || strspn(end, " \n") != strlen(end)) {
+        fprintf(stderr, "%s printed more than its runtime; rebuild it with DEBUG and COLOR disabled (make seq.fungi omp.fungi DEBUG= COLOR=)\n", command);
+        exit(EXIT_FAILURE);
+    }
+    return runtime;
+}
+
+/* benchmark() */
+/* runs one configuration WARMUPS times untimed and REPETITIONS times timed, and stores the median and standard deviation of the timed runs */
+void benchmark(const char * engine, int size, int time_steps, int threads, int * REPETITIONS, int * WARMUPS, long * SEED, double * median, double * stddev) {
+    std::vector<double> times;  // runtime of each repetition
+    double mean = 0, variance = 0;
+
+    fprintf(stderr, "%s: %d x %d, %d time steps, %s%d threads\n", engine, size, size, time_steps, (threads == 0) ? "(sequential) " : "", (threads == 0) ? 1 : threads);
+    for (int warmup = 0; warmup < (*WARMUPS); warmup++) {
+        runEngine(engine, size, time_steps, threads, (*SEED) + warmup);
+    }
+    for (int repetition = 0; repetition < (*REPETITIONS); repetition++) {
+        times.push_back(runEngine(engine, size, time_steps, threads, (*SEED) + repetition));
+    }
+
+    // median
+    std::sort(times.begin(), times.end());
+    if (times.size() % 2 == 1) {
+        *median = times[times.size() / 2];
+    } else {
+        *median = (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+    }
+
+    // sample standard deviation
+    for (double time : times) { mean += time; }
+    mean /= times.size();
+    for (double time : times) { variance += (time - mean) * (time - mean); }
+    *stddev = (times.size() > 1) ? sqrt(variance / (times.size() - 1)) : 0.0;
+}
+
+/* writeRow() */
+/* writes one row of results; cells per second counts every cell update the engine performs (time steps + 1 updates per run) */
+void writeRow(FILE * output, const char * threads, int size, int time_steps, double median, double stddev, double speedup, double efficiency, const char * scaling) {
+    double cells_per_second = (double)size * size * (time_steps + 1) / median;
+    fprintf(output, "%s\t%d\t%f\t%f\t%d\t%.4e\t%.3f\t%.3f\t%s\n", threads, size, median, stddev, time_steps, cells_per_second, speedup, efficiency, scaling);
+    fflush(output);
+}
+
+// end of file
@@ -0,0 +1,774 @@
+/*******************************************************************************************
+ * fungi-check.cpp
+ *******************************************************************************************
+ *
+ * checks that the fungi engines still simulate the model correctly, so that faster builds can be
+ * trusted; exits nonzero if any check fails
+ *
+ * equivalence: every engine is run from the same seed on a few grids with -k, and its hash of the
+ *      grid at every time step must match the sequential engine's; the parallel engine is run at
+ *      several thread counts, with two grids and in place (-i), once with early termination (-d)
+ *      (which must still print a hash for every time step), and once auto-tuned (-a, with a cache
+ *      file that is removed at the end), the sequential engine also on sparse tiled grids (-z),
+ *      out of core (-o), and on blocked grids in Morton order (-b), and any other engine that
+ *      takes -r -c -s -x -k can be added with -e; libfungi (fungi.h) is run in process on
+ *      the grids that set nothing but probabilities, half of the time steps in one simulation and the
+ *      rest in another restored from its snapshot, a few steps per call, and hashed through its view;
+ *      on the grids with network (-n) or ring (-g) reports or colonies (-y), every engine's reports must
+ *      match the sequential one's too (early termination is left out there, since it can't make reports)
+ *
+ * transition rates: the sequential engine's own updateCell() (fungi-seq.cpp is included, through
+ *      fungi-lib.cpp, with its main left out) is run over large grids filled with one state, and the fraction of cells
+ *      reaching each next state must match the prob* constants to within Z_LIMIT standard
+ *      deviations; deterministic transitions must always happen, impossible ones never, and every
+ *      cell must be written (the next grid is filled with NOT_WRITTEN first); initializeGrid() is
+ *      checked against probSpore the same way; the rates are checked once for the built-in
+ *      probabilities (the default_rules kernel) and once for the runtime_probabilities set through
+ *      -p (the runtime_rules kernel), and equivalence grids are also run with -p, with a terrain
+ *      mask (-m), with an initial grid from a state raster (-m states:), with the nutrient model (-u), with spore dispersal (-l), and with colonies (-y)
+ *
+ * ring fit: rings of cells at known radii around a known center, one ring per time step, are handed
+ *      to the ring tracker as a colony's growth front; the fitted centers and radii, and the expansion
+ *      rate, must match them, including for a ring that wraps around both edges of the torus
+ *
+ * dispersal: the spores dispersal_density() expects on every cell, by FFT convolution, must match a
+ *      direct sum over every MUSHROOMS cell and every offset across the torus, for both kernels on
+ *      sides that are and aren't powers of 2
+ *
+ * since the other engines must match the sequential one hash for hash, the rates only need to be
+ * checked once
+ *
+*/
+
+/* ENGINE */
+    #include "fungi-lib.cpp"  // libfungi, and with it the kernels of the sequential engine
+    #include <math.h>
+    #include <vector>
+    #include <string>
+
+/* UNIVERSAL CONSTANTS */
+    // defaults
+    #define DEFAULT_THREADS "1,2,3,4"    // thread counts for the parallel engine
+    #define DEFAULT_SEED 2024            // seed for every run
+    #define SEQ_ENGINE "./seq.fungi"
+    #define OMP_ENGINE "./omp.fungi"
+
+    // rate checks
+    #define RATE_ROWS 256                // rows of the grids the rates are measured on
+    #define RATE_COLUMNS 256             // columns of the grids the rates are measured on
+    #define RATE_STEPS 20                // time steps the rates are measured over
+    #define Z_LIMIT 5.0                  // largest allowed deviation from a rate, in standard deviations
+    #define NOT_WRITTEN -1               // next grid filler that no transition produces
+    #define STATES (INERT + 1)           // number of cell states
+
+    // terrain mask check
+    #define CHECK_TERRAIN "fungi-check-terrain.pgm"  // written at the start and removed at the end
+    #define TERRAIN_ROWS 70
+    #define TERRAIN_COLUMNS 90
+
+    // state raster check
+    #define CHECK_STATES "fungi-check-states.raw"  // written at the start and removed at the end
+    #define STATES_ROWS 75
+    #define STATES_COLUMNS 64
+
+    // soil quality map check
+    #define CHECK_SOIL "fungi-check-soil.pgm"  // written at the start and removed at the end
+    #define SOIL_ROWS 60
+    #define SOIL_COLUMNS 150                   // two whole tiles and a narrower last one
+
+    // sequential engine modes checked on the equivalence grids that take them
+    #define SEQ_SPARSE 1                       // sparse tiled grids (-z)
+    #define SEQ_DISK 2                         // out-of-core grids (-o)
+    #define SEQ_MORTON 4                       // blocked grids in Morton order (-b)
+    #define CHECK_SCRATCH "fungi-check-scratch.grid"  // the out-of-core scratch file (the engine removes it)
+
+    // auto-tuning check
+    #define CHECK_TUNE "fungi-check-tune.tsv"  // the auto-tuning cache (written by the engine, removed at the end)
+
+    // library check
+    #define LIBRARY_CHUNK 7                    // time steps per fungi_step() call
+
+    // ring fit check
+    #define RING_FIT_ROWS 64
+    #define RING_FIT_COLUMNS 80
+    #define RING_FIT_STEP 4                    // cells the ring's radius grows by every time step
+    #define RING_FIT_TOLERANCE 0.15            // largest allowed error of a fitted center, radius, or rate, in cells (rings of cells are only roughly round)
+
+    // dispersal check
+    #define DISPERSAL_SOURCES 0.05             // fraction of cells that are MUSHROOMS
+    #define DISPERSAL_TOLERANCE 1e-9           // largest allowed difference from the direct sum, in spores
+
+/* one equivalence check */
+struct equivalence_grid {
+    int rows, columns, time_steps;
+    const char * options;  // extra options for every engine ("" for none)
+    int modes;  // SEQ_* modes of the sequential engine that take these options and are checked too
+};
+
+/* equivalence checks */
+struct equivalence_grid equivalence_grids[] = {
+    { 120, 100, 100, "", SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // a few colonies growing and colliding
+    { 37, 53, 60, "", SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // odd sizes, so rows don't split evenly between threads (or tiles)
+    { 3, 40, 30, "", SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // fewer rows than threads (and than a tile)
+    { 80, 90, 80, "-p probSpore=0.004,probSpread=0.45,probDepletedToEmpty=0.3", SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // runtime probabilities
+    { TERRAIN_ROWS, TERRAIN_COLUMNS, 80, "-p probSpore=0.004 -m " CHECK_TERRAIN, SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // INERT road and rock from a terrain mask
+    { STATES_ROWS, STATES_COLUMNS, 80, "-m states:" CHECK_STATES, SEQ_SPARSE | SEQ_DISK | SEQ_MORTON },  // every state placed by a state raster
+    { 90, 80, 120, "-p probSpore=0.004 -u", 0 },  // nutrient levels coupled to spreading and recovery
+    { SOIL_ROWS, SOIL_COLUMNS, 100, "-p probSpore=0.004 -q " CHECK_SOIL, SEQ_DISK },  // uniform and varied soil quality tiles
+    { 150, 170, 150, "-p probSpore=0.0002", SEQ_SPARSE | SEQ_MORTON },  // a few colonies far apart, so most tiles stay EMPTY
+    { 1200, 2500, 4, "", SEQ_DISK | SEQ_MORTON },  // several out-of-core bands
+    { 80, 90, 300, "-p probSpore=0.002,probDepletedToSpore=0,probSpread=0.2", SEQ_SPARSE | SEQ_MORTON },  // colonies that die out for good, so -d stops early
+    { 96, 75, 120, "-p probSpore=0.0005 -l gauss:8:2:3", 0 },  // spore dispersal every few time steps, on sides that aren't powers of 2
+    { 64, 128, 80, "-l exp:5:1:1", 0 },  // long-tailed spore dispersal every time step, on sides that are
+    { 150, 170, 150, "-p probSpore=0.0005 -y majority", 0 },  // competing colonies that meet, by majority of YOUNG neighbors
+    { 120, 100, 100, "-y random", 0 },  // many colonies, tied at random
+    { STATES_ROWS, STATES_COLUMNS, 40, "-y first -m states:" CHECK_STATES, 0 },  // colonies founded by the hyphae of a state raster as well as its SPOREs
+    { 120, 100, 100, "-n 1,10,25,50,100", 0 },  // networks growing, meeting, and dying back
+    { STATES_ROWS, STATES_COLUMNS, 40, "-n 0,5,20,40 -m states:" CHECK_STATES, 0 },  // networks that wrap around both edges of the torus from the start
+    { 150, 170, 80, "-p probSpore=0.0005 -g 10", 0 },  // a few fairy rings, fitted every few time steps
+    { STATES_ROWS, STATES_COLUMNS, 40, "-g 5 -m states:" CHECK_STATES, 0 },  // fairy rings already growing on the initial grid
+};
+
+/* centers (row, column) of the rings the fit is checked on: one inside the grid, one around its corner */
+const double ring_fit_centers[][2] = { { 30, 41 }, { 2, 78 } };
+
+/* dispersal kernels checked against a direct sum, and the grids they are checked on */
+const char * dispersal_checks[] = { "gauss:4:1.5:1", "exp:3:2:1" };
+const int dispersal_shapes[][2] = { { 37, 53 }, { 32, 64 } };
+
+/* probabilities the runtime_rules kernel is checked with (in the order of rule_names) */
+const double runtime_probabilities[RULE_COUNT] = { 0.01, 0.5, 0.35, 0.2, 0.002, 0.3 };
+
+/* one possible next state of a rate check */
+struct outcome {
+    int state;
+    double probability;
+};
+
+/* one transition rate check */
+struct rate_check {
+    const char * name;
+    int state;  // state every cell starts in
+    int young_neighbors;  // 1 if every other row is YOUNG, so each cell has YOUNG neighbors
+    struct outcome outcomes[3];  // next states it can reach (unlisted states must never be reached)
+};
+
+/* FUNCTION DECLARATIONS */
+void getCheckArguments(int argc, char *argv[], const char ** seq_engine, const char ** omp_engine, std::vector<int> * threads, std::vector<std::string> * extra_engines, long * SEED);
+std::vector<unsigned long long> runHashes(const char * command, struct equivalence_grid * grid, long seed, std::string * reports);
+int checkEquivalence(const char * name, const char * command, std::vector<unsigned long long> * reference, std::string * reference_reports, struct equivalence_grid * grid, long seed);
+int checkLibrary(std::vector<unsigned long long> * reference, struct equivalence_grid * grid, long seed);
+struct fungi_sim * librarySimulation(struct equivalence_grid * grid, long seed);
+int hashView(const struct fungi_view * view, void * user);
+int rateChecks(const double * probabilities, struct rate_check * checks);
+template <class RULES> int checkRate(const char * label, struct rate_check * check, const RULES * rules, long seed);
+int checkInitialRate(const char * label, struct runtime_rules * rules, long seed);
+int checkCount(const char * name, int state, long count, long trials, double expected);
+int checkRingFit(double center_row, double center_column);
+int checkDispersal(const char * list, int rows, int columns, long seed);
+void writeTerrain(const char * path, int rows, int columns);
+void writeSoil(const char * path, int rows, int columns);
+void writeStates(const char * path, int rows, int columns);
+
+/* main */
+int main(int argc, char **argv){
+
+    // declare variables
+    const char *seq_engine, *omp_engine;  // engines to compare
+    std::vector<int> threads;  // thread counts for the parallel engine
+    std::vector<std::string> extra_engines;  // other engine commands to compare
+    long SEED;  // seed for every run
+    int failures = 0;  // failed checks
+    char name[64], command[512];  // label and command line of the engine being checked
+    struct rate_check checks[16];  // transition rate checks for one set of probabilities
+    struct runtime_rules built_in, runtime;  // the probabilities the rates are checked with
+
+    // parse command line arguments
+    getCheckArguments(argc, argv, &seq_engine, &omp_engine, &threads, &extra_engines, &SEED);
+    writeTerrain(CHECK_TERRAIN, TERRAIN_ROWS, TERRAIN_COLUMNS);
+    writeSoil(CHECK_SOIL, SOIL_ROWS, SOIL_COLUMNS);
+    writeStates(CHECK_STATES, STATES_ROWS, STATES_COLUMNS);
+
+    // equivalence of every engine to the sequential one
+    for (size_t index = 0; index < sizeof(equivalence_grids) / sizeof(equivalence_grids[0]); index++) {
+        struct equivalence_grid * grid = &equivalence_grids[index];
+        std::string reference_reports;  // the sequential engine's network, ring, and colony reports (empty without -n, -g, and -y)
+        std::vector<unsigned long long> reference = runHashes(seq_engine, grid, SEED, &reference_reports);
+        if ((int)reference.size() != grid->time_steps + 1) {
+            printf("FAIL\t%s printed %zu hashes for %dx%d over %d time steps (expected %d)\n", seq_engine, reference.size(), grid->rows, grid->columns, grid->time_steps, grid->time_steps + 1);
+            failures++;
+            continue;
+        }
+        for (int thread_count : threads) {
+            snprintf(name, sizeof(name), "omp %d threads", thread_count);
+            snprintf(command, sizeof(command), "%s -t %d", omp_engine, thread_count);
+            failures += checkEquivalence(name, command, &reference, &reference_reports, grid, SEED);
+            snprintf(name, sizeof(name), "omp %d threads in place", thread_count);
+            snprintf(command, sizeof(command), "%s -t %d -i", omp_engine, thread_count);
+            failures += checkEquivalence(name, command, &reference, &reference_reports, grid, SEED);
+        }
+        if (strstr(grid->options, "-n ") == NULL && strstr(grid->options, "-g ") == NULL) {  // (-d can't make reports due after the grid died out)
+            snprintf(command, sizeof(command), "%s -t %d -d", omp_engine, threads.empty() ? 1 : threads.back());
+            failures += checkEquivalence("omp early termination", command, &reference, &reference_reports, grid, SEED);
+        }
+        snprintf(command, sizeof(command), "%s -a " CHECK_TUNE, omp_engine);
+        failures += checkEquivalence("omp auto-tuned", command, &reference, &reference_reports, grid, SEED);
+        if (grid->modes & SEQ_SPARSE) {
+            snprintf(command, sizeof(command), "%s -z", seq_engine);
+            failures += checkEquivalence("seq sparse", command, &reference, &reference_reports, grid, SEED);
+        }
+        if (grid->modes & SEQ_DISK) {
+            snprintf(command, sizeof(command), "%s -o " CHECK_SCRATCH, seq_engine);
+            failures += checkEquivalence("seq out of core", command, &reference, &reference_reports, grid, SEED);
+        }
+        if (grid->modes & SEQ_MORTON) {
+            snprintf(command, sizeof(command), "%s -b", seq_engine);
+            failures += checkEquivalence("seq morton", command, &reference, &reference_reports, grid, SEED);
+        }
+        for (std::string & engine : extra_engines) {
+            failures += checkEquivalence(engine.c_str(), engine.c_str(), &reference, &reference_reports, grid, SEED);
+        }
+        if (grid->options[0] == '\0' || (strncmp(grid->options, "-p ", 3) == 0 && strchr(grid->options + 3, ' ') == NULL)) {  // only probabilities
+            failures += checkLibrary(&reference, grid, SEED);
+        }
+    }
+
+    // transition rates with the built-in probabilities (default_rules kernel)
+    rules_default(&built_in);
+    rules_finish(&built_in, argv[0]);
+    failures += checkInitialRate("built-in", &built_in, SEED);
+    for (int check = 0, count = rateChecks(built_in.probabilities, checks); check < count; check++) {
+        failures += checkRate("built-in", &checks[check], &built_in_rules, SEED);
+    }
+
+    // transition rates with probabilities set at runtime (runtime_rules kernel)
+    for (int rule = 0; rule < RULE_COUNT; rule++) {
+        rules_set(&runtime, rule_names[rule], runtime_probabilities[rule], argv[0]);
+    }
+    rules_finish(&runtime, argv[0]);
+    failures += checkInitialRate("runtime", &runtime, SEED);
+    for (int check = 0, count = rateChecks(runtime.probabilities, checks); check < count; check++) {
+        failures += checkRate("runtime", &checks[check], &runtime, SEED);
+    }
+
+    // ring fits against known rings
+    for (const double * center : ring_fit_centers) {
+        failures += checkRingFit(center[0], center[1]);
+    }
+
+    // dispersal by FFT against a direct sum
+    for (const char * list : dispersal_checks) {
+        for (const int * shape : dispersal_shapes) {
+            failures += checkDispersal(list, shape[0], shape[1], SEED);
+        }
+    }
+
+    // summary
+    remove(CHECK_TERRAIN);
+    remove(CHECK_SOIL);
+    remove(CHECK_STATES);
+    remove(CHECK_TUNE);
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("all checks passed\n");
+
+    // return statement
+    return 0;
+
+}
+
+/* getCheckArguments() */
+/* fetches and stores command line arguments for the engines, thread counts, and seed */
+void getCheckArguments(int argc, char *argv[], const char ** seq_engine, const char ** omp_engine, std::vector<int> * threads, std::vector<std::string> * extra_engines, long * SEED) {
+
+    // initialize variables
+    int c;
+    char default_threads[] = DEFAULT_THREADS;
+    char *thread_list = default_threads;
+    *seq_engine = SEQ_ENGINE;
+    *omp_engine = OMP_ENGINE;
+    *SEED = DEFAULT_SEED;
+
+    // retrieve command line arguments
+    while ((c = getopt (argc, argv, "S:P:t:e:x:")) != -1) {
+        switch (c) {
+            case 'S':
+                *seq_engine = optarg;
+                break;
+
+            case 'P':
+                *omp_engine = optarg;
+                break;
+
+            case 't':
+                thread_list = optarg;
+                break;
+
+            case 'e':
+                extra_engines->push_back(optarg);
+                break;
+
+            case 'x':
+                *SEED = atol(optarg);
+                break;
+
+            case '?':
+                if (optopt == 'S' || optopt == 'P' || optopt == 't' || optopt == 'e' || optopt == 'x') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (isprint (optopt)) {
+                    fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                } else {
+                    fprintf (stderr, "Unknown option character `\\x%x'.\n", optopt);
+                }
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // check command line arguments
+    for (char *item = strtok(thread_list, ","); item != NULL; item = strtok(NULL, ",")) {
+        int thread_count = atoi(item);
+        if (thread_count < 1) {
+            fprintf(stderr, "Usage: %s -t thread counts must be comma-separated positive nonzero integers\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        threads->push_back(thread_count);
+    }
+    if (*SEED < 0) {
+        fprintf(stderr, "Usage: %s -x RNG seed must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* runHashes() */
+/* runs an engine with -k and returns the grid hash it printed at each time step, keeping the lines of its network (-n), ring (-g), and colony (-y) reports in reports */
+std::vector<unsigned long long> runHashes(const char * command, struct equivalence_grid * grid, long seed, std::string * reports) {
+    std::vector<unsigned long long> hashes;
+    char line[256], full_command[768];
+    int time_step;
+    unsigned long long hash;
+
+    snprintf(full_command, sizeof(full_command), "%s -r %d -c %d -s %d -x %ld -k %s 2>&1 >/dev/null", command, grid->rows, grid->columns, grid->time_steps, seed, grid->options);  // keep only stderr
+    FILE *pipe = popen(full_command, "r");
+    if (pipe == NULL) {
+        fprintf(stderr, "could not run %s\n", full_command);
+        exit(EXIT_FAILURE);
+    }
+    while (fgets(line, sizeof(line), pipe) != NULL) {
+        if (sscanf(line, "hash\t%d\t%llx", &time_step, &hash) == 2 && time_step == (int)hashes.size()) {
+            hashes.push_back(hash);
+        } else if (strncmp(line, "networks at", 11) == 0 || strncmp(line, "rings at", 8) == 0 || strncmp(line, "    ", 4) == 0 || strncmp(line, "colon", 5) == 0) {  // (report lines, listed networks and rings, colonies: ... or colony ...)
+            reports->append(line);
+        }
+    }
+    pclose(pipe);
+    return hashes;
+}
+
+/* checkEquivalence() */
+/* compares an engine's hashes, and its reports, with the reference ones; returns 1 if they differ, otherwise 0 */
+int checkEquivalence(const char * name, const char * command, std::vector<unsigned long long> * reference, std::string * reference_reports, struct equivalence_grid * grid, long seed) {
+    std::string reports;
+    std::vector<unsigned long long> hashes = runHashes(command, grid, seed, &reports);
+    for (size_t step = 0; step < reference->size(); step++) {
+        if (step >= hashes.size()) {
+            printf("FAIL\t%s on %dx%d%s%s: no hash for time step %zu\n", name, grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options, step);
+            return 1;
+        }
+        if (hashes[step] != (*reference)[step]) {
+            printf("FAIL\t%s on %dx%d%s%s: first differs from the sequential engine at time step %zu\n", name, grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options, step);
+            return 1;
+        }
+    }
+    if (reports != (*reference_reports)) {
+        printf("FAIL\t%s on %dx%d%s%s: reports differ from the sequential engine's\n", name, grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options);
+        return 1;
+    }
+    printf("PASS\t%s on %dx%d%s%s matches the sequential engine for %d time steps\n", name, grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options, grid->time_steps);
+    return 0;
+}
+
+/* checkLibrary() */
+/* runs the grid through libfungi, restoring a second simulation from a snapshot halfway, and compares the hashes of its views with the reference ones; returns 1 if they differ, otherwise 0 */
+int checkLibrary(std::vector<unsigned long long> * reference, struct equivalence_grid * grid, long seed) {
+    std::vector<unsigned long long> hashes;
+    std::vector<int> cells((size_t)grid->rows * grid->columns);
+    int half = grid->time_steps / 2, time_step = -1;
+
+    // first half, then a snapshot
+    struct fungi_sim *sim = librarySimulation(grid, seed);
+    if (sim != NULL) {
+        hashes.push_back(fungi_hash(sim));
+        fungi_on_step(sim, hashView, &hashes);
+        for (int done = 0; done < half; done += LIBRARY_CHUNK) {
+            fungi_step(sim, (half - done < LIBRARY_CHUNK) ? half - done : LIBRARY_CHUNK);
+        }
+        time_step = fungi_snapshot(sim, cells.data());
+        fungi_destroy(sim);
+    }
+
+    // second half, from the snapshot
+    sim = (time_step == half) ? librarySimulation(grid, seed) : NULL;
+    if (sim != NULL && fungi_restore(sim, cells.data(), time_step) == 0) {
+        fungi_on_step(sim, hashView, &hashes);
+        for (int done = half; done < grid->time_steps; done += LIBRARY_CHUNK) {
+            fungi_step(sim, (grid->time_steps - done < LIBRARY_CHUNK) ? grid->time_steps - done : LIBRARY_CHUNK);
+        }
+    }
+    fungi_destroy(sim);
+
+    for (size_t step = 0; step < reference->size(); step++) {
+        if (step >= hashes.size() || hashes[step] != (*reference)[step]) {
+            printf("FAIL\tlibrary on %dx%d%s%s: first differs from the sequential engine at time step %zu\n", grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options, step);
+            return 1;
+        }
+    }
+    printf("PASS\tlibrary on %dx%d%s%s matches the sequential engine for %d time steps\n", grid->rows, grid->columns, (grid->options[0] != '\0') ? " " : "", grid->options, grid->time_steps);
+    return 0;
+}
+
+/* librarySimulation() */
+/* creates and initializes a libfungi simulation of the grid, with the probabilities of its -p list; returns NULL if any call fails */
+struct fungi_sim * librarySimulation(struct equivalence_grid * grid, long seed) {
+    struct fungi_sim *sim = fungi_create(grid->rows, grid->columns);
+    if (sim == NULL) { return NULL; }
+    std::string list = (grid->options[0] != '\0') ? grid->options + 3 : "";  // (after "-p ")
+    for (char *pair = strtok(&list[0], ","); pair != NULL; pair = strtok(NULL, ",")) {  // for each name=value pair...
+        char *equals = strchr(pair, '=');
+        if (equals != NULL) { *equals = '\0'; }
+        if (equals == NULL || fungi_set_probability(sim, pair, atof(equals + 1)) != 0) {
+            fungi_destroy(sim);
+            return NULL;
+        }
+    }
+    if (fungi_init(sim, seed) != 0) {
+        fungi_destroy(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+/* hashView() */
+/* fungi_on_step() callback: appends the hash of the view, computed as grid_hash() does, to a vector of hashes */
+int hashView(const struct fungi_view * view, void * user) {
+    unsigned long long hash = HASH_OFFSET;
+    for (int row = 0; row < view->rows; row++) {  // hash each row, then fold it in in order
+        unsigned long long row_hash = hash_bytes(HASH_OFFSET, (const unsigned char *)&view->cells[(size_t)row * view->stride], sizeof(int) * view->columns);
+        hash = hash_bytes(hash, (const unsigned char *)&row_hash, sizeof(unsigned long long));
+    }
+    ((std::vector<unsigned long long> *)user)->push_back(hash);
+    return 0;
+}
+
+/* rateChecks() */
+/* fills in the transition rate checks for one set of probabilities (indexed by RULE_*) and returns how many there are */
+int rateChecks(const double * p, struct rate_check * checks) {
+    struct rate_check all[] = {
+        { "EMPTY without YOUNG neighbors", EMPTY, 0, { { EMPTY, 1.0 } } },
+        { "EMPTY with YOUNG neighbors", EMPTY, 1, { { EMPTY, 1.0 - p[RULE_SPREAD] }, { YOUNG, p[RULE_SPREAD] } } },
+        { "SPORE", SPORE, 0, { { SPORE, 1.0 - p[RULE_SPORE_TO_YOUNG] }, { YOUNG, p[RULE_SPORE_TO_YOUNG] } } },
+        { "YOUNG", YOUNG, 0, { { MATURING, 1.0 } } },
+        { "MATURING", MATURING, 0, { { MUSHROOMS, p[RULE_MATURING_TO_MUSHROOMS] }, { OLDER, 1.0 - p[RULE_MATURING_TO_MUSHROOMS] } } },
+        { "MUSHROOMS", MUSHROOMS, 0, { { DECAYING, 1.0 } } },
+        { "OLDER", OLDER, 0, { { DECAYING, 1.0 } } },
+        { "DECAYING", DECAYING, 0, { { DEAD, 1.0 } } },
+        { "DEAD", DEAD, 0, { { DEADER, 1.0 } } },
+        { "DEADER", DEADER, 0, { { DEPLETED, 1.0 } } },
+        { "DEPLETED", DEPLETED, 0, { { EMPTY, p[RULE_DEPLETED_TO_EMPTY] - p[RULE_DEPLETED_TO_SPORE] }, { SPORE, p[RULE_DEPLETED_TO_SPORE] }, { DEPLETED, 1.0 - p[RULE_DEPLETED_TO_EMPTY] } } },
+        { "INERT", INERT, 0, { { INERT, 1.0 } } },
+    };
+    int count = sizeof(all) / sizeof(all[0]);
+    for (int check = 0; check < count; check++) { checks[check] = all[check]; }
+    return count;
+}
+
+/* checkRate() */
+/* runs updateCell() with one rule set over grids of one state and checks the next states it produces; returns the number of failures */
+template <class RULES>
+int checkRate(const char * label, struct rate_check * check, const RULES * rules, long seed) {
+
+    // declare variables
+    int ROWS = RATE_ROWS, COLUMNS = RATE_COLUMNS;
+    int **current_grid, **next_grid;
+    int current_row, current_column, neighbor_row, neighbor_column, current_value;
+    unsigned long prob;
+    long counts[STATES] = { 0 };  // cells reaching each next state
+    long unwritten = 0, trials = 0;
+    int failures = 0;
+    char name[128];
+    trng::yarn2 yarn;
+    yarn.seed((long unsigned int)seed);
+    snprintf(name, sizeof(name), "%s: %s", label, check->name);
+
+    // fill the current grid (ghosts included)
+    allocateGrid(&current_grid, &ROWS, &COLUMNS, &current_row);
+    allocateGrid(&next_grid, &ROWS, &COLUMNS, &current_row);
+    for (int row = 0; row <= ROWS + 1; row++) {
+        for (int column = 0; column <= COLUMNS + 1; column++) {
+            current_grid[row][column] = (check->young_neighbors && row % 2 == 0) ? YOUNG : check->state;
+        }
+    }
+
+    for (int time_step = 0; time_step < RATE_STEPS; time_step++) {
+        for (current_row = 1; current_row <= ROWS; current_row++) {
+            for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                next_grid[current_row][current_column] = NOT_WRITTEN;
+            }
+        }
+        for (current_row = 1; current_row <= ROWS; current_row++) {
+            struct row_draws draws;
+            row_draws_start(&draws, &yarn, &ROWS, &COLUMNS, time_step, current_row);
+            for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                updateCell(&current_grid, &next_grid, &current_row, &current_column, &neighbor_row, &neighbor_column, &current_value, &prob, &draws, rules, NULL, NULL, NULL);
+            }
+        }
+        for (current_row = 1; current_row <= ROWS; current_row++) {
+            for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                if (current_grid[current_row][current_column] != check->state) { continue; }  // the YOUNG rows are only there as neighbors
+                int next = next_grid[current_row][current_column];
+                trials++;
+                if (next >= 0 && next < STATES) {
+                    counts[next]++;
+                } else {
+                    unwritten++;
+                }
+            }
+        }
+    }
+
+    // compare the counts with the expected probabilities
+    if (unwritten > 0) {
+        printf("FAIL\t%s: %ld of %ld cells were not written to the next grid\n", name, unwritten, trials);
+        failures++;
+    }
+    double expected[STATES] = { 0.0 };  // probability of each next state
+    for (int outcome = 0; outcome < 3; outcome++) {
+        expected[check->outcomes[outcome].state] += check->outcomes[outcome].probability;
+    }
+    for (int state = 0; state < STATES; state++) {
+        failures += checkCount(name, state, counts[state], trials, expected[state]);
+    }
+
+    deallocateGrid(&current_grid, &ROWS, &current_row);
+    deallocateGrid(&next_grid, &ROWS, &current_row);
+    return failures;
+}
+
+/* checkInitialRate() */
+/* runs initializeGrid() and checks the fraction of SPORE cells; returns the number of failures */
+int checkInitialRate(const char * label, struct runtime_rules * rules, long seed) {
+    int ROWS = RATE_ROWS * 4, COLUMNS = RATE_COLUMNS * 4;  // SPORE is rare, so use a bigger grid
+    int **grid;
+    int current_row, current_column;
+    long counts[STATES] = { 0 };
+    int failures = 0;
+    char name[128];
+    trng::yarn2 yarn;
+    yarn.seed((long unsigned int)seed);
+    snprintf(name, sizeof(name), "%s: initial grid", label);
+
+    allocateGrid(&grid, &ROWS, &COLUMNS, &current_row);
+    initializeGrid(&grid, &ROWS, &COLUMNS, &current_row, &yarn, rules);
+    for (current_row = 1; current_row <= ROWS; current_row++) {
+        for (current_column = 1; current_column <= COLUMNS; current_column++) {
+            int state = grid[current_row][current_column];
+            if (state >= 0 && state < STATES) { counts[state]++; }
+        }
+    }
+    failures += checkCount(name, SPORE, counts[SPORE], (long)ROWS * COLUMNS, rules->probabilities[RULE_SPORE]);
+    failures += checkCount(name, EMPTY, counts[EMPTY], (long)ROWS * COLUMNS, 1.0 - rules->probabilities[RULE_SPORE]);
+    deallocateGrid(&grid, &ROWS, &current_row);
+    return failures;
+}
+
+/* checkCount() */
+/* checks how often one next state was reached against its probability; returns 1 if it is off, otherwise 0 */
+int checkCount(const char * name, int state, long count, long trials, double expected) {
+    if (expected == 0.0 || expected == 1.0) {  // impossible or certain: must hold exactly
+        long wanted = (expected == 1.0) ? trials : 0;
+        if (count == wanted) {
+            if (wanted > 0) { printf("PASS\t%s -> state %d: all %ld cells\n", name, state, trials); }
+            return 0;
+        }
+        printf("FAIL\t%s -> state %d: %ld of %ld cells (expected %ld)\n", name, state, count, trials, wanted);
+        return 1;
+    }
+    double mean = trials * expected;
+    double z = (count - mean) / sqrt(mean * (1.0 - expected));
+    if (fabs(z) > Z_LIMIT) {
+        printf("FAIL\t%s -> state %d: rate %.6f, expected %.6f (z = %.1f)\n", name, state, (double)count / trials, expected, z);
+        return 1;
+    }
+    printf("PASS\t%s -> state %d: rate %.6f, expected %.6f (z = %.1f)\n", name, state, (double)count / trials, expected, z);
+    return 0;
+}
+
+/* checkDispersal() */
+/* computes the spores expected on every cell of a grid of scattered MUSHROOMS with dispersal_density() and with a direct sum over the torus; returns 1 if they differ, otherwise 0 */
+int checkDispersal(const char * list, int rows, int columns, long seed) {
+    int **grid;
+    int current_row;
+    trng::yarn2 yarn;
+    yarn.seed((long unsigned int)seed);
+    allocateGrid(&grid, &rows, &columns, &current_row);
+    std::vector<int> sources;  // row * columns + column of every MUSHROOMS cell
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int mushrooms = (draw(&yarn) < RULE_THRESHOLD(DISPERSAL_SOURCES));
+            grid[row + 1][column + 1] = mushrooms ? MUSHROOMS : EMPTY;
+            if (mushrooms) { sources.push_back(row * columns + column); }
+        }
+    }
+    struct dispersal *dispersal = dispersal_create(list, &rows, &columns, "fungi-check");
+    dispersal_density(dispersal, &grid);
+
+    // the kernel at every offset across the torus, as dispersal_create() defines it
+    std::vector<double> kernel((size_t)rows * columns);
+    double total = 0.0;
+    for (int dy = 0; dy < rows; dy++) {
+        for (int dx = 0; dx < columns; dx++) {
+            double y = (dy < rows - dy) ? dy : rows - dy, x = (dx < columns - dx) ? dx : columns - dx;
+            double distance = sqrt(x * x + y * y);
+            kernel[(size_t)dy * columns + dx] = (dispersal->kernel == DISPERSAL_GAUSS) ? exp(-distance * distance / (2.0 * dispersal->scale * dispersal->scale)) : exp(-distance / dispersal->scale);
+            total += kernel[(size_t)dy * columns + dx];
+        }
+    }
+
+    double worst = 0.0;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            double expected = 0.0;
+            for (int source : sources) {
+                int dy = (row - source / columns + rows) % rows, dx = (column - source % columns + columns) % columns;
+                expected += kernel[(size_t)dy * columns + dx];
+            }
+            expected *= dispersal->yield / total;
+            double difference = fabs(dispersal->field[(size_t)row * columns + column].real() - expected);
+            if (difference > worst) { worst = difference; }
+        }
+    }
+    dispersal_destroy(dispersal);
+    deallocateGrid(&grid, &rows, &current_row);
+
+    if (worst > DISPERSAL_TOLERANCE) {
+        printf("FAIL\tdispersal %s on %dx%d: differs from the direct sum by up to %.3g spores\n", list, rows, columns, worst);
+        return 1;
+    }
+    printf("PASS\tdispersal %s on %dx%d: matches the direct sum to %.3g spores\n", list, rows, columns, worst);
+    return 0;
+}
+
+/* checkRingFit() */
+/* hands the ring tracker a colony born at step 1 a few cells off center, whose front is then a ring of cells RING_FIT_STEP wider every step; returns 1 if a fitted center, radius, or the expansion rate is off, otherwise 0 */
+int checkRingFit(double center_row, double center_column) {
+    int rows = RING_FIT_ROWS, columns = RING_FIT_COLUMNS;
+    struct ring_tracker *rings = rings_create(&rows, &columns, INT_MAX);  // (never reports)
+    double worst = 0.0;
+
+    // the colony is born a few cells off center (wrapped into the grid)
+    int origin_row = ((int)center_row + 3 - 1 + rows) % rows + 1, origin_column = ((int)center_column - 2 - 1 + columns) % columns + 1;
+    rings_birth(rings, origin_row, origin_column);
+    rings_end_step(rings, 1, -1);
+
+    for (int time_step = 2; time_step <= 4; time_step++) {
+        double radius = RING_FIT_STEP * (time_step - 1);
+        for (int row = 1; row <= rows; row++) {  // every cell within half a cell of the ring, across the torus
+            for (int column = 1; column <= columns; column++) {
+                double y = rings_offset(row, (int)center_row, rows) - (center_row - (int)center_row);
+                double x = rings_offset(column, (int)center_column, columns) - (center_column - (int)center_column);
+                if (fabs(sqrt(x * x + y * y) - radius) < 0.5) {
+                    struct ring_sample sample = { 0, row, column };
+                    rings->buffers[0].samples.push_back(sample);
+                }
+            }
+        }
+        rings_end_step(rings, time_step, -1);
+        struct colony * c = &rings->colonies[0];
+        worst = fmax(worst, fabs(fmod(c->center_row - center_row + 1.5 * rows, (double)rows) - 0.5 * rows));  // (distances across the torus)
+        worst = fmax(worst, fabs(fmod(c->center_column - center_column + 1.5 * columns, (double)columns) - 0.5 * columns));
+        worst = fmax(worst, fabs(c->radius - radius));
+    }
+    worst = fmax(worst, fabs(rings_expansion(&rings->colonies[0]) - RING_FIT_STEP));  // (radius 0 at birth, then RING_FIT_STEP more every step)
+    rings_destroy(rings);
+
+    if (worst > RING_FIT_TOLERANCE) {
+        printf("FAIL\tring fit around (%g, %g) on %dx%d: off by up to %.3g cells\n", center_row, center_column, rows, columns, worst);
+        return 1;
+    }
+    printf("PASS\tring fit around (%g, %g) on %dx%d: centers, radii, and expansion within %.3g cells\n", center_row, center_column, rows, columns, worst);
+    return 0;
+}
+
+/* writeTerrain() */
+/* writes a PGM terrain mask with a road across the grid and a round rock in it */
+void writeTerrain(const char * path, int rows, int columns) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "could not write the terrain mask %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file, "P5\n# check terrain\n%d %d\n255\n", columns, rows);
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int road = (row >= rows / 3 && row < rows / 3 + 3);  // a road three cells wide
+            int rock = ((row - 2 * rows / 3) * (row - 2 * rows / 3) + (column - columns / 2) * (column - columns / 2) < 64);  // a rock of radius 8
+            fputc((road || rock) ? 255 : 0, file);
+        }
+    }
+    fclose(file);
+}
+
+/* writeSoil() */
+/* writes a PGM soil quality map (maxval 200) with a full and a barren tile, a poor tile, and a gradient across the last columns */
+void writeSoil(const char * path, int rows, int columns) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "could not write the soil quality map %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(file, "P5\n# check soil\n%d %d\n200\n", columns, rows);
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int value;
+            if (column < 64) {  // first tile: full soil, barren in the bottom rows
+                value = (row < 2 * rows / 3) ? 200 : 0;
+            } else if (column < 128) {  // second tile: poor soil
+                value = 90;
+            } else {  // the rest: richer toward the right
+                value = 200 * (column - 127) / (columns - 127);
+            }
+            fputc(value, file);
+        }
+    }
+    fclose(file);
+}
+
+/* writeStates() */
+/* writes a raw state raster: rings of every hyphae state around SPOREs (one of them around the corner, so it wraps), a DEPLETED patch, and an INERT wall with a gap */
+void writeStates(const char * path, int rows, int columns) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "could not write the state raster %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int state = EMPTY;
+            int ring = (int)sqrt((double)((row - rows / 3) * (row - rows / 3) + (column - columns / 3) * (column - columns / 3)));
+            int corner_row = std::min(row, rows - row), corner_column = std::min(column, columns - column);  // (distance to the corner across the torus)
+            ring = std::min(ring, (int)sqrt((double)(corner_row * corner_row + corner_column * corner_column)));
+            if (ring < 10) {  // a fairy ring: oldest inside, YOUNG at its edge, a SPORE at its center
+                state = (ring == 0) ? SPORE : YOUNG + (9 - ring) % (DEPLETED - YOUNG + 1);
+            } else if (row > 2 * rows / 3 && column > columns / 2) {  // a DEPLETED patch with a few SPOREs
+                state = ((row * columns + column) % 37 == 0) ? SPORE : DEPLETED;
+            } else if (column == columns - 3 && row % 20 != 0) {  // an INERT wall with gaps
+                state = INERT;
+            }
+            fputc(state, file);
+        }
+    }
+    fclose(file);
+}
+
+// end of file
@@ -0,0 +1,239 @@
+/*******************************************************************************************
+ * fungi-lib.cpp
+ *******************************************************************************************
+ *
+ * libfungi: the sequential simulation behind the C API of fungi.h, built as libfungi.a and
+ * libfungi.so (link with -lfungi -ltrng4)
+ *
+ * the kernels are the sequential engine's own (fungi-seq.cpp is included with its main left out),
+ * and each time step does what one pass of the engine's mushrooms() loop does: the ghost rows and
+ * columns, then updateGrid() with the row streams of that time step; the library only owns the
+ * grids and the stepping, so a library run and an engine run from the same seed agree hash for hash
+ *
+ * each grid is one contiguous block of (rows + 2) x (columns + 2) cells, ghosts included, with row
+ * pointers into it for the kernels, so the view is a plain strided array; rather than copying the
+ * next grid onto the current one after every update, as the engines do, the two grids swap
+ *
+ * probabilities are checked here, with a message for fungi_error(), before rules_finish() is called,
+ * so a library call never exits the program it is embedded in
+ *
+*/
+
+/* ENGINE */
+    #define NO_MAIN  // take the kernels but not the main of the sequential engine
+    #include "fungi-seq.cpp"
+    #include <new>
+    #include "fungi.h"  // the API this file implements
+
+/* UNIVERSAL CONSTANTS */
+    #define ERROR_LENGTH 256  // longest message kept for fungi_error()
+
+    // the API's states must be the engines'
+    static_assert(FUNGI_EMPTY == EMPTY && FUNGI_SPORE == SPORE && FUNGI_YOUNG == YOUNG && FUNGI_MATURING == MATURING && FUNGI_MUSHROOMS == MUSHROOMS, "fungi.h states differ from the engines'");
+    static_assert(FUNGI_OLDER == OLDER && FUNGI_DECAYING == DECAYING && FUNGI_DEAD == DEAD && FUNGI_DEADER == DEADER && FUNGI_DEPLETED == DEPLETED && FUNGI_INERT == INERT, "fungi.h states differ from the engines'");
+
+/* a simulation */
+struct fungi_sim {
+    int ROWS, COLUMNS;  // interior cells
+    int current_time_step;  // updates done so far
+    int initialized;  // 1 once fungi_init() has run
+    int *blocks[2];  // the two grids' cells, ghosts included
+    int **current_grid;  // row pointers into the block holding the current grid
+    int **next_grid;  // row pointers into the other block
+    trng::yarn2 yarn;  // seeded engine (never drawn from directly; every row jumps from it)
+    struct runtime_rules rules;  // transition probabilities and their thresholds
+    fungi_callback callback;  // called after every time step (NULL if none)
+    void *user;  // passed to the callback
+    mutable char error[ERROR_LENGTH];  // message of the last failed call (const getters report errors too)
+
+    // counters the kernels take by pointer
+    int current_row, current_column;
+    int neighbor_row, neighbor_column;
+    int current_value;
+    unsigned long prob;
+};
+
+/* FUNCTION DECLARATIONS */
+static int ** pointRows(int * block, int ROWS, int COLUMNS);
+static void setGhosts(struct fungi_sim * sim);
+static void describe(const struct fungi_sim * sim, struct fungi_view * view);
+static int fail(const struct fungi_sim * sim, const char * message, const char * name);
+
+/* fungi_create() */
+/* creates a simulation of a rows x columns grid with the built-in probabilities; returns NULL if the size is invalid or memory runs out */
+struct fungi_sim * fungi_create(int rows, int columns) {
+    if (rows < 1 || columns < 1) { return NULL; }
+    size_t cells = (size_t)(rows + 2) * (columns + 2);
+    struct fungi_sim *sim = new (std::nothrow) struct fungi_sim;
+    if (sim == NULL) { return NULL; }
+    sim->ROWS = rows;
+    sim->COLUMNS = columns;
+    sim->current_time_step = 0;
+    sim->initialized = 0;
+    sim->blocks[0] = new (std::nothrow) int[cells]();
+    sim->blocks[1] = new (std::nothrow) int[cells]();
+    sim->current_grid = (sim->blocks[0] != NULL) ? pointRows(sim->blocks[0], rows, columns) : NULL;
+    sim->next_grid = (sim->blocks[1] != NULL) ? pointRows(sim->blocks[1], rows, columns) : NULL;
+    sim->callback = NULL;
+    sim->user = NULL;
+    sim->error[0] = '\0';
+    rules_default(&sim->rules);
+    if (sim->current_grid == NULL || sim->next_grid == NULL) {
+        fungi_destroy(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+/* fungi_set_probability() */
+/* sets one probability by name, taking effect at the next fungi_init(); returns 0, or -1 if the name or value is invalid */
+int fungi_set_probability(struct fungi_sim * sim, const char * name, double value) {
+    for (int rule = 0; rule < RULE_COUNT; rule++) {
+        if (strcmp(name, rule_names[rule]) == 0) {
+            if (!(value >= 0.0 && value <= 1.0)) { return fail(sim, "%s must be a probability between 0 and 1", name); }
+            sim->rules.probabilities[rule] = value;
+            return 0;
+        }
+    }
+    return fail(sim, "unknown parameter %s", name);
+}
+
+/* fungi_init() */
+/* seeds the simulation and scatters the initial SPOREs, at time step 0; returns 0, or -1 if the probabilities don't fit together */
+int fungi_init(struct fungi_sim * sim, long seed) {
+    if (sim->rules.probabilities[RULE_DEPLETED_TO_SPORE] > sim->rules.probabilities[RULE_DEPLETED_TO_EMPTY]) {  // (rules_finish() would exit)
+        return fail(sim, "probDepletedToSpore cannot be greater than probDepletedToEmpty", "");
+    }
+    rules_finish(&sim->rules, "libfungi");
+    sim->yarn = trng::yarn2();  // the engines' default seed...
+    if (seed >= 0) { sim->yarn.seed((long unsigned int)seed); }  // ...unless one is given
+    initializeGrid(&sim->current_grid, &sim->ROWS, &sim->COLUMNS, &sim->current_row, &sim->yarn, &sim->rules);
+    sim->current_time_step = 0;
+    sim->initialized = 1;
+    return 0;
+}
+
+/* fungi_step() */
+/* advances the simulation by up to steps time steps; returns the number taken (fewer if the callback stopped it), or -1 if it was never initialized */
+int fungi_step(struct fungi_sim * sim, int steps) {
+    if (!sim->initialized) { return fail(sim, "the simulation must be initialized first", ""); }
+    struct fungi_view view;
+    for (int taken = 0; taken < steps; taken++) {  // for each time step...
+        setGhosts(sim);
+        updateGrid(&sim->current_grid, &sim->next_grid, &sim->ROWS, &sim->COLUMNS, &sim->current_row, &sim->current_column, &sim->current_time_step, &sim->neighbor_row, &sim->neighbor_column, &sim->current_value, &sim->prob, &sim->yarn, &sim->rules, NULL, NULL, NULL, NULL);
+        int **swap = sim->current_grid;  // the next grid becomes the current one
+        sim->current_grid = sim->next_grid;
+        sim->next_grid = swap;
+        sim->current_time_step++;
+        if (sim->callback != NULL) {
+            describe(sim, &view);
+            if (sim->callback(&view, sim->user) != 0) { return taken + 1; }
+        }
+    }
+    return (steps > 0) ? steps : 0;
+}
+
+/* fungi_get_view() */
+/* describes the current grid without copying it; returns 0, or -1 if it was never initialized */
+int fungi_get_view(const struct fungi_sim * sim, struct fungi_view * view) {
+    if (!sim->initialized) { return fail(sim, "the simulation must be initialized first", ""); }
+    describe(sim, view);
+    return 0;
+}
+
+/* fungi_snapshot() */
+/* copies the current grid into cells, row by row; returns its time step, or -1 if it was never initialized */
+int fungi_snapshot(const struct fungi_sim * sim, int * cells) {
+    if (!sim->initialized) { return fail(sim, "the simulation must be initialized first", ""); }
+    for (int current_row = 1; current_row <= sim->ROWS; current_row++) {  // for each row in the grid...
+        memcpy(&cells[(size_t)(current_row - 1) * sim->COLUMNS], &sim->current_grid[current_row][1], sizeof(int) * sim->COLUMNS);
+    }
+    return sim->current_time_step;
+}
+
+/* fungi_restore() */
+/* replaces the grid with cells, row by row, at a time step; returns 0, or -1 if it was never initialized or a cell or the time step is invalid */
+int fungi_restore(struct fungi_sim * sim, const int * cells, int time_step) {
+    if (!sim->initialized) { return fail(sim, "the simulation must be initialized first", ""); }
+    if (time_step < 0) { return fail(sim, "the time step cannot be negative", ""); }
+    for (size_t cell = 0; cell < (size_t)sim->ROWS * sim->COLUMNS; cell++) {  // check every cell before changing any
+        if (cells[cell] < EMPTY || cells[cell] > INERT) { return fail(sim, "cells must hold states from EMPTY to INERT", ""); }
+    }
+    for (int current_row = 1; current_row <= sim->ROWS; current_row++) {  // for each row in the grid...
+        memcpy(&sim->current_grid[current_row][1], &cells[(size_t)(current_row - 1) * sim->COLUMNS], sizeof(int) * sim->COLUMNS);
+    }
+    sim->current_time_step = time_step;
+    return 0;
+}
+
+/* fungi_hash() */
+/* returns the hash of the current grid, the one the engines print with -k */
+unsigned long long fungi_hash(const struct fungi_sim * sim) {
+    int **grid = sim->current_grid;
+    int ROWS = sim->ROWS, COLUMNS = sim->COLUMNS;
+    return grid_hash(&grid, &ROWS, &COLUMNS);
+}
+
+/* fungi_on_step() */
+/* sets the callback called after every time step and the pointer passed to it */
+void fungi_on_step(struct fungi_sim * sim, fungi_callback callback, void * user) {
+    sim->callback = callback;
+    sim->user = user;
+}
+
+/* fungi_error() */
+/* returns the message of the last call that failed ("" if none has) */
+const char * fungi_error(const struct fungi_sim * sim) {
+    return sim->error;
+}
+
+/* fungi_destroy() */
+/* frees a simulation (does nothing if there is none) */
+void fungi_destroy(struct fungi_sim * sim) {
+    if (sim == NULL) { return; }
+    for (int block = 0; block < 2; block++) { delete [] sim->blocks[block]; }
+    delete [] sim->current_grid;
+    delete [] sim->next_grid;
+    delete sim;
+}
+
+/* pointRows() */
+/* returns row pointers into a block of (ROWS + 2) x (COLUMNS + 2) cells, shaped like an allocateGrid() grid (NULL if memory runs out) */
+static int ** pointRows(int * block, int ROWS, int COLUMNS) {
+    int **grid = new (std::nothrow) int*[ROWS + 2];
+    if (grid == NULL) { return NULL; }
+    for (int current_row = 0; current_row <= ROWS + 1; current_row++) {
+        grid[current_row] = block + (size_t)current_row * (COLUMNS + 2);
+    }
+    return grid;
+}
+
+/* setGhosts() */
+/* sets the ghost rows and columns of the current grid, as mushrooms() does at the start of every time step */
+static void setGhosts(struct fungi_sim * sim) {
+    int **grid = sim->current_grid;
+    memcpy(grid[0], grid[sim->ROWS], sizeof(int) * (sim->COLUMNS + 2));  // first row is the ghost of the last interior row
+    memcpy(grid[sim->ROWS + 1], grid[1], sizeof(int) * (sim->COLUMNS + 2));  // and the last row the ghost of the first
+    for (int current_row = 0; current_row <= sim->ROWS + 1; current_row++) {
+        setGhostColumns(grid[current_row], &sim->COLUMNS);
+    }
+}
+
+/* describe() */
+/* fills in the view of the current grid */
+static void describe(const struct fungi_sim * sim, struct fungi_view * view) {
+    view->cells = &sim->current_grid[1][1];
+    view->rows = sim->ROWS;
+    view->columns = sim->COLUMNS;
+    view->stride = sim->COLUMNS + 2;
+    view->time_step = sim->current_time_step;
+}
+
+/* fail() */
+/* keeps the message of a failed call for fungi_error() and returns -1 */
+static int fail(const struct fungi_sim * sim, const char * message, const char * name) {
+    snprintf(sim->error, ERROR_LENGTH, message, name);
+    return -1;
+}
+
+// end of file
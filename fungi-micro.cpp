@@ -0,0 +1,330 @@
+/*******************************************************************************************
+ * fungi-micro.cpp
+ *******************************************************************************************
+ *
+ * micro-benchmarks the kernels of the sequential simulation one at a time: initializeGrid(),
+ * check_neighbors(), the state transition of updateCell(), copyGrid(), and a TRNG draw (straight
+ * from the engine and through the batched row_draws buffer the kernels use)
+ *
+ * the kernels are the engine's own (fungi-seq.cpp is included with its main left out), and each
+ * one is run on synthetic grids whose mix of states is controlled:
+ *      empty - every cell EMPTY, so updateCell() only scans neighbors and never draws
+ *      front - dense YOUNG rings every few cells, so most EMPTY cells draw and may spread
+ *      mix   - every state in equal measure, so the switch branches unpredictably
+ *
+ * every kernel is timed over several repetitions (after one untimed warmup) and the median is
+ * reported as ns per cell and as GB/s of the grid traffic it must do at the least (each cell read
+ * once, and written once if the kernel writes), next to the fraction of a STREAM-style copy
+ * bandwidth measured on the same machine; a kernel near 100% is memory bound, and one far below
+ * it is bound by compute, branches, or the RNG
+ *
+ * updateCell() is timed twice: with the built-in rule set (the default_rules instantiation the
+ * engines normally run) and with the same probabilities held in a runtime_rules, which is what a
+ * run with -p or -f pays
+ *
+*/
+
+/* ENGINE */
+    #define NO_MAIN  // take the kernels but not the main of the sequential engine
+    #include "fungi-seq.cpp"
+    #include <vector>
+    #include <algorithm>
+    #include <trng/uniform01_dist.hpp>
+
+/* UNIVERSAL CONSTANTS */
+    // defaults
+    #define DEFAULT_ROWS 1024            // rows of the synthetic grids
+    #define DEFAULT_COLUMNS 1024         // columns of the synthetic grids
+    #define DEFAULT_REPETITIONS 11       // timed runs per kernel (the median is reported)
+    #define DEFAULT_SEED 12345           // seed for the synthetic grids and the RNG kernel
+    #define STREAM_CELLS (1 << 25)       // ints per STREAM array (128 MB, well past the last-level cache)
+
+    // spacing of the YOUNG rings in the front grid
+    #define FRONT_SPACING 4
+
+    // synthetic grids
+    #define GRID_EMPTY 0
+    #define GRID_FRONT 1
+    #define GRID_MIX 2
+    #define GRIDS 3
+
+/* FUNCTION DECLARATIONS */
+void getMicroArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * REPETITIONS, long * SEED);
+void fillGrid(int ***grid, int * ROWS, int * COLUMNS, int pattern, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform);
+double median(std::vector<double> * times);
+double streamCopy(int * REPETITIONS);
+void report(const char * kernel, const char * grid, double seconds, double items, double bytes, double stream_bandwidth);
+
+const char * grid_names[] = { "empty", "front", "mix" };
+
+volatile long sink;  // keeps kernel results alive so the compiler cannot drop the work
+
+/* main */
+int main(int argc, char **argv){
+
+    // declare variables
+    int ROWS, COLUMNS, REPETITIONS;  // hold command line arguments
+    long SEED;  // seed for the synthetic grids
+    int **current_grid;  // synthetic grid being read
+    int **next_grid;  // grid written by the transition
+    int current_row, current_column;  // grid cell counters
+    int neighbor_row, neighbor_column;  // check_neighbors() counters
+    int current_value;  // current cell's state
+    unsigned long prob;  // stores raw random draws
+    double start_time;  // timer value
+    double cells;  // interior cells per grid
+    double stream_bandwidth;  // bytes per second of the STREAM copy
+    std::vector<double> times;  // seconds per repetition
+    struct runtime_rules rules;  // built-in probabilities, held as runtime thresholds
+    struct row_draws draws;  // batched draws for updateCell()
+
+    // initialize random number engine
+    trng::yarn2 yarn;  // create engine object
+    trng::uniform01_dist<> uniform;  // create distribution fxn
+
+    // parse command line arguments
+    getMicroArguments(argc, argv, &ROWS, &COLUMNS, &REPETITIONS, &SEED);
+    yarn.seed((long unsigned int)SEED);
+    rules_default(&rules);
+    rules_finish(&rules, argv[0]);
+    cells = (double)ROWS * COLUMNS;
+
+    // allocate grids
+    allocateGrid(&current_grid, &ROWS, &COLUMNS, &current_row);
+    allocateGrid(&next_grid, &ROWS, &COLUMNS, &current_row);
+    fillGrid(&next_grid, &ROWS, &COLUMNS, GRID_EMPTY, &yarn, &uniform);
+
+    // memory bandwidth baseline
+    stream_bandwidth = streamCopy(&REPETITIONS);
+    printf("kernel\tgrid\tns per cell\tGB/s\tof stream\n");
+    printf("stream copy\t-\t-\t%.2f\t100%%\n", stream_bandwidth / 1e9);
+
+    // TRNG draw (one raw draw per item, as the kernels compare them with thresholds)
+    times.clear();
+    for (int repetition = 0; repetition <= REPETITIONS; repetition++) {  // repetition 0 is the warmup
+        unsigned long sum = 0;
+        start_time = c_get_wtime();
+        for (long item = 0; item < (long)cells; item++) {
+            sum += draw(&yarn);
+        }
+        if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+        sink = (long)sum;
+    }
+    report("rng draw", "-", median(&times), cells, 0.0, stream_bandwidth);
+
+    // batched TRNG draw (one draw per item, generated DRAW_BATCH at a time as the kernels get them)
+    times.clear();
+    for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+        unsigned long sum = 0;
+        row_draws_start(&draws, &yarn, &ROWS, &COLUMNS, repetition, 1);
+        start_time = c_get_wtime();
+        for (long item = 0; item < (long)cells; item++) {
+            sum += next_draw(&draws);
+        }
+        if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+        sink = (long)sum;
+    }
+    report("rng batch", "-", median(&times), cells, 0.0, stream_bandwidth);
+
+    // initial grid (writes every cell once, and draws about once per spore)
+    times.clear();
+    for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+        start_time = c_get_wtime();
+        initializeGrid(&current_grid, &ROWS, &COLUMNS, &current_row, &yarn, &rules);
+        if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+        sink = current_grid[ROWS / 2 + 1][COLUMNS / 2 + 1];
+    }
+    report("initializeGrid", "-", median(&times), cells, cells * sizeof(int), stream_bandwidth);
+
+    for (int pattern = 0; pattern < GRIDS; pattern++) {  // for each synthetic grid...
+        fillGrid(&current_grid, &ROWS, &COLUMNS, pattern, &yarn, &uniform);
+
+        // neighbor scan of every cell (reads the grid once)
+        times.clear();
+        for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+            long found = 0;
+            start_time = c_get_wtime();
+            for (current_row = 1; current_row <= ROWS; current_row++) {
+                for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                    found += check_neighbors(&current_grid, &current_row, &current_column, &neighbor_row, &neighbor_column);
+                }
+            }
+            if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+            sink = found;
+        }
+        report("check_neighbors", grid_names[pattern], median(&times), cells, cells * sizeof(int), stream_bandwidth);
+
+        // state transition of every cell (reads current_grid, writes next_grid; current_grid is untouched so every repetition sees the same mix)
+        times.clear();
+        for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+            row_draws_start(&draws, &yarn, &ROWS, &COLUMNS, repetition, 1);
+            start_time = c_get_wtime();
+            for (current_row = 1; current_row <= ROWS; current_row++) {
+                for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                    updateCell(&current_grid, &next_grid, &current_row, &current_column, &neighbor_row, &neighbor_column, &current_value, &prob, &draws, &built_in_rules, NULL, NULL, NULL);
+                }
+            }
+            if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+            sink = next_grid[ROWS / 2 + 1][COLUMNS / 2 + 1];
+        }
+        report("updateCell", grid_names[pattern], median(&times), cells, 2 * cells * sizeof(int), stream_bandwidth);
+
+        // the same transition with the thresholds read at runtime
+        times.clear();
+        for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+            row_draws_start(&draws, &yarn, &ROWS, &COLUMNS, repetition, 1);
+            start_time = c_get_wtime();
+            for (current_row = 1; current_row <= ROWS; current_row++) {
+                for (current_column = 1; current_column <= COLUMNS; current_column++) {
+                    updateCell(&current_grid, &next_grid, &current_row, &current_column, &neighbor_row, &neighbor_column, &current_value, &prob, &draws, &rules, NULL, NULL, NULL);
+                }
+            }
+            if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+            sink = next_grid[ROWS / 2 + 1][COLUMNS / 2 + 1];
+        }
+        report("updateCell runtime", grid_names[pattern], median(&times), cells, 2 * cells * sizeof(int), stream_bandwidth);
+
+        // copy of the whole grid (copies the synthetic grid onto next_grid, so it survives for the next repetition)
+        times.clear();
+        for (int repetition = 0; repetition <= REPETITIONS; repetition++) {
+            start_time = c_get_wtime();
+            copyGrid(&next_grid, &current_grid, &ROWS, &COLUMNS, &current_row, &current_column);
+            if (repetition > 0) { times.push_back(c_get_wtime() - start_time); }
+            sink = next_grid[ROWS / 2 + 1][COLUMNS / 2 + 1];
+        }
+        report("copyGrid", grid_names[pattern], median(&times), cells, 2 * cells * sizeof(int), stream_bandwidth);
+    }
+
+    // deallocate grids
+    deallocateGrid(&current_grid, &ROWS, &current_row);
+    deallocateGrid(&next_grid, &ROWS, &current_row);
+
+    // return statement
+    return 0;
+
+}
+
+/* getMicroArguments() */
+/* fetches and stores command line arguments for the grid size, repetitions, and seed */
+void getMicroArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * REPETITIONS, long * SEED) {
+
+    // initialize variables
+    int c;
+    *ROWS = DEFAULT_ROWS;
+    *COLUMNS = DEFAULT_COLUMNS;
+    *REPETITIONS = DEFAULT_REPETITIONS;
+    *SEED = DEFAULT_SEED;
+
+    // retrieve command line arguments
+    while ((c = getopt (argc, argv, "r:c:n:x:")) != -1) {
+        switch (c) {
+            case 'r':
+                *ROWS = atoi(optarg);
+                break;
+
+            case 'c':
+                *COLUMNS = atoi(optarg);
+                break;
+
+            case 'n':
+                *REPETITIONS = atoi(optarg);
+                break;
+
+            case 'x':
+                *SEED = atol(optarg);
+                break;
+
+            case '?':
+                if (optopt == 'r' || optopt == 'c' || optopt == 'n' || optopt == 'x') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (isprint (optopt)) {
+                    fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                } else {
+                    fprintf (stderr, "Unknown option character `\\x%x'.\n", optopt);
+                }
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // check command line arguments
+    if (*ROWS < 1) {
+        fprintf(stderr, "Usage: %s -r number of rows must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*COLUMNS < 1) {
+        fprintf(stderr, "Usage: %s -c number of columns must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*REPETITIONS < 1) {
+        fprintf(stderr, "Usage: %s -n number of repetitions must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*SEED < 0) {
+        fprintf(stderr, "Usage: %s -x RNG seed must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* fillGrid() */
+/* fills every cell of the grid, ghosts included, with one of the synthetic patterns */
+void fillGrid(int ***grid, int * ROWS, int * COLUMNS, int pattern, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform) {
+    int center_row = ((*ROWS) + 1) / 2;
+    int center_column = ((*COLUMNS) + 1) / 2;
+    for (int row = 0; row <= (*ROWS) + 1; row++) {  // for each row in the grid...
+        for (int column = 0; column <= (*COLUMNS) + 1; column++) {  // for each cell in that row...
+            if (pattern == GRID_FRONT) {  // YOUNG on square rings around the center, EMPTY between them
+                int distance = std::max(abs(row - center_row), abs(column - center_column));
+                (*grid)[row][column] = (distance % FRONT_SPACING == 0) ? YOUNG : EMPTY;
+            } else if (pattern == GRID_MIX) {  // any live or dead state, equally likely
+                (*grid)[row][column] = (int)((*uniform)(*yarn) * (DEPLETED + 1)) % (DEPLETED + 1);
+            } else {
+                (*grid)[row][column] = EMPTY;
+            }
+        }
+    }
+}
+
+/* median() */
+/* returns the median of the repetition times */
+double median(std::vector<double> * times) {
+    std::sort(times->begin(), times->end());
+    size_t middle = times->size() / 2;
+    return (times->size() % 2 == 1) ? (*times)[middle] : ((*times)[middle - 1] + (*times)[middle]) / 2.0;
+}
+
+/* streamCopy() */
+/* measures the memory bandwidth of a STREAM-style copy of ints and returns the best rate in bytes per second */
+double streamCopy(int * REPETITIONS) {
+    int *source = new int[STREAM_CELLS];
+    int *destination = new int[STREAM_CELLS];
+    double best = 0.0;
+    for (long i = 0; i < STREAM_CELLS; i++) {  // touch every page before timing
+        source[i] = (int)(i & 7);
+        destination[i] = 0;
+    }
+    for (int repetition = 0; repetition <= (*REPETITIONS); repetition++) {
+        double start_time = c_get_wtime();
+        for (long i = 0; i < STREAM_CELLS; i++) {
+            destination[i] = source[i];
+        }
+        double seconds = c_get_wtime() - start_time;
+        double bandwidth = 2.0 * sizeof(int) * STREAM_CELLS / seconds;  // one read and one write per element, as STREAM counts it
+        if (repetition > 0 && bandwidth > best) { best = bandwidth; }
+        sink = destination[STREAM_CELLS / 2];
+    }
+    delete [] source;
+    delete [] destination;
+    return best;
+}
+
+/* report() */
+/* prints one kernel's row: ns per item, and if the kernel moves grid data, its bandwidth and fraction of the STREAM copy */
+void report(const char * kernel, const char * grid, double seconds, double items, double bytes, double stream_bandwidth) {
+    if (bytes > 0.0) {
+        printf("%s\t%s\t%.3f\t%.2f\t%.0f%%\n", kernel, grid, seconds * 1e9 / items, bytes / seconds / 1e9, 100.0 * (bytes / seconds) / stream_bandwidth);
+    } else {
+        printf("%s\t%s\t%.3f\t-\t-\n", kernel, grid, seconds * 1e9 / items);
+    }
+}
+
+// end of file
@@ -20,7 +20,6 @@
     #include <cstdlib>
     #include <iostream>
     #include <trng/yarn2.hpp>
-    #include <trng/uniform01_dist.hpp>
     #include <locale.h>
     #include <wchar.h>
     #include <omp.h>
@@ -47,14 +46,42 @@
     #define DEPLETED 9   // area whose nutrients have previously been depleted by fungal growth
     #define INERT 10     // inert area where plants cannot grow
 
+/* PROJECT HEADERS */
+    #include "fungi_networks.h"  // labels connected mycelium networks (must follow the cell states)
+    #include "fungi_rings.h"  // tracks fairy ring radius and expansion (must follow the cell states and fungi_networks.h)
+    #include "fungi_profile.h"  // per-phase timing and hardware counters (enabled with -DPROFILE)
+    #include "fungi_streams.h"  // one block of random draws per row per time step
+    #include "fungi_hash.h"  // per-time-step grid hashes for comparing engines
+    #include "fungi_rules.h"  // runtime transition probabilities (must follow the probabilities)
+    #include "fungi_terrain.h"  // memory-mapped INERT masks and state rasters (must follow the cell states)
+    #include "fungi_nutrients.h"  // optional per-cell nutrient levels (must follow the cell states)
+    #include "fungi_soil.h"  // spatially varying soil quality (must follow fungi_rules.h and fungi_terrain.h)
+    #include "fungi_ensemble.h"  // statistics of ensemble runs (must follow the cell states)
+    #include "fungi_sweep.h"  // parameter sweeps (must follow fungi_rules.h and fungi_ensemble.h)
+    #include "fungi_steady.h"  // extinction detection and early termination (must follow fungi_ensemble.h)
+    #include "fungi_lines.h"  // rolling line buffers for the in-place update
+    #include "fungi_monitor.h"  // live view of a run in shared memory for fungi-view.cpp
+    #include "fungi_tune.h"  // cached auto-tuning of threads, schedule, and layout
+    #include "fungi_dispersal.h"  // long-range spore dispersal by FFT convolution (must follow the cell states, fungi_streams.h, and fungi_rules.h)
+    #include "fungi_colonies.h"  // colony ids of competing colonies (must follow the cell states and fungi_networks.h)
+
 /* FUNCTION DECLARATIONS */
-void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS);
+void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, int ** network_steps, int * RING_INTERVAL, long * SEED, int * HASHES, int * REPLICAS, struct runtime_rules * rules, struct sweep * sweep, char ** TERRAIN, int * NUTRIENTS, char ** SOIL, int * IN_PLACE, int * STEADY, char ** MONITOR, char ** TUNE, char ** DISPERSAL, char ** COLONIES);
 void allocateGrid(int ***grid, int * ROWS, int * COLUMNS);
-void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform);
-void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_value, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform);
+void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, trng::yarn2 * yarn, struct runtime_rules * rules);
+int mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, trng::yarn2 * yarn, int * network_steps, struct ring_tracker * rings, struct nutrient_field * nutrients, struct soil * soil, struct line_buffer * lines, struct monitor * monitor, struct dispersal * dispersal, struct colony_field * colonies, int * HASHES, int * STEADY, struct runtime_rules * rules);
+void ensemble(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, int * REPLICAS, long * SEED, struct runtime_rules * rules, struct terrain * terrain, int * NUTRIENTS, struct soil * soil, int * STEADY);
+void parameterSweep(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, long * SEED, struct runtime_rules * rules, struct sweep * sweep, struct terrain * terrain, int * NUTRIENTS, int * STEADY);
+void updateRows(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int current_time_step, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, struct steady_tally * steady);
+void updateRowsInPlace(int ***grid, int ***next_rows, int * ROWS, int * COLUMNS, int current_time_step, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, struct line_buffer * lines, struct steady_tally * steady);
+void updateRow(int ***current_grid, int ***next_grid, int * COLUMNS, int current_row, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, int quiet);
+void updateSpan(int ***current_grid, int ***next_grid, int current_row, int first_column, int last_column, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, int quiet);
+template <bool QUIET, class RULES> void updateCells(int ***current_grid, int ***next_grid, int current_row, int first_column, int last_column, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies);
 void copyGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS);
 int check_neighbors(int ***current_grid, int current_row, int current_column);
 void deallocateGrid(int ***grid, int * ROWS);
+void autoTune(int * ROWS, int * COLUMNS, struct runtime_rules * rules, struct tune_config * best, int * trials);
+double tuneTrial(struct tune_config * config, int ***current_grid, int ***next_grid, int ***next_rows, int * ROWS, int * COLUMNS, trng::yarn2 * yarn, struct runtime_rules * rules);
 void print_number_grid(int ***grid, int * ROWS, int * COLUMNS);
 void print_colorful_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_value);
 void reset_color();
@@ -73,6 +100,33 @@ int main(int argc, char **argv){
     int ROWS, COLUMNS, TIME_STEPS, THREADS;  // store command line arguments
     int **current_grid;  // grid at current time step
     int **next_grid;  // grid at next time step
+    int *network_steps;  // time steps to report mycelium networks at (NULL if none)
+    int RING_INTERVAL;  // time steps between fairy ring reports (0 if none)
+    long SEED;  // RNG seed (-1 if not given)
+    int HASHES;  // print a hash of the grid at every time step (1) or not (0)
+    int REPLICAS;  // replicas to run as an ensemble (0 for a single run)
+    struct runtime_rules rules;  // transition probabilities and their thresholds
+    struct sweep sweep;  // parameter ranges to sweep (no points for a single run)
+    char *TERRAIN;  // terrain mask or state raster file (NULL if none)
+    struct terrain *terrain = NULL;  // mapped terrain mask (NULL if none)
+    int NUTRIENTS;  // model nutrient levels (1) or not (0)
+    struct nutrient_field *nutrients = NULL;  // nutrient levels (NULL if not modeled)
+    char *SOIL;  // soil quality map file (NULL if none)
+    struct soil *soil = NULL;  // mapped soil quality (NULL if none)
+    int IN_PLACE;  // update a single grid in place (1) or a current and a next grid (0)
+    struct line_buffer *lines = NULL;  // each thread's spare rows (NULL unless in place)
+    int STEADY;  // stop once the grid dies out (1) or always run every time step (0)
+    int last_step;  // time step the run stopped at
+    char *MONITOR;  // shared memory name to publish the run under (NULL if none)
+    struct monitor *monitor = NULL;  // published view and counters (NULL if not monitored)
+    char *TUNE;  // auto-tuning cache file (NULL to take -t and -i as given)
+    struct tune_config tuned;  // the configuration auto-tuning picked
+    int tune_trials = 0;  // candidates timed (0 if the cache had the shape)
+    char *DISPERSAL;  // dispersal kernel and rates (NULL if spores only spread locally)
+    struct dispersal *dispersal = NULL;  // long-range dispersal (NULL if none)
+    char *COLONIES;  // colony tie-breaking rule (NULL if colonies aren't told apart)
+    struct colony_field *colonies = NULL;  // colony ids (NULL if not tracked)
+    struct ring_tracker *rings = NULL;  // fairy ring geometry (NULL if not tracked)
     // int current_row, current_column;  // grid cell counters
     // int current_time_step;  // time step counter
     // int neighbor_row, neighbor_column;  // check_neighbors() counters
@@ -83,7 +137,50 @@ int main(int argc, char **argv){
 
     // parse command line arguments
         // (need to do before parallel section to get the number of threads)
-    getArguments(argc, argv, &ROWS, &COLUMNS, &TIME_STEPS, &THREADS);
+    getArguments(argc, argv, &ROWS, &COLUMNS, &TIME_STEPS, &THREADS, &network_steps, &RING_INTERVAL, &SEED, &HASHES, &REPLICAS, &rules, &sweep, &TERRAIN, &NUTRIENTS, &SOIL, &IN_PLACE, &STEADY, &MONITOR, &TUNE, &DISPERSAL, &COLONIES);
+    if (TERRAIN != NULL) { terrain = terrain_open_mask(TERRAIN, &ROWS, &COLUMNS, argv[0]); }
+    if (SOIL != NULL) { soil = soil_open(SOIL, &ROWS, &COLUMNS, &rules, argv[0]); }
+    omp_set_schedule(omp_sched_static, 0);  // the update's row loop is split into even blocks unless tuned otherwise
+
+    // pick the thread count, schedule, and layout for this machine and grid shape if asked to
+    if (TUNE != NULL) {
+        start_time = omp_get_wtime();
+        if (!tune_lookup(TUNE, &ROWS, &COLUMNS, &tuned)) {  // time the candidates the first time round
+            autoTune(&ROWS, &COLUMNS, &rules, &tuned, &tune_trials);
+            tune_store(TUNE, &ROWS, &COLUMNS, &tuned);
+        }
+        report_tune(&tuned, TUNE, tune_trials, omp_get_wtime() - start_time);
+        THREADS = tuned.threads;
+        omp_set_num_threads(THREADS);
+        omp_set_schedule(tuned.schedule, tuned.chunk);
+        IN_PLACE = tuned.in_place;
+    }
+
+    // run an ensemble instead of a single simulation if asked to
+    if (REPLICAS > 0) {
+        if (SEED < 0) { SEED = (long)time(NULL); }  // replicas are seeded SEED, SEED + 1, ...
+        start_time = omp_get_wtime();
+        ensemble(&ROWS, &COLUMNS, &TIME_STEPS, &THREADS, &REPLICAS, &SEED, &rules, terrain, &NUTRIENTS, soil, &STEADY);
+        end_time = omp_get_wtime();
+        printf("%f", end_time - start_time);
+        terrain_close(terrain);
+        soil_close(soil);
+        return 0;
+    }
+
+    // or a parameter sweep
+    if (sweep.points > 0) {
+        if (SEED < 0) { SEED = (long)time(NULL); }  // every point uses the same seed
+        start_time = omp_get_wtime();
+        parameterSweep(&ROWS, &COLUMNS, &TIME_STEPS, &THREADS, &SEED, &rules, &sweep, terrain, &NUTRIENTS, &STEADY);
+        end_time = omp_get_wtime();
+        printf("%f", end_time - start_time);
+        terrain_close(terrain);
+        return 0;
+    }
+
+    // set up per-phase profiling (does nothing unless built with PROFILE)
+    PROFILE_INIT();
 
     // start timing
     start_time = omp_get_wtime();
@@ -93,31 +190,45 @@ int main(int argc, char **argv){
     // {
 
         // declare thread private variables
-        int current_value;  // hold grid print values
-        double prob;  // stores randomly generated probability values
         // int current_thread;  // stores thread rank
 
         // initialize RNG engine
         trng::yarn2 yarn;
 
-        // seed RNG
-        yarn.seed((long unsigned int)time(NULL));
-
-        // split RNG by threads
-        yarn.split(THREADS, omp_get_thread_num());
+        // seed RNG (with the clock unless a seed was given)
+        yarn.seed((SEED >= 0) ? (long unsigned int)SEED : (long unsigned int)time(NULL));
 
-        // initialize RNG distribution function
-        trng::uniform01_dist<> uniform;
+        // note: the RNG is not split by threads; each row of each time step draws from its own block
+            // of the sequence (see fungi_streams.h), so the grid does not depend on the number of threads
 
         // allocate grids
         allocateGrid(&current_grid, &ROWS, &COLUMNS);
-        allocateGrid(&next_grid, &ROWS, &COLUMNS);
+        if (IN_PLACE) {  // only row pointers; the new rows come from the line buffers
+            next_grid = new int*[ROWS + 2];
+            lines = line_buffers_create(THREADS, &COLUMNS);
+        } else {
+            allocateGrid(&next_grid, &ROWS, &COLUMNS);
+        }
+        if (RING_INTERVAL > 0) { rings = rings_create(&ROWS, &COLUMNS, RING_INTERVAL); }
+        if (NUTRIENTS) { nutrients = nutrients_create(&ROWS, &COLUMNS); }
+        if (MONITOR != NULL) { monitor = monitor_open(MONITOR, &ROWS, &COLUMNS, &TIME_STEPS, argv[0]); }
+        if (DISPERSAL != NULL) { dispersal = dispersal_create(DISPERSAL, &ROWS, &COLUMNS, argv[0]); }
+        if (COLONIES != NULL) { colonies = colonies_create(COLONIES, &ROWS, &COLUMNS, argv[0]); }
 
         // initialize current_grid
-        initializeGrid(&current_grid, &ROWS, &COLUMNS, &prob, &yarn, &uniform);
+        initializeGrid(&current_grid, &ROWS, &COLUMNS, &yarn, &rules);
+        if (terrain != NULL) { terrain_apply(terrain, &current_grid, &ROWS, &COLUMNS); }
+        if (rings != NULL) { rings_found(rings, &current_grid); }  // (hyphae from a state raster)
+        if (colonies != NULL) { colonies_found(colonies, &current_grid, argv[0]); }
 
         // run the simulation
-        mushrooms(&current_grid, &next_grid, &ROWS, &COLUMNS, &TIME_STEPS, &current_value, &prob, &yarn, &uniform);
+        last_step = mushrooms(&current_grid, &next_grid, &ROWS, &COLUMNS, &TIME_STEPS, &yarn, network_steps, rings, nutrients, soil, lines, monitor, dispersal, colonies, &HASHES, &STEADY, &rules);
+        if (last_step < TIME_STEPS) {
+            fprintf(stderr, "steady: grid died out at time step %d, skipping %d of %d time steps\n", last_step, TIME_STEPS - last_step, TIME_STEPS);
+        }
+        monitor_close(monitor);
+        if (dispersal != NULL) { report_dispersal(dispersal); }
+        if (colonies != NULL) { report_colonies(colonies, TIME_STEPS); }
 
     
     // }
@@ -130,10 +241,23 @@ int main(int argc, char **argv){
     #else
         printf("%f", total_time);
     #endif
+    PROFILE_REPORT();
 
     // deallocate grids
     deallocateGrid(&current_grid, &ROWS);
-    deallocateGrid(&next_grid, &ROWS);
+    if (IN_PLACE) {
+        delete [] next_grid;
+        line_buffers_destroy(lines, THREADS);
+    } else {
+        deallocateGrid(&next_grid, &ROWS);
+    }
+    delete [] network_steps;
+    rings_destroy(rings);
+    terrain_close(terrain);
+    nutrients_destroy(nutrients);
+    soil_close(soil);
+    dispersal_destroy(dispersal);
+    colonies_destroy(colonies);
 
     // return statement
     return 0;
@@ -141,8 +265,8 @@ int main(int argc, char **argv){
 }
 
 /* getArguments() */
-/* fetches and stores command line arguments for # of rows, columns, time steps, and threads */
-void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS) {
+/* fetches and stores command line arguments for # of rows, columns, time steps, threads, network report steps, ring report interval, RNG seed, grid hashes, ensemble replicas, transition probabilities, parameter sweep, terrain mask, nutrient model, soil quality map, in-place update, early termination, live monitoring, auto-tuning, spore dispersal, and colony tie-breaking */
+void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, int ** network_steps, int * RING_INTERVAL, long * SEED, int * HASHES, int * REPLICAS, struct runtime_rules * rules, struct sweep * sweep, char ** TERRAIN, int * NUTRIENTS, char ** SOIL, int * IN_PLACE, int * STEADY, char ** MONITOR, char ** TUNE, char ** DISPERSAL, char ** COLONIES) {
     
     // initialize variables
     int c;
@@ -150,9 +274,27 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
     int cflag = 0;
     int sflag = 0;
     int tflag = 0;
+    int nflag = 0;
+    char *network_list = NULL;  // comma-separated time steps to report networks at
+    int gflag = 0;
+    int xflag = 0;
+    int eflag = 0;
+    int wflag = 0;
+    char *sweep_list = NULL;  // comma-separated parameter ranges to sweep
+    *HASHES = 0;
+    *TERRAIN = NULL;  // no terrain mask unless -m gives one
+    *NUTRIENTS = 0;  // no nutrient model unless -u asks for one
+    *SOIL = NULL;  // uniform soil unless -q gives a map
+    *IN_PLACE = 0;  // a current and a next grid unless -i asks for one
+    *STEADY = 0;  // every time step unless -d asks to stop early
+    *MONITOR = NULL;  // not published unless -v names it
+    *TUNE = NULL;  // -t and -i as given unless -a asks to tune them
+    *DISPERSAL = NULL;  // spores spread only to neighbors unless -l adds dispersal
+    *COLONIES = NULL;  // colonies aren't told apart unless -y asks to
+    rules_default(rules);  // built-in probabilities unless -f or -p change them
 
     // retrieve command line arguments
-    while ((c = getopt (argc, argv, "r:c:s:t:")) != -1) {
+    while ((c = getopt (argc, argv, "r:c:s:t:n:g:x:ke:p:f:w:m:uq:idv:a:l:y:")) != -1) {
         switch (c) {
             case 'r':
                 rflag = 1;
@@ -175,6 +317,79 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
                 omp_set_num_threads( atoi(optarg) );
                 break;
             
+            case 'n':
+                nflag = 1;
+                network_list = optarg;
+                break;
+            
+            case 'g':
+                gflag = 1;
+                *RING_INTERVAL = atoi(optarg);
+                break;
+            
+            case 'x':
+                xflag = 1;
+                *SEED = atol(optarg);
+                break;
+            
+            case 'k':
+                *HASHES = 1;
+                break;
+            
+            case 'e':
+                eflag = 1;
+                *REPLICAS = atoi(optarg);
+                break;
+            
+            case 'p':
+                rules_parse(rules, optarg, argv[0]);
+                break;
+            
+            case 'f':
+                rules_load(rules, optarg, argv[0]);
+                break;
+            
+            case 'w':
+                wflag = 1;
+                sweep_list = optarg;
+                break;
+            
+            case 'm':
+                *TERRAIN = optarg;
+                break;
+            
+            case 'u':
+                *NUTRIENTS = 1;
+                break;
+            
+            case 'q':
+                *SOIL = optarg;
+                break;
+            
+            case 'i':
+                *IN_PLACE = 1;
+                break;
+            
+            case 'd':
+                *STEADY = 1;
+                break;
+            
+            case 'v':
+                *MONITOR = optarg;
+                break;
+            
+            case 'a':
+                *TUNE = optarg;
+                break;
+            
+            case 'l':
+                *DISPERSAL = optarg;
+                break;
+            
+            case 'y':
+                *COLONIES = optarg;
+                break;
+            
             case '?':
                 if (optopt == 'r') {
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
@@ -184,6 +399,32 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 } else if (optopt == 't') {
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'n') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'g') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'x') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'e') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'p') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'f') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'w') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'm') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'q') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'v') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'a') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'l') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'y') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 } else if (isprint (optopt)) {
                     fprintf (stderr, "Unknown option `-%c'.\n", optopt);
                 } else {
@@ -218,14 +459,104 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
         fprintf(stderr, "Usage: %s -s number of time steps must be a positive nonzero integer\n", argv[0]);
         exit(EXIT_FAILURE);
     }
-    if (tflag == 0) {
+    if (tflag == 0 && *TUNE == NULL) {
         fprintf(stderr, "Usage: %s -t number of threads\n", argv[0]);
         exit(EXIT_FAILURE);
     }
-    if (*THREADS < 1) {
+    if (tflag == 0) {
+        *THREADS = 1;  // chosen by -a
+    } else if (*THREADS < 1) {
         fprintf(stderr, "Usage: %s -t number of threads must be a positive nonzero integer\n", argv[0]);
         exit(EXIT_FAILURE);
     }
+    if (gflag == 0) {
+        *RING_INTERVAL = 0;  // rings are only tracked when asked for
+    } else if (*RING_INTERVAL < 1) {
+        fprintf(stderr, "Usage: %s -g number of time steps between ring reports must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (xflag == 0) {
+        *SEED = -1;  // no seed given
+    } else if (*SEED < 0) {
+        fprintf(stderr, "Usage: %s -x RNG seed must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    rules_finish(rules, argv[0]);
+    if (eflag == 0) {
+        *REPLICAS = 0;  // a single simulation
+    } else if (*REPLICAS < 1) {
+        fprintf(stderr, "Usage: %s -e number of replicas must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    } else if (nflag == 1 || gflag == 1 || *HASHES == 1) {
+        fprintf(stderr, "Usage: %s -e ensembles report their own statistics and cannot be combined with -n, -g, or -k\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    sweep->points = 0;  // no sweep unless asked for
+    if (wflag == 1) {
+        sweep_parse(sweep, sweep_list, argv[0]);
+        sweep_points(sweep, rules, argv[0]);
+        if (eflag == 1 || nflag == 1 || gflag == 1 || *HASHES == 1) {
+            fprintf(stderr, "Usage: %s -w sweeps report their own table and cannot be combined with -e, -n, -g, or -k\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (*SOIL != NULL) {  // the soil's rule sets are scaled from one set of probabilities
+            fprintf(stderr, "Usage: %s -w sweeps cannot be combined with -q\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (*IN_PLACE == 1 && (eflag == 1 || wflag == 1)) {  // replicas and sweep points keep their own grids
+        fprintf(stderr, "Usage: %s -i in-place updates cannot be combined with -e or -w\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*STEADY == 1 && (nflag == 1 || gflag == 1)) {  // reports due after the grid died out would never be made
+        fprintf(stderr, "Usage: %s -d early termination cannot be combined with -n or -g\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*MONITOR != NULL && (eflag == 1 || wflag == 1)) {  // only a single run has one grid to show
+        fprintf(stderr, "Usage: %s -v live monitoring cannot be combined with -e or -w\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*TUNE != NULL && (tflag == 1 || *IN_PLACE == 1 || eflag == 1 || wflag == 1)) {  // -a picks the threads and layout itself, for a single run
+        fprintf(stderr, "Usage: %s -a auto-tuning cannot be combined with -t, -i, -e, or -w\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*DISPERSAL != NULL && (eflag == 1 || wflag == 1)) {  // replicas and sweep points run without it
+        fprintf(stderr, "Usage: %s -l dispersal cannot be combined with -e or -w\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*COLONIES != NULL && (eflag == 1 || wflag == 1 || *DISPERSAL != NULL)) {  // (spores carried in by the wind would belong to no colony)
+        fprintf(stderr, "Usage: %s -y colonies cannot be combined with -e, -w, or -l\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    #if defined(PROFILE) || defined(TRACE) || defined(DEBUG)
+        if (eflag == 1) {
+            fprintf(stderr, "Usage: %s -e ensembles need a build without DEBUG, PROFILE, and TRACE\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (wflag == 1) {
+            fprintf(stderr, "Usage: %s -w sweeps need a build without DEBUG, PROFILE, and TRACE\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (*TUNE != NULL) {
+            fprintf(stderr, "Usage: %s -a auto-tuning needs a build without DEBUG, PROFILE, and TRACE\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    #endif
+
+    // mark the time steps that get a network report
+    *network_steps = NULL;
+    if (nflag == 1) {
+        *network_steps = new int[(*TIME_STEPS) + 1]();  // one flag per time step, all cleared
+        for (char *step = strtok(network_list, ","); step != NULL; step = strtok(NULL, ",")) {  // for each listed time step...
+            int network_step = atoi(step);
+            if (network_step < 0 || network_step > (*TIME_STEPS)) {
+                fprintf(stderr, "Usage: %s -n network report steps must be comma-separated integers between 0 and the number of time steps\n", argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            (*network_steps)[network_step] = 1;  // ...flag it
+        }
+    }
 }
 
 /* allocateGrid() */
@@ -240,193 +571,525 @@ void allocateGrid(int ***grid, int * ROWS, int * COLUMNS) {
 
 /* initializeGrid() */
 /* initializes the grid with empty spaces and spore spaces to begin the simulation */
-void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform) {
-    #pragma omp parallel for collapse(2)
+void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, trng::yarn2 * yarn, struct runtime_rules * rules) {
+    #pragma omp parallel for
     for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
-        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
-            (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-            if ((*prob) <= probSpore) {  // if prob is less than or equal to probSpore...
-                (*grid)[current_row][current_column] = SPORE;  // ...then cell starts as SPORE
-            } else {  // otherwise...
-                (*grid)[current_row][current_column] = EMPTY;  // ...cell starts as EMPTY
-            }
-        }
+        trng::yarn2 row_yarn = row_stream(yarn, ROWS, COLUMNS, INITIAL_STEP, current_row);  // this row's block of draws
+        spore_row((*grid)[current_row], COLUMNS, &row_yarn, rules);  // EMPTY with SPOREs at geometric gaps
     }
 
 }
 
 /* mushrooms() */
-/* simulates the growth of mushroom networks into fairy rings */
-void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_value, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform) {
+/* simulates the growth of mushroom networks into fairy rings; returns the time step it stopped at (TIME_STEPS unless STEADY is set and the grid died out first) */
+int mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, trng::yarn2 * yarn, int * network_steps, struct ring_tracker * rings, struct nutrient_field * nutrients, struct soil * soil, struct line_buffer * lines, struct monitor * monitor, struct dispersal * dispersal, struct colony_field * colonies, int * HASHES, int * STEADY, struct runtime_rules * rules) {
+    struct steady_tally tally;  // the grids' YOUNG and active cells
+    struct steady_tally *steady = (*STEADY) ? &tally : NULL;  // (NULL if not tracked)
+    double start_time = omp_get_wtime();  // for the monitor's elapsed time
+    steady_start(&tally);
     for(int current_time_step = 0; current_time_step <= (*TIME_STEPS); current_time_step++) {  // for each time step... (note: time steps must happen sequentially)
 
         // set up ghost rows
-        #pragma omp parallel for
-        for (int ghost_column = 0; ghost_column <= (*COLUMNS) + 1; ghost_column++) {
+        #pragma omp parallel
+        {
+            PROFILE_BEGIN(PHASE_GHOST_ROWS);
+            #pragma omp for nowait
+            for (int ghost_column = 0; ghost_column <= (*COLUMNS) + 1; ghost_column++) {
 
-            // set first row of grid to be the ghost of the second-to-last row
-            (*current_grid)[0][ghost_column] = (*current_grid)[(*ROWS)][ghost_column];
+                // set first row of grid to be the ghost of the second-to-last row
+                (*current_grid)[0][ghost_column] = (*current_grid)[(*ROWS)][ghost_column];
 
-            // set last row of grid to be the ghost of the second row
-            (*current_grid)[(*ROWS) + 1][ghost_column] = (*current_grid)[1][ghost_column];
+                // set last row of grid to be the ghost of the second row
+                (*current_grid)[(*ROWS) + 1][ghost_column] = (*current_grid)[1][ghost_column];
+            }
+            PROFILE_WORK_DONE(PHASE_GHOST_ROWS);
+            #pragma omp barrier
+            PROFILE_END(PHASE_GHOST_ROWS);
         }
 
         // set up ghost columns
-        #pragma omp parallel for
-        for (int ghost_row = 0; ghost_row <= (*ROWS) + 1; ghost_row++) {
+        #pragma omp parallel
+        {
+            PROFILE_BEGIN(PHASE_GHOST_COLUMNS);
+            #pragma omp for nowait
+            for (int ghost_row = 0; ghost_row <= (*ROWS) + 1; ghost_row++) {
 
-            // set left-most column to be the ghost of the second-farthest-right column
-            (*current_grid)[ghost_row][0] = (*current_grid)[ghost_row][*COLUMNS];
+                // set left-most column to be the ghost of the second-farthest-right column
+                (*current_grid)[ghost_row][0] = (*current_grid)[ghost_row][*COLUMNS];
 
-            // set right-most column to be the ghost of the second-farthest-left column
-            (*current_grid)[ghost_row][(*COLUMNS) + 1] = (*current_grid)[ghost_row][1];
+                // set right-most column to be the ghost of the second-farthest-left column
+                (*current_grid)[ghost_row][(*COLUMNS) + 1] = (*current_grid)[ghost_row][1];
+            }
+            PROFILE_WORK_DONE(PHASE_GHOST_COLUMNS);
+            #pragma omp barrier
+            PROFILE_END(PHASE_GHOST_COLUMNS);
         }
 
         // DEBUG: display current grid
+        PROFILE_BEGIN(PHASE_OUTPUT);
         #ifdef DEBUG
             #ifdef COLOR
+                int current_value;  // hold grid print values
                 setlocale(LC_ALL, "");
                 printf("\ntime step %d:\n", (current_time_step));
-                print_colorful_grid(current_grid, ROWS, COLUMNS, current_value);
+                print_colorful_grid(current_grid, ROWS, COLUMNS, &current_value);
             #else
                 printf("\ntime step %d:\n", (current_time_step));
                 print_number_grid(current_grid, ROWS, COLUMNS);
             #endif
         #endif
 
-        // determine grid at next time step
-        #pragma omp parallel for collapse(2)
-        for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
-            for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
+        // publish this time step to any attached viewers
+        if (monitor != NULL) {
+            monitor_publish(monitor, current_grid, current_time_step, omp_get_wtime() - start_time);
+        }
 
-                (*current_value) = (*current_grid)[current_row][current_column];
+        // report mycelium networks if requested for this time step
+        if (network_steps != NULL && network_steps[current_time_step]) {
+            report_networks(current_grid, ROWS, COLUMNS, current_time_step);
+        }
 
-                switch(*current_value) {
-                
-                    // if current cell is EMPTY...
-                    case 0:
-                        if (check_neighbors(current_grid, current_row, current_column) == 0) {  // if cell has no YOUNG neighbors...
-                            (*next_grid)[current_row][current_column] == EMPTY;  // ...cell stays EMPTY in the next time step
-                        } else {  // otherwise...
-                            (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                            if ((*prob) <= probSpread) {  // if prob is less than or equal to probSpread...
-                                (*next_grid)[current_row][current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
-                            } else {  // otherwise...
-                                (*next_grid)[current_row][current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
-                            }
-                        }
-                        break;
-                    
-                    // if current cell is SPORE...
-                    case 1:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probSporeToYoung) {  // if prob is less than or equal to probSporeToYoung...
-                            (*next_grid)[current_row][current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[current_row][current_column] = SPORE;  // ...cell stays SPORE in the next time step
-                        }
-                        break;
-                    
-                    // if current cell is YOUNG...
-                    case 2:
-                        (*next_grid)[current_row][current_column] = MATURING;  // ...cell becomes MATURING in the next time step
-                        break;
-                    
-                    // if current cell is MATURING...
-                    case 3:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probMaturingToMushrooms) {  // if prob is less than or equal to probMaturingToMushrooms...
-                            (*next_grid)[current_row][current_column] = MUSHROOMS;  // ...cell becomes MUSHROOMS in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[current_row][current_column] = OLDER;  // ...cell becomes OLDER in the next time step
-                        }
-                        break;
-                    
-                    // if current cell is MUSHROOMS...
-                    case 4:
-                        (*next_grid)[current_row][current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
-                        break;
-                    
-                    // if current cell is OLDER...
-                    case 5:
-                        (*next_grid)[current_row][current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
-                        break;
-                    
-                    // if current cell is DECAYING...
-                    case 6:
-                        (*next_grid)[current_row][current_column] = DEAD;  // ...cell becomes DEAD in the next time step
-                        break;
-                    
-                    // if current cell is DEAD...
-                    case 7:
-                        (*next_grid)[current_row][current_column] = DEADER;  // ...cell becomes DEADER in the next time step
-                        break;
-                    
-                    // if current cell is DEADER...
-                    case 8:
-                        (*next_grid)[current_row][current_column] = DEPLETED;  // ...cell becomes DEPLETED in the next time step
-                        break;
-                    
-                    // if current cell is DEPLETED...
-                    case 9:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probDepletedToSpore) {  // if prob is less than or equal to probDepletedToSpore...
-                            (*next_grid)[current_row][current_column] = SPORE;  // ...cell becomes SPORE in the next time step
-                        } else if ((*prob) <= probDepletedToEmpty) {  // if prob is less than or equal to probDepletedToEmpty...
-                            (*next_grid)[current_row][current_column] = EMPTY;  // ...cell becomes EMPTY in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[current_row][current_column] = DEPLETED;  // ...cell stays DEPLETED in the next time step
-                        }
-                        break;
-
-                    // if current cell is INERT... (not currently used)
-                    case 10:
-                            // note: there is the potential to initialize the grid with some cells starting out as inert
-                                // representing spots where fungi cannot grow (rocks etc.) but this has not been implemented
-                        (*next_grid)[current_row][current_column] = INERT;  // ...cell stays INERT in the next time step
-                        break;
-                }
+        // print the grid's hash if requested
+        if (*HASHES) {
+            report_hash(current_grid, ROWS, COLUMNS, current_time_step);
+        }
+
+        // stop if nothing can change any more (the hash of every later time step is this one's)
+        if (steady != NULL && steady_extinct(steady)) {
+            unsigned long long hash = (*HASHES) ? grid_hash(current_grid, ROWS, COLUMNS) : 0;
+            for (int later_step = current_time_step + 1; (*HASHES) && later_step <= (*TIME_STEPS); later_step++) {
+                fprintf(stderr, "hash\t%d\t%016llx\n", later_step, hash);
             }
+            PROFILE_DONE(PHASE_OUTPUT);
+            return current_time_step;
+        }
+        PROFILE_DONE(PHASE_OUTPUT);
+
+        // determine grid at next time step (counting the colonies' cells as they are read at the last one)
+        if (colonies != NULL) { colonies->counting = (current_time_step == (*TIME_STEPS)); }
+        #pragma omp parallel
+        {
+            PROFILE_BEGIN(PHASE_UPDATE);
+            if (lines == NULL) {  // into next_grid
+                updateRows(current_grid, next_grid, ROWS, COLUMNS, current_time_step, yarn, rules, rings, nutrients, colonies, soil, steady);
+            } else {  // or straight into current_grid
+                updateRowsInPlace(current_grid, next_grid, ROWS, COLUMNS, current_time_step, yarn, rules, rings, nutrients, colonies, soil, lines, steady);
+            }
+            PROFILE_WORK_DONE(PHASE_UPDATE);
+            #pragma omp barrier
+            PROFILE_END(PHASE_UPDATE);
         }
         
-        // copy next_grid onto current_grid
-        copyGrid(current_grid, next_grid, ROWS, COLUMNS);
+        // fit the fairy rings to this step's growth front
+        if (rings != NULL) {
+            PROFILE_BEGIN(PHASE_OUTPUT);
+            rings_end_step(rings, current_time_step, (*TIME_STEPS));
+            PROFILE_DONE(PHASE_OUTPUT);
+        }
+
+        // copy next_grid onto current_grid (already done row by row when updating in place)
+        if (lines == NULL) {
+            copyGrid(current_grid, next_grid, ROWS, COLUMNS);
+        }
+
+        // land the spores carried off by the wind, if it is time to
+        if (dispersal != NULL) {
+            dispersal_step(dispersal, current_grid, ROWS, COLUMNS, current_time_step, yarn);
+        }
+        if (steady != NULL) { steady_advance(steady); }
 
         // loop simulation for the next time step
     }
+    return (*TIME_STEPS);
+}
+
+/* updateRows() */
+/* determines this thread's share of the rows of the grid at the next time step, counting the new rows' YOUNG and active cells if they are tracked (called inside a parallel region) */
+void updateRows(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int current_time_step, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, struct steady_tally * steady) {
+    int quiet = (steady != NULL && steady_quiet(steady));  // no YOUNG cell anywhere
+    long young = 0, active = 0;  // this thread's counts for the next grid
+    #pragma omp for schedule(runtime) nowait
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid... (whole rows per thread, so each row draws from its own block in order; the schedule is set in main)
+        struct row_draws draws;  // this row's block of draws (private to the thread)
+        row_draws_start(&draws, yarn, ROWS, COLUMNS, current_time_step, current_row);
+        updateRow(current_grid, next_grid, COLUMNS, current_row, &draws, rules, rings, nutrients, colonies, soil, quiet);
+        if (steady != NULL) { steady_count_row((*next_grid)[current_row], COLUMNS, &young, &active); }
+    }
+    if (steady != NULL) { steady_add(steady, young, active); }
+}
+
+/* updateRowsInPlace() */
+/* determines this thread's band of rows at the next time step straight into the grid, each new row written into one of the thread's spare lines (see fungi_lines.h) whose pointer next_rows holds until the row is swapped in (called inside a parallel region) */
+void updateRowsInPlace(int ***grid, int ***next_rows, int * ROWS, int * COLUMNS, int current_time_step, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, struct line_buffer * lines, struct steady_tally * steady) {
+    int quiet = (steady != NULL && steady_quiet(steady));  // no YOUNG cell anywhere
+    long young = 0, active = 0;  // this thread's counts for the next grid
+    int thread = omp_get_thread_num(), threads = omp_get_num_threads();
+    struct line_buffer *buffer = &lines[thread];  // this thread's spare lines
+    int first_row = (int)((long)(*ROWS) * thread / threads) + 1;  // this thread's band (empty if there are more threads than rows)
+    int last_row = (int)((long)(*ROWS) * (thread + 1) / threads);
+    for (int current_row = first_row; current_row <= last_row; current_row++) {  // for each row in the band...
+        struct row_draws draws;  // this row's block of draws (private to the thread)
+        row_draws_start(&draws, yarn, ROWS, COLUMNS, current_time_step, current_row);
+        (*next_rows)[current_row] = line_take(buffer);
+        updateRow(grid, next_rows, COLUMNS, current_row, &draws, rules, rings, nutrients, colonies, soil, quiet);
+        if (steady != NULL) { steady_count_row((*next_rows)[current_row], COLUMNS, &young, &active); }
+        if (current_row - 1 > first_row) {  // ...the row above has no readers left, so swap it in
+            line_swap(buffer, *grid, current_row - 1, (*next_rows)[current_row - 1]);
+        }
+    }
+
+    // the band's edge rows are read by the neighboring bands, so they wait for every thread
+    #pragma omp barrier
+    if (first_row <= last_row) {
+        line_swap(buffer, *grid, first_row, (*next_rows)[first_row]);
+    }
+    if (last_row > first_row) {
+        line_swap(buffer, *grid, last_row, (*next_rows)[last_row]);
+    }
+    if (steady != NULL) { steady_add(steady, young, active); }
+}
+
+/* updateRow() */
+/* determines one row of the grid at the next time step, with the run's rule set or, given a soil map, each tile's or cell's own */
+void updateRow(int ***current_grid, int ***next_grid, int * COLUMNS, int current_row, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil, int quiet) {
+    if (soil == NULL) {  // the same rule set everywhere
+        updateSpan(current_grid, next_grid, current_row, 1, (*COLUMNS), draws, rules, rings, nutrients, colonies, quiet);
+        return;
+    }
+    for (int tile = 0; tile < soil->tiles_per_row; tile++) {  // for each tile in that row...
+        int first_column = tile * SOIL_TILE + 1;
+        int last_column = (first_column + SOIL_TILE - 1 < (*COLUMNS)) ? first_column + SOIL_TILE - 1 : (*COLUMNS);
+        int value = soil_tile(soil, current_row, tile);
+        if (value != SOIL_VARIED) {  // ...one rule set for the whole tile
+            updateSpan(current_grid, next_grid, current_row, first_column, last_column, draws, &soil->levels[value], rings, nutrients, colonies, quiet);
+        } else {  // ...or one per cell
+            for (int current_column = first_column; current_column <= last_column; current_column++) {
+                updateSpan(current_grid, next_grid, current_row, current_column, current_column, draws, soil_cell(soil, current_row, current_column), rings, nutrients, colonies, quiet);
+            }
+        }
+    }
+}
+
+/* updateSpan() */
+/* determines a run of cells in one row at the next time step, using the kernel with the thresholds folded in when the rule set is the built-in one, and the one that skips check_neighbors() when the grid is quiet */
+void updateSpan(int ***current_grid, int ***next_grid, int current_row, int first_column, int last_column, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, int quiet) {
+    if (rules->is_default) {  // built-in probabilities
+        if (quiet) {
+            updateCells<true>(current_grid, next_grid, current_row, first_column, last_column, draws, &built_in_rules, rings, nutrients, colonies);
+        } else {
+            updateCells<false>(current_grid, next_grid, current_row, first_column, last_column, draws, &built_in_rules, rings, nutrients, colonies);
+        }
+    } else {
+        if (quiet) {
+            updateCells<true>(current_grid, next_grid, current_row, first_column, last_column, draws, rules, rings, nutrients, colonies);
+        } else {
+            updateCells<false>(current_grid, next_grid, current_row, first_column, last_column, draws, rules, rings, nutrients, colonies);
+        }
+    }
+}
+
+/* updateCells() */
+/* determines a run of cells in one row at the next time step, with the transition thresholds of one rule set (QUIET: the grid has no YOUNG cell, so every EMPTY cell stays EMPTY without looking at its neighbors) */
+template <bool QUIET, class RULES>
+void updateCells(int ***current_grid, int ***next_grid, int current_row, int first_column, int last_column, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies) {
+    for (int current_column = first_column; current_column <= last_column; current_column++) {  // for each cell in the run...
+
+        int cell_value = (*current_grid)[current_row][current_column];  // private to the thread
+        unsigned long prob;  // stores random draws (private to the thread)
+        unsigned char *level = (nutrients != NULL) ? nutrient_level(nutrients, current_row, current_column) : NULL;  // this cell's nutrients (NULL if not modeled)
+        if (colonies != NULL) { colony_count(colonies, current_row, current_column, cell_value); }
+
+        switch(cell_value) {
+    
+            // if current cell is EMPTY...
+            case 0:
+                if (QUIET || check_neighbors(current_grid, current_row, current_column) == 0) {  // if cell has no YOUNG neighbors...
+                    (*next_grid)[current_row][current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
+                } else {  // otherwise...
+                    prob = next_draw(draws);  // get random draw
+                    if ((level == NULL) ? (prob < rules->spread) : nutrient_spread(prob, rules->spread, *level)) {  // if the draw is below the probSpread threshold (scaled by the cell's nutrients)...
+                        (*next_grid)[current_row][current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
+                        if (rings != NULL) { rings_spread(rings, current_grid, current_row, current_column); }  // ...and joins its neighbor's colony
+                        if (colonies != NULL) { colony_join(colonies, current_grid, current_row, current_column, prob); }  // ...and takes its colony id
+                    } else {  // otherwise...
+                        (*next_grid)[current_row][current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
+                    }
+                }
+                break;
+        
+            // if current cell is SPORE...
+            case 1:
+                prob = next_draw(draws);  // get random draw
+                if (prob < rules->spore_to_young) {  // if the draw is below the probSporeToYoung threshold...
+                    (*next_grid)[current_row][current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
+                    if (rings != NULL) { rings_birth(rings, current_row, current_column); }  // ...and starts a new colony
+                } else {  // otherwise...
+                    (*next_grid)[current_row][current_column] = SPORE;  // ...cell stays SPORE in the next time step
+                }
+                break;
+        
+            // if current cell is YOUNG...
+            case 2:
+                (*next_grid)[current_row][current_column] = MATURING;  // ...cell becomes MATURING in the next time step
+                break;
+        
+            // if current cell is MATURING...
+            case 3:
+                prob = next_draw(draws);  // get random draw
+                if (prob < rules->maturing_to_mushrooms) {  // if the draw is below the probMaturingToMushrooms threshold...
+                    (*next_grid)[current_row][current_column] = MUSHROOMS;  // ...cell becomes MUSHROOMS in the next time step
+                } else {  // otherwise...
+                    (*next_grid)[current_row][current_column] = OLDER;  // ...cell becomes OLDER in the next time step
+                }
+                break;
+        
+            // if current cell is MUSHROOMS...
+            case 4:
+                (*next_grid)[current_row][current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
+                break;
+        
+            // if current cell is OLDER...
+            case 5:
+                (*next_grid)[current_row][current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
+                break;
+        
+            // if current cell is DECAYING...
+            case 6:
+                (*next_grid)[current_row][current_column] = DEAD;  // ...cell becomes DEAD in the next time step
+                break;
+        
+            // if current cell is DEAD...
+            case 7:
+                (*next_grid)[current_row][current_column] = DEADER;  // ...cell becomes DEADER in the next time step
+                break;
+        
+            // if current cell is DEADER...
+            case 8:
+                (*next_grid)[current_row][current_column] = DEPLETED;  // ...cell becomes DEPLETED in the next time step
+                break;
+        
+            // if current cell is DEPLETED...
+            case 9:
+                prob = next_draw(draws);  // get random draw
+                if (prob < rules->depleted_to_spore) {  // if the draw is below the probDepletedToSpore threshold...
+                    (*next_grid)[current_row][current_column] = SPORE;  // ...cell becomes SPORE in the next time step
+                } else if ((level == NULL) ? (prob < rules->depleted_to_empty) : (*level >= NUTRIENT_RECOVERED)) {  // if the draw is below the probDepletedToEmpty threshold (or the nutrients have recovered)...
+                    (*next_grid)[current_row][current_column] = EMPTY;  // ...cell becomes EMPTY in the next time step
+                    if (colonies != NULL) { colony_set(colonies, current_row, current_column, COLONY_NONE); }  // ...and leaves its colony
+                } else {  // otherwise...
+                    (*next_grid)[current_row][current_column] = DEPLETED;  // ...cell stays DEPLETED in the next time step
+                }
+                break;
+
+            // if current cell is INERT... (set from a terrain mask with -m)
+            case 10:
+                (*next_grid)[current_row][current_column] = INERT;  // ...cell stays INERT in the next time step
+                break;
+        }
+
+        // feed or recover the cell's nutrients
+        if (level != NULL) { nutrient_step(level, cell_value); }
+    }
+}
+
+/* ensemble() */
+/* runs REPLICAS independent simulations seeded SEED, SEED + 1, ... and reports their final states */
+void ensemble(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, int * REPLICAS, long * SEED, struct runtime_rules * rules, struct terrain * terrain, int * NUTRIENTS, struct soil * soil, int * STEADY) {
+    int groups, inner_threads;  // replicas running at once, and threads in each
+    struct replica_stats *stats = new struct replica_stats[*REPLICAS];
+    double start_time = omp_get_wtime();
+
+    // share the threads between replicas, and within them only if the grid is big enough
+    ensemble_split(ROWS, COLUMNS, THREADS, REPLICAS, &groups, &inner_threads);
+    omp_set_max_active_levels((inner_threads > 1) ? 2 : 1);
+
+    #pragma omp parallel num_threads(groups)
+    {
+        // each group allocates its grids once and reuses them for every replica it runs
+        int **current_grid;  // grid at current time step
+        int **next_grid;  // grid at next time step
+        int hashes = 0;  // replicas don't print hashes
+        struct nutrient_field *nutrients = NULL;  // nutrient levels (NULL if not modeled)
+        omp_set_num_threads(inner_threads);  // team size of the parallel regions inside this group's replicas
+        allocateGrid(&current_grid, ROWS, COLUMNS);
+        allocateGrid(&next_grid, ROWS, COLUMNS);
+        if (*NUTRIENTS) { nutrients = nutrients_create(ROWS, COLUMNS); }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int replica = 0; replica < (*REPLICAS); replica++) {  // for each replica...
+            double replica_start = omp_get_wtime();
+            trng::yarn2 yarn;
+            yarn.seed((long unsigned int)((*SEED) + replica));
+            initializeGrid(&current_grid, ROWS, COLUMNS, &yarn, rules);
+            if (terrain != NULL) { terrain_apply(terrain, &current_grid, ROWS, COLUMNS); }
+            if (nutrients != NULL) { nutrients_reset(nutrients, ROWS); }
+            stats[replica].steps = mushrooms(&current_grid, &next_grid, ROWS, COLUMNS, TIME_STEPS, &yarn, NULL, NULL, nutrients, soil, NULL, NULL, NULL, NULL, &hashes, STEADY, rules);
+            stats[replica].seed = (*SEED) + replica;
+            stats[replica].runtime = omp_get_wtime() - replica_start;
+            census(&current_grid, ROWS, COLUMNS, &stats[replica]);
+        }
+
+        deallocateGrid(&current_grid, ROWS);
+        deallocateGrid(&next_grid, ROWS);
+        nutrients_destroy(nutrients);
+    }
+
+    report_ensemble(stats, REPLICAS, ROWS, COLUMNS, TIME_STEPS, groups, inner_threads, omp_get_wtime() - start_time);
+    report_steady(stats, (*REPLICAS), TIME_STEPS, "replicas");
+    delete [] stats;
+}
+
+/* parameterSweep() */
+/* runs one simulation per point of the sweep, all from the same initial grid and seed, and reports their final states */
+void parameterSweep(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * THREADS, long * SEED, struct runtime_rules * rules, struct sweep * sweep, struct terrain * terrain, int * NUTRIENTS, int * STEADY) {
+    int groups, inner_threads;  // points running at once, and threads in each
+    int **initial_grid;  // shared by every point (read only once the points start)
+    struct replica_stats *stats = new struct replica_stats[sweep->points];
+    double start_time = omp_get_wtime();
+    trng::yarn2 yarn;
+    yarn.seed((long unsigned int)(*SEED));
+
+    // the one initial grid
+    allocateGrid(&initial_grid, ROWS, COLUMNS);
+    initializeGrid(&initial_grid, ROWS, COLUMNS, &yarn, rules);
+    if (terrain != NULL) { terrain_apply(terrain, &initial_grid, ROWS, COLUMNS); }
+
+    // share the threads between points, and within them only if the grid is big enough
+    ensemble_split(ROWS, COLUMNS, THREADS, &sweep->points, &groups, &inner_threads);
+    omp_set_max_active_levels((inner_threads > 1) ? 2 : 1);
+
+    #pragma omp parallel num_threads(groups)
+    {
+        // each group allocates its grids once and reuses them for every point it runs
+        int **current_grid;  // grid at current time step
+        int **next_grid;  // grid at next time step
+        int hashes = 0;  // points don't print hashes
+        struct nutrient_field *nutrients = NULL;  // nutrient levels (NULL if not modeled)
+        omp_set_num_threads(inner_threads);  // team size of the parallel regions inside this group's points
+        allocateGrid(&current_grid, ROWS, COLUMNS);
+        allocateGrid(&next_grid, ROWS, COLUMNS);
+        if (*NUTRIENTS) { nutrients = nutrients_create(ROWS, COLUMNS); }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int point = 0; point < sweep->points; point++) {  // for each point...
+            double point_start = omp_get_wtime();
+            trng::yarn2 point_yarn = yarn;  // same seed as the initial grid, so the time steps draw what a single run would
+            copyGrid(&current_grid, &initial_grid, ROWS, COLUMNS);
+            if (nutrients != NULL) { nutrients_reset(nutrients, ROWS); }
+            stats[point].steps = mushrooms(&current_grid, &next_grid, ROWS, COLUMNS, TIME_STEPS, &point_yarn, NULL, NULL, nutrients, NULL, NULL, NULL, NULL, NULL, &hashes, STEADY, &sweep->point_rules[point]);
+            stats[point].seed = *SEED;
+            stats[point].runtime = omp_get_wtime() - point_start;
+            census(&current_grid, ROWS, COLUMNS, &stats[point]);
+        }
+
+        deallocateGrid(&current_grid, ROWS);
+        deallocateGrid(&next_grid, ROWS);
+        nutrients_destroy(nutrients);
+    }
+
+    report_sweep(sweep, stats, ROWS, COLUMNS, TIME_STEPS, groups, inner_threads, omp_get_wtime() - start_time);
+    report_steady(stats, sweep->points, TIME_STEPS, "points");
+    deallocateGrid(&initial_grid, ROWS);
+    delete [] sweep->point_rules;
+    delete [] stats;
+}
+
+/* autoTune() */
+/* times the candidate thread counts, schedules, and layouts greedily on a scratch grid of the run's size and returns the fastest, with the number of candidates timed (see fungi_tune.h) */
+void autoTune(int * ROWS, int * COLUMNS, struct runtime_rules * rules, struct tune_config * best, int * trials) {
+    int **current_grid, **next_grid;  // scratch grids
+    int **next_rows = new int*[(*ROWS) + 2];  // next grid's row pointers when in place
+    trng::yarn2 yarn;  // scratch grid's engine
+    struct tune_config candidate;
+    int processors = omp_get_num_procs();
+    allocateGrid(&current_grid, ROWS, COLUMNS);
+    allocateGrid(&next_grid, ROWS, COLUMNS);
+    yarn.seed(TUNE_SEED);
+    *trials = 0;
+
+    // thread counts, until more threads stop paying off
+    best->seconds = -1.0;  // (nothing timed yet)
+    for (int threads = 1; threads <= processors; threads = (threads * 2 > processors && threads < processors) ? processors : threads * 2) {
+        candidate = { threads, omp_sched_static, 0, 0, 0.0 };
+        candidate.seconds = tuneTrial(&candidate, &current_grid, &next_grid, &next_rows, ROWS, COLUMNS, &yarn, rules);
+        (*trials)++;
+        if (best->seconds < 0.0 || candidate.seconds < best->seconds) {
+            *best = candidate;
+        } else if (candidate.seconds > TUNE_WORSE * best->seconds) {
+            break;
+        }
+    }
+
+    // schedules and the in-place layout at the fastest thread count
+    struct tune_config others[] = {
+        { best->threads, omp_sched_dynamic, 1, 0, 0.0 },
+        { best->threads, omp_sched_dynamic, 16, 0, 0.0 },
+        { best->threads, omp_sched_guided, 0, 0, 0.0 },
+        { best->threads, omp_sched_static, 0, 1, 0.0 },
+    };
+    for (struct tune_config & other : others) {
+        if (best->threads == 1 && other.in_place == 0) { continue; }  // (one thread has no schedule to pick)
+        other.seconds = tuneTrial(&other, &current_grid, &next_grid, &next_rows, ROWS, COLUMNS, &yarn, rules);
+        (*trials)++;
+        if (other.seconds < best->seconds) { *best = other; }
+    }
+
+    deallocateGrid(&current_grid, ROWS);
+    deallocateGrid(&next_grid, ROWS);
+    delete [] next_rows;
+}
+
+/* tuneTrial() */
+/* runs a few time steps of the scratch grid from its initial state with one configuration, TUNE_REPEATS times, and returns the fastest seconds per time step */
+double tuneTrial(struct tune_config * config, int ***current_grid, int ***next_grid, int ***next_rows, int * ROWS, int * COLUMNS, trng::yarn2 * yarn, struct runtime_rules * rules) {
+    int steps = TUNE_STEPS, hashes = 0, steady = 0;
+    double fastest = -1.0;
+    omp_set_num_threads(config->threads);
+    omp_set_schedule(config->schedule, config->chunk);
+    struct line_buffer *lines = config->in_place ? line_buffers_create(config->threads, COLUMNS) : NULL;
+    for (int repeat = 0; repeat < TUNE_REPEATS; repeat++) {
+        initializeGrid(current_grid, ROWS, COLUMNS, yarn, rules);  // the same start every time
+        double start = omp_get_wtime();
+        mushrooms(current_grid, config->in_place ? next_rows : next_grid, ROWS, COLUMNS, &steps, yarn, NULL, NULL, NULL, NULL, lines, NULL, NULL, NULL, &hashes, &steady, rules);
+        double seconds = (omp_get_wtime() - start) / (steps + 1);
+        if (fastest < 0.0 || seconds < fastest) { fastest = seconds; }
+    }
+    if (lines != NULL) { line_buffers_destroy(lines, config->threads); }
+    return fastest;
 }
 
 /* copyGrid() */
 /* copies the contents of one grid into another grid of the same size */
 void copyGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS) {
-    #pragma omp parallel for collapse(2)
-    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid (except the ghost rows)...
-        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
-            (*current_grid)[current_row][current_column] = (*next_grid)[current_row][current_column];  // ...store next_grid value in the same spot in current_grid
+    #pragma omp parallel
+    {
+        PROFILE_BEGIN(PHASE_COPY);
+        #pragma omp for collapse(2) nowait
+        for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid (except the ghost rows)...
+            for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
+                (*current_grid)[current_row][current_column] = (*next_grid)[current_row][current_column];  // ...store next_grid value in the same spot in current_grid
+            }
         }
+        PROFILE_WORK_DONE(PHASE_COPY);
+        #pragma omp barrier
+        PROFILE_END(PHASE_COPY);
     }
 }
 
 /* check_neighbors() */
 /* checks the neighbors of a cell in the grid; returns 1 if at least one neighbor is YOUNG, otherwise returns 0 */
 int check_neighbors(int ***current_grid, int current_row, int current_column) {
-    int young = 0;  // young counter
-    #pragma omp parallel for collapse(2) reduction(+:young)
+    // note: this runs once per EMPTY cell inside the parallel update loop, so it must not open a parallel region of its own
     for (int neighbor_row = current_row - 1; neighbor_row <= current_row + 1; neighbor_row++) {  // for each row in the 3x3 sub-grid...
         for (int neighbor_column = current_column - 1; neighbor_column <= current_column + 1; neighbor_column++) {  // for each cell in that row...
             if ( (neighbor_row != current_row) || (neighbor_column != current_column) ) {  // if that cell is a neighbor to the current cell...
                 if ((*current_grid)[neighbor_row][neighbor_column] == YOUNG) {  // ... and if that neighbor is YOUNG...
-                    young += 1;  // ... increase young counter by 1
+                    return 1;  // return 1
                 }
             }
         }
     }
-    if (young == 0) {  // if none of the neighbors are YOUNG...
-        return 0;  // ...return 0
-    } else {  // otherwise...
-        return 1;  // return 1
-    }
-    
+    return 0;  // if none of the neighbors are YOUNG, return 0
 }
 
 /* deallocateGrid() */
@@ -527,11 +1190,10 @@ void print_colorful_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_v
         black();
         printf("\t%lc\t", (wint_t)9608);
         reset_color();
-    // uncomment if using inert
-    // printf("|\n|\tINERT\t\t|");
-    //     black();
-    //     printf("\t%lc\t", (wint_t)9608);
-    //     reset_color();
+    printf("|\n|\tINERT\t\t|");
+        black();
+        printf("\t%lc\t", (wint_t)9619);
+        reset_color();
     printf("|\n-----------------------------------------\n\n");
 
     for (int current_row = 0; current_row <= (*ROWS) + 1; current_row++) {  // for each row in the grid...
@@ -626,10 +1288,10 @@ void print_colorful_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_v
                     reset_color();
                     break;
 
-                // INERT (not currently used)
+                // INERT
                 case 10:
                     black();
-                    printf("%lc", (wint_t)9608);
+                    printf("%lc", (wint_t)9619);
                     reset_color();
                     break;
             }
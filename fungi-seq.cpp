@@ -20,7 +20,6 @@
     #include <cstdlib>
     #include <iostream>
     #include <trng/yarn2.hpp>
-    #include <trng/uniform01_dist.hpp>
     #include <locale.h>
     #include <wchar.h>
     #include "seq_time.h"  // Libby's timing function that is similar to omp style
@@ -47,12 +46,41 @@
     #define DEPLETED 9   // area whose nutrients have previously been depleted by fungal growth
     #define INERT 10     // inert area where plants cannot grow
 
+/* PROJECT HEADERS */
+    #include "fungi_networks.h"  // labels connected mycelium networks (must follow the cell states)
+    #include "fungi_rings.h"  // tracks fairy ring radius and expansion (must follow the cell states and fungi_networks.h)
+    #include "fungi_profile.h"  // per-phase timing and hardware counters (enabled with -DPROFILE)
+    #include "fungi_streams.h"  // one block of random draws per row per time step
+    #include "fungi_hash.h"  // per-time-step grid hashes for comparing engines
+    #include "fungi_rules.h"  // runtime transition probabilities (must follow the probabilities)
+    #include "fungi_terrain.h"  // memory-mapped INERT masks and state rasters (must follow the cell states)
+    #include "fungi_nutrients.h"  // optional per-cell nutrient levels (must follow the cell states)
+    #include "fungi_soil.h"  // spatially varying soil quality (must follow fungi_rules.h and fungi_terrain.h)
+    #include "fungi_sparse.h"  // sparse tiled grids for mostly-EMPTY landscapes (must follow the cell states and fungi_hash.h)
+    #include "fungi_disk.h"  // out-of-core grids in a memory-mapped scratch file
+    #include "fungi_morton.h"  // blocked grids in Morton order (must follow the cell states and fungi_hash.h)
+    #include "fungi_dispersal.h"  // long-range spore dispersal by FFT convolution (must follow the cell states, fungi_streams.h, and fungi_rules.h)
+    #include "fungi_colonies.h"  // colony ids of competing colonies (must follow the cell states and fungi_networks.h)
+
 /* FUNCTION DECLARATIONS */
-void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS);
+void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int ** network_steps, int * RING_INTERVAL, long * SEED, int * HASHES, struct runtime_rules * rules, char ** TERRAIN, int * NUTRIENTS, char ** SOIL, int * SPARSE, char ** DISK, int * MORTON, char ** DISPERSAL, char ** COLONIES);
 void allocateGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row);
-void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform);
-void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform);
+void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules);
+void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, int * network_steps, struct ring_tracker * rings, struct nutrient_field * nutrients, struct soil * soil, struct dispersal * dispersal, struct colony_field * colonies, int * HASHES, struct runtime_rules * rules);
+void updateGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil);
+void updateRow(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil);
+void updateSpan(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int first_column, int last_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies);
+template <class RULES> void updateCells(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int first_column, int last_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies);
+template <class RULES> void updateCell(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies);
 void copyGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column);
+void diskMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, struct soil * soil, int * HASHES, struct runtime_rules * rules, const char * path, const char * program);
+void setGhostColumns(int * row, int * COLUMNS);
+void sparseMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, int * HASHES, struct runtime_rules * rules);
+void initializeSparse(struct sparse_grid * grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules, struct terrain * terrain);
+void updateSparse(struct sparse_grid * current, struct sparse_grid * next, int ***window, int ***result, struct row_draws * draws, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules);
+void mortonMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, int * HASHES, struct runtime_rules * rules);
+void initializeMorton(struct morton_grid * grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules, struct terrain * terrain);
+void updateMorton(struct morton_grid * current, struct morton_grid * next, struct row_draws * draws, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules);
 int check_neighbors(int ***current_grid, int * current_row, int * current_column, int * neighbor_row, int * neighbor_column);
 void deallocateGrid(int ***grid, int * ROWS, int * current_row);
 void print_number_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column);
@@ -66,6 +94,7 @@ void grey();
 void purple();
 
 /* main */
+#ifndef NO_MAIN  // fungi-micro.cpp includes this file for its kernels and brings its own main
 int main(int argc, char **argv){
 
     // declare variables
@@ -73,31 +102,95 @@ int main(int argc, char **argv){
     int ROWS, COLUMNS, TIME_STEPS;  // hold command line arguments
     int **current_grid;  // grid at current time step
     int **next_grid;  // grid at next time step
+    int *network_steps;  // time steps to report mycelium networks at (NULL if none)
+    int RING_INTERVAL;  // time steps between fairy ring reports (0 if none)
+    long SEED;  // RNG seed (-1 if not given)
+    int HASHES;  // print a hash of the grid at every time step (1) or not (0)
+    struct ring_tracker *rings = NULL;  // fairy ring geometry (NULL if not tracked)
     int current_row, current_column;  // grid cell counters
     int current_time_step;  // time step counter
     int neighbor_row, neighbor_column;  // check_neighbors() counters
     int current_value;  // hold grid print values
-    double prob;  // stores randomly generated probability values
+    unsigned long prob;  // stores random draws
+    struct runtime_rules rules;  // transition probabilities and their thresholds
+    char *TERRAIN;  // terrain mask or state raster file (NULL if none)
+    struct terrain *terrain = NULL;  // mapped terrain mask (NULL if none)
+    int NUTRIENTS;  // model nutrient levels (1) or not (0)
+    struct nutrient_field *nutrients = NULL;  // nutrient levels (NULL if not modeled)
+    char *SOIL;  // soil quality map file (NULL if none)
+    struct soil *soil = NULL;  // mapped soil quality (NULL if none)
+    int SPARSE;  // run on sparse tiled grids (1) or dense ones (0)
+    char *DISK;  // out-of-core scratch file (NULL to keep the grids in memory)
+    int MORTON;  // run on blocked grids in Morton order (1) or row-major ones (0)
+    char *DISPERSAL;  // dispersal kernel and rates (NULL if spores only spread locally)
+    struct dispersal *dispersal = NULL;  // long-range dispersal (NULL if none)
+    char *COLONIES;  // colony tie-breaking rule (NULL if colonies aren't told apart)
+    struct colony_field *colonies = NULL;  // colony ids (NULL if not tracked)
 
     // initialize random number engine
     trng::yarn2 yarn;  // create engine object
-    trng::uniform01_dist<> uniform;  // create distribution fxn
 
     // parse command line arguments
-    getArguments(argc, argv, &ROWS, &COLUMNS, &TIME_STEPS);
+    getArguments(argc, argv, &ROWS, &COLUMNS, &TIME_STEPS, &network_steps, &RING_INTERVAL, &SEED, &HASHES, &rules, &TERRAIN, &NUTRIENTS, &SOIL, &SPARSE, &DISK, &MORTON, &DISPERSAL, &COLONIES);
+    if (TERRAIN != NULL) { terrain = terrain_open_mask(TERRAIN, &ROWS, &COLUMNS, argv[0]); }
+    if (SOIL != NULL) { soil = soil_open(SOIL, &ROWS, &COLUMNS, &rules, argv[0]); }
+
+    // seed RNG if a seed was given (otherwise the engine's default seed is used)
+    if (SEED >= 0) { yarn.seed((long unsigned int)SEED); }
+
+    // set up per-phase profiling (does nothing unless built with PROFILE)
+    PROFILE_INIT();
 
     // start timing
     start_time = c_get_wtime();
 
+    // run out of core instead if asked to
+    if (DISK != NULL) {
+        diskMushrooms(&ROWS, &COLUMNS, &TIME_STEPS, &current_row, &current_column, &current_time_step, &neighbor_row, &neighbor_column, &current_value, &prob, &yarn, terrain, soil, &HASHES, &rules, DISK, argv[0]);
+        end_time = c_get_wtime();
+        printf("%f", end_time - start_time);
+        PROFILE_REPORT();
+        terrain_close(terrain);
+        soil_close(soil);
+        return 0;
+    }
+
+    // or on sparse tiled grids
+    if (SPARSE) {
+        sparseMushrooms(&ROWS, &COLUMNS, &TIME_STEPS, &current_row, &current_column, &current_time_step, &neighbor_row, &neighbor_column, &current_value, &prob, &yarn, terrain, &HASHES, &rules);
+        end_time = c_get_wtime();
+        printf("%f", end_time - start_time);
+        PROFILE_REPORT();
+        terrain_close(terrain);
+        return 0;
+    }
+
+    // or on blocked grids in Morton order
+    if (MORTON) {
+        mortonMushrooms(&ROWS, &COLUMNS, &TIME_STEPS, &current_row, &current_column, &current_time_step, &neighbor_row, &neighbor_column, &current_value, &prob, &yarn, terrain, &HASHES, &rules);
+        end_time = c_get_wtime();
+        printf("%f", end_time - start_time);
+        PROFILE_REPORT();
+        terrain_close(terrain);
+        return 0;
+    }
+
     // allocate grids
     allocateGrid(&current_grid, &ROWS, &COLUMNS, &current_row);
     allocateGrid(&next_grid, &ROWS, &COLUMNS, &current_row);
+    if (RING_INTERVAL > 0) { rings = rings_create(&ROWS, &COLUMNS, RING_INTERVAL); }
+    if (NUTRIENTS) { nutrients = nutrients_create(&ROWS, &COLUMNS); }
+    if (DISPERSAL != NULL) { dispersal = dispersal_create(DISPERSAL, &ROWS, &COLUMNS, argv[0]); }
+    if (COLONIES != NULL) { colonies = colonies_create(COLONIES, &ROWS, &COLUMNS, argv[0]); }
 
     // initialize current_grid
-    initializeGrid(&current_grid, &ROWS, &COLUMNS, &current_row, &current_column, &prob, &yarn, &uniform);
+    initializeGrid(&current_grid, &ROWS, &COLUMNS, &current_row, &yarn, &rules);
+    if (terrain != NULL) { terrain_apply(terrain, &current_grid, &ROWS, &COLUMNS); }
+    if (rings != NULL) { rings_found(rings, &current_grid); }  // (hyphae from a state raster)
+    if (colonies != NULL) { colonies_found(colonies, &current_grid, argv[0]); }
 
     // run the simulation
-    mushrooms(&current_grid, &next_grid, &ROWS, &COLUMNS, &TIME_STEPS, &current_row, &current_column, &current_time_step, &neighbor_row, &neighbor_column, &current_value, &prob, &yarn, &uniform);
+    mushrooms(&current_grid, &next_grid, &ROWS, &COLUMNS, &TIME_STEPS, &current_row, &current_column, &current_time_step, &neighbor_row, &neighbor_column, &current_value, &prob, &yarn, network_steps, rings, nutrients, soil, dispersal, colonies, &HASHES, &rules);
 
     // end timing and print result
     end_time = c_get_wtime();
@@ -107,28 +200,53 @@ int main(int argc, char **argv){
     #else
         printf("%f", total_time);
     #endif
+    PROFILE_REPORT();
+    if (dispersal != NULL) { report_dispersal(dispersal); }
+    if (colonies != NULL) { report_colonies(colonies, TIME_STEPS); }
 
     // deallocate grids
     deallocateGrid(&current_grid, &ROWS, &current_row);
     deallocateGrid(&next_grid, &ROWS, &current_row);
+    delete [] network_steps;
+    rings_destroy(rings);
+    terrain_close(terrain);
+    nutrients_destroy(nutrients);
+    soil_close(soil);
+    dispersal_destroy(dispersal);
+    colonies_destroy(colonies);
 
     // return statement
     return 0;
 
 }
+#endif
 
 /* getArguments() */
-/* fetches and stores command line arguments for # of rows, columns, and time steps */
-void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS) {
+/* fetches and stores command line arguments for # of rows, columns, time steps, network report steps, ring report interval, RNG seed, grid hashes, transition probabilities, terrain mask, nutrient model, soil quality map, sparse grids, out-of-core scratch file, Morton layout, spore dispersal, and colony tie-breaking */
+void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_STEPS, int ** network_steps, int * RING_INTERVAL, long * SEED, int * HASHES, struct runtime_rules * rules, char ** TERRAIN, int * NUTRIENTS, char ** SOIL, int * SPARSE, char ** DISK, int * MORTON, char ** DISPERSAL, char ** COLONIES) {
     
     // declare + initialize variables
     int c;
     int rflag = 0;
     int cflag = 0;
     int sflag = 0;
+    int nflag = 0;
+    char *network_list = NULL;  // comma-separated time steps to report networks at
+    int gflag = 0;
+    int xflag = 0;
+    *HASHES = 0;
+    *TERRAIN = NULL;  // no terrain mask unless -m gives one
+    *NUTRIENTS = 0;  // no nutrient model unless -u asks for one
+    *SOIL = NULL;  // uniform soil unless -q gives a map
+    *SPARSE = 0;  // dense grids unless -z asks for sparse ones
+    *DISK = NULL;  // grids in memory unless -o gives a scratch file
+    *MORTON = 0;  // row-major grids unless -b asks for blocked ones
+    *DISPERSAL = NULL;  // spores spread only to neighbors unless -l adds dispersal
+    *COLONIES = NULL;  // colonies aren't told apart unless -y asks to
+    rules_default(rules);  // built-in probabilities unless -f or -p change them
 
     // retrieve command line arguments
-    while ((c = getopt (argc, argv, "r:c:s:")) != -1) {
+    while ((c = getopt (argc, argv, "r:c:s:n:g:x:kp:f:m:uq:zo:bl:y:")) != -1) {
         switch (c) {
             case 'r':
                 rflag = 1;
@@ -145,6 +263,65 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
                 *TIME_STEPS = atoi(optarg);
                 break;
             
+            case 'n':
+                nflag = 1;
+                network_list = optarg;
+                break;
+            
+            case 'g':
+                gflag = 1;
+                *RING_INTERVAL = atoi(optarg);
+                break;
+            
+            case 'x':
+                xflag = 1;
+                *SEED = atol(optarg);
+                break;
+            
+            case 'k':
+                *HASHES = 1;
+                break;
+            
+            case 'p':
+                rules_parse(rules, optarg, argv[0]);
+                break;
+            
+            case 'f':
+                rules_load(rules, optarg, argv[0]);
+                break;
+            
+            case 'm':
+                *TERRAIN = optarg;
+                break;
+            
+            case 'u':
+                *NUTRIENTS = 1;
+                break;
+            
+            case 'q':
+                *SOIL = optarg;
+                break;
+            
+            case 'z':
+                *SPARSE = 1;
+                break;
+            
+            case 'o':
+                *DISK = optarg;
+                break;
+            
+            case 'b':
+                *MORTON = 1;
+                break;
+            
+            case 'l':
+                *DISPERSAL = optarg;
+                break;
+            
+            case 'y':
+                *COLONIES = optarg;
+                break;
+            
             case '?':
                 if (optopt == 'r') {
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
@@ -152,6 +329,26 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 } else if (optopt == 's') {
                     fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'n') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'g') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'x') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'p') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'f') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'm') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'q') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'o') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'l') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (optopt == 'y') {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
                 } else if (isprint (optopt)) {
                     fprintf (stderr, "Unknown option `-%c'.\n", optopt);
                 } else {
@@ -186,6 +383,68 @@ void getArguments(int argc, char *argv[], int * ROWS, int * COLUMNS, int * TIME_
         fprintf(stderr, "Usage: %s -s number of time steps must be a positive nonzero integer\n", argv[0]);
         exit(EXIT_FAILURE);
     }
+    if (gflag == 0) {
+        *RING_INTERVAL = 0;  // rings are only tracked when asked for
+    } else if (*RING_INTERVAL < 1) {
+        fprintf(stderr, "Usage: %s -g number of time steps between ring reports must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (xflag == 0) {
+        *SEED = -1;  // no seed given
+    } else if (*SEED < 0) {
+        fprintf(stderr, "Usage: %s -x RNG seed must be a nonnegative integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    rules_finish(rules, argv[0]);
+    if (*SPARSE == 1 && (nflag == 1 || gflag == 1 || *NUTRIENTS == 1 || *SOIL != NULL)) {
+        fprintf(stderr, "Usage: %s -z sparse grids cannot be combined with -n, -g, -u, or -q\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*DISK != NULL && (nflag == 1 || gflag == 1 || *NUTRIENTS == 1 || *SPARSE == 1)) {
+        fprintf(stderr, "Usage: %s -o out-of-core grids cannot be combined with -n, -g, -u, or -z\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*MORTON == 1 && (nflag == 1 || gflag == 1 || *NUTRIENTS == 1 || *SOIL != NULL || *SPARSE == 1 || *DISK != NULL)) {
+        fprintf(stderr, "Usage: %s -b blocked grids cannot be combined with -n, -g, -u, -q, -z, or -o\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*DISPERSAL != NULL && (*SPARSE == 1 || *DISK != NULL || *MORTON == 1)) {
+        fprintf(stderr, "Usage: %s -l dispersal cannot be combined with -z, -o, or -b\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*COLONIES != NULL && (*SPARSE == 1 || *DISK != NULL || *MORTON == 1 || *DISPERSAL != NULL)) {  // (spores carried in by the wind would belong to no colony)
+        fprintf(stderr, "Usage: %s -y colonies cannot be combined with -z, -o, -b, or -l\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    #ifdef DEBUG
+        if (*SPARSE == 1) {
+            fprintf(stderr, "Usage: %s -z sparse grids need a build without DEBUG\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (*DISK != NULL) {
+            fprintf(stderr, "Usage: %s -o out-of-core grids need a build without DEBUG\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        if (*MORTON == 1) {
+            fprintf(stderr, "Usage: %s -b blocked grids need a build without DEBUG\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    #endif
+
+    // mark the time steps that get a network report
+    *network_steps = NULL;
+    if (nflag == 1) {
+        *network_steps = new int[(*TIME_STEPS) + 1]();  // one flag per time step, all cleared
+        for (char *step = strtok(network_list, ","); step != NULL; step = strtok(NULL, ",")) {  // for each listed time step...
+            int network_step = atoi(step);
+            if (network_step < 0 || network_step > (*TIME_STEPS)) {
+                fprintf(stderr, "Usage: %s -n network report steps must be comma-separated integers between 0 and the number of time steps\n", argv[0]);
+                exit(EXIT_FAILURE);
+            }
+            (*network_steps)[network_step] = 1;  // ...flag it
+        }
+    }
 }
 
 /* allocateGrid() */
@@ -199,25 +458,20 @@ void allocateGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row) {
 
 /* initializeGrid() */
 /* initializes the grid with empty spaces and spore spaces to begin the simulation */
-void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform) {
+void initializeGrid(int ***grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules) {
     for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid...
-        for ((*current_column) = 1; (*current_column) <= (*COLUMNS); (*current_column)++) {  // for each cell in that row...
-            (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-            if ((*prob) <= probSpore) {  // if prob is less than or equal to probSpore...
-                (*grid)[*current_row][*current_column] = SPORE;  // ...then cell starts as SPORE
-            } else {  // otherwise...
-                (*grid)[*current_row][*current_column] = EMPTY;  // ...cell starts as EMPTY
-            }
-        }
+        trng::yarn2 row_yarn = row_stream(yarn, ROWS, COLUMNS, INITIAL_STEP, (*current_row));  // this row's block of draws
+        spore_row((*grid)[*current_row], COLUMNS, &row_yarn, rules);  // EMPTY with SPOREs at geometric gaps
     }
 }
 
 /* mushrooms() */
 /* simulates the growth of mushroom networks into fairy rings */
-void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, double * prob, trng::yarn2 * yarn, trng::uniform01_dist<> * uniform) {
+void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, int * network_steps, struct ring_tracker * rings, struct nutrient_field * nutrients, struct soil * soil, struct dispersal * dispersal, struct colony_field * colonies, int * HASHES, struct runtime_rules * rules) {
     for((*current_time_step) = 0; (*current_time_step) <= (*TIME_STEPS); (*current_time_step)++) {  // for each time step...
 
         // set up ghost rows
+        PROFILE_BEGIN(PHASE_GHOST_ROWS);
         for ((*current_column) = 0; (*current_column) <= (*COLUMNS) + 1; (*current_column)++) {
 
             // set first row of grid to be the ghost of the second-to-last row
@@ -226,8 +480,10 @@ void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS,
             // set last row of grid to be the ghost of the second row
             (*current_grid)[(*ROWS) + 1][*current_column] = (*current_grid)[1][*current_column];
         }
+        PROFILE_DONE(PHASE_GHOST_ROWS);
 
         // set up ghost columns
+        PROFILE_BEGIN(PHASE_GHOST_COLUMNS);
         for ((*current_row) = 0; (*current_row) <= (*ROWS) + 1; (*current_row)++) {
 
             // set left-most column to be the ghost of the second-farthest-right column
@@ -236,8 +492,10 @@ void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS,
             // set right-most column to be the ghost of the second-farthest-left column
             (*current_grid)[*current_row][(*COLUMNS) + 1] = (*current_grid)[*current_row][1];
         }
+        PROFILE_DONE(PHASE_GHOST_COLUMNS);
 
         // DEBUG: display current grid
+        PROFILE_BEGIN(PHASE_OUTPUT);
         #ifdef DEBUG
             #ifdef COLOR
                 setlocale(LC_ALL, "");
@@ -249,115 +507,431 @@ void mushrooms(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS,
             #endif
         #endif
 
-        // determine grid at next time step
-        for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid...
-            for ((*current_column) = 1; (*current_column) <= (*COLUMNS); (*current_column)++) {  // for each cell in that row...
-
-                (*current_value) = (*current_grid)[*current_row][*current_column];
+        // report mycelium networks if requested for this time step
+        if (network_steps != NULL && network_steps[(*current_time_step)]) {
+            report_networks(current_grid, ROWS, COLUMNS, (*current_time_step));
+        }
 
-                switch(*current_value) {
-                
-                    // if current cell is EMPTY...
-                    case 0:
-                        if (check_neighbors(current_grid, current_row, current_column, neighbor_row, neighbor_column) == 0) {  // if cell has no YOUNG neighbors...
-                            (*next_grid)[*current_row][*current_column] == EMPTY;  // ...cell stays EMPTY in the next time step
-                        } else {  // otherwise...
-                            (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                            if ((*prob) <= probSpread) {  // if prob is less than or equal to probSpread...
-                                (*next_grid)[*current_row][*current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
-                            } else {  // otherwise...
-                                (*next_grid)[*current_row][*current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
-                            }
-                        }
-                        break;
-                    
-                    // if current cell is SPORE...
-                    case 1:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probSporeToYoung) {  // if prob is less than or equal to probSporeToYoung...
-                            (*next_grid)[*current_row][*current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[*current_row][*current_column] = SPORE;  // ...cell stays SPORE in the next time step
-                        }
-                        break;
-                    
-                    // if current cell is YOUNG...
-                    case 2:
-                        (*next_grid)[*current_row][*current_column] = MATURING;  // ...cell becomes MATURING in the next time step
-                        break;
-                    
-                    // if current cell is MATURING...
-                    case 3:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probMaturingToMushrooms) {  // if prob is less than or equal to probMaturingToMushrooms...
-                            (*next_grid)[*current_row][*current_column] = MUSHROOMS;  // ...cell becomes MUSHROOMS in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[*current_row][*current_column] = OLDER;  // ...cell becomes OLDER in the next time step
-                        }
-                        break;
-                    
-                    // if current cell is MUSHROOMS...
-                    case 4:
-                        (*next_grid)[*current_row][*current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
-                        break;
-                    
-                    // if current cell is OLDER...
-                    case 5:
-                        (*next_grid)[*current_row][*current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
-                        break;
-                    
-                    // if current cell is DECAYING...
-                    case 6:
-                        (*next_grid)[*current_row][*current_column] = DEAD;  // ...cell becomes DEAD in the next time step
-                        break;
-                    
-                    // if current cell is DEAD...
-                    case 7:
-                        (*next_grid)[*current_row][*current_column] = DEADER;  // ...cell becomes DEADER in the next time step
-                        break;
-                    
-                    // if current cell is DEADER...
-                    case 8:
-                        (*next_grid)[*current_row][*current_column] = DEPLETED;  // ...cell becomes DEPLETED in the next time step
-                        break;
-                    
-                    // if current cell is DEPLETED...
-                    case 9:
-                        (*prob) = (*uniform)(*yarn);  // get random double between 0 and 1
-                        if ((*prob) <= probDepletedToSpore) {  // if prob is less than or equal to probDepletedToSpore...
-                            (*next_grid)[*current_row][*current_column] = SPORE;  // ...cell becomes SPORE in the next time step
-                        } else if ((*prob) <= probDepletedToEmpty) {  // if prob is less than or equal to probDepletedToEmpty...
-                            (*next_grid)[*current_row][*current_column] = EMPTY;  // ...cell becomes EMPTY in the next time step
-                        } else {  // otherwise...
-                            (*next_grid)[*current_row][*current_column] = DEPLETED;  // ...cell stays DEPLETED in the next time step
-                        }
-                        break;
-
-                    // if current cell is INERT... (not currently used)
-                    case 10:
-                            // note: there is the potential to initialize the grid with some cells starting out as inert
-                                // representing spots where fungi cannot grow (rocks etc.) but this has not been implemented
-                        (*next_grid)[*current_row][*current_column] = INERT;  // ...cell stays INERT in the next time step
-                        break;
-                }
-            }
+        // print the grid's hash if requested
+        if (*HASHES) {
+            report_hash(current_grid, ROWS, COLUMNS, (*current_time_step));
         }
+        PROFILE_DONE(PHASE_OUTPUT);
+
+        // determine grid at next time step (counting the colonies' cells as they are read at the last one)
+        PROFILE_BEGIN(PHASE_UPDATE);
+        if (colonies != NULL) { colonies->counting = ((*current_time_step) == (*TIME_STEPS)); }
+        updateGrid(current_grid, next_grid, ROWS, COLUMNS, current_row, current_column, current_time_step, neighbor_row, neighbor_column, current_value, prob, yarn, rules, rings, nutrients, colonies, soil);
+        PROFILE_DONE(PHASE_UPDATE);
         
+        // fit the fairy rings to this step's growth front
+        if (rings != NULL) {
+            PROFILE_BEGIN(PHASE_OUTPUT);
+            rings_end_step(rings, (*current_time_step), (*TIME_STEPS));
+            PROFILE_DONE(PHASE_OUTPUT);
+        }
+
         // copy next_grid onto current_grid
         copyGrid(current_grid, next_grid, ROWS, COLUMNS, current_row, current_column);
 
+        // land the spores carried off by the wind, if it is time to
+        if (dispersal != NULL) {
+            PROFILE_BEGIN(PHASE_UPDATE);
+            dispersal_step(dispersal, current_grid, ROWS, COLUMNS, (*current_time_step), yarn);
+            PROFILE_DONE(PHASE_UPDATE);
+        }
+
         // loop simulation for the next time step
     }
 }
 
+/* updateGrid() */
+/* determines the whole grid at the next time step */
+void updateGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil) {
+    for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid...
+        updateRow(current_grid, next_grid, ROWS, COLUMNS, current_row, current_column, current_time_step, neighbor_row, neighbor_column, current_value, prob, yarn, rules, rings, nutrients, colonies, soil);
+    }
+}
+
+/* updateRow() */
+/* determines one row of the grid at the next time step, with the run's rule set or, given a soil map, each tile's or cell's own */
+void updateRow(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies, struct soil * soil) {
+    struct row_draws draws;  // this row's block of draws
+    row_draws_start(&draws, yarn, ROWS, COLUMNS, (*current_time_step), (*current_row));
+    if (soil == NULL) {  // the same rule set everywhere
+        updateSpan(current_grid, next_grid, current_row, current_column, 1, (*COLUMNS), neighbor_row, neighbor_column, current_value, prob, &draws, rules, rings, nutrients, colonies);
+        return;
+    }
+    for (int tile = 0; tile < soil->tiles_per_row; tile++) {  // for each tile in the row...
+        int first_column = tile * SOIL_TILE + 1;
+        int last_column = (first_column + SOIL_TILE - 1 < (*COLUMNS)) ? first_column + SOIL_TILE - 1 : (*COLUMNS);
+        int value = soil_tile(soil, (*current_row), tile);
+        if (value != SOIL_VARIED) {  // ...one rule set for the whole tile
+            updateSpan(current_grid, next_grid, current_row, current_column, first_column, last_column, neighbor_row, neighbor_column, current_value, prob, &draws, &soil->levels[value], rings, nutrients, colonies);
+        } else {  // ...or one per cell
+            for (int column = first_column; column <= last_column; column++) {
+                updateSpan(current_grid, next_grid, current_row, current_column, column, column, neighbor_row, neighbor_column, current_value, prob, &draws, soil_cell(soil, (*current_row), column), rings, nutrients, colonies);
+            }
+        }
+    }
+}
+
+/* updateSpan() */
+/* determines a run of cells in one row at the next time step, using the kernel with the thresholds folded in when the rule set is the built-in one */
+void updateSpan(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int first_column, int last_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, struct runtime_rules * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies) {
+    if (rules->is_default) {  // built-in probabilities
+        updateCells(current_grid, next_grid, current_row, current_column, first_column, last_column, neighbor_row, neighbor_column, current_value, prob, draws, &built_in_rules, rings, nutrients, colonies);
+    } else {
+        updateCells(current_grid, next_grid, current_row, current_column, first_column, last_column, neighbor_row, neighbor_column, current_value, prob, draws, rules, rings, nutrients, colonies);
+    }
+}
+
+/* updateCells() */
+/* determines a run of cells in one row at the next time step, with the transition thresholds of one rule set */
+template <class RULES>
+void updateCells(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int first_column, int last_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies) {
+    for ((*current_column) = first_column; (*current_column) <= last_column; (*current_column)++) {  // for each cell in the run...
+        updateCell(current_grid, next_grid, current_row, current_column, neighbor_row, neighbor_column, current_value, prob, draws, rules, rings, nutrients, colonies);
+    }
+}
+
+/* updateCell() */
+/* determines the state of one cell at the next time step from its state (and its neighbors) at the current time step */
+template <class RULES>
+void updateCell(int ***current_grid, int ***next_grid, int * current_row, int * current_column, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, struct row_draws * draws, const RULES * rules, struct ring_tracker * rings, struct nutrient_field * nutrients, struct colony_field * colonies) {
+
+    (*current_value) = (*current_grid)[*current_row][*current_column];
+    unsigned char *level = (nutrients != NULL) ? nutrient_level(nutrients, *current_row, *current_column) : NULL;  // this cell's nutrients (NULL if not modeled)
+    if (colonies != NULL) { colony_count(colonies, *current_row, *current_column, (*current_value)); }
+
+    switch(*current_value) {
+    
+        // if current cell is EMPTY...
+        case 0:
+            if (check_neighbors(current_grid, current_row, current_column, neighbor_row, neighbor_column) == 0) {  // if cell has no YOUNG neighbors...
+                (*next_grid)[*current_row][*current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
+            } else {  // otherwise...
+                (*prob) = next_draw(draws);  // get random draw
+                if ((level == NULL) ? ((*prob) < rules->spread) : nutrient_spread((*prob), rules->spread, *level)) {  // if the draw is below the probSpread threshold (scaled by the cell's nutrients)...
+                    (*next_grid)[*current_row][*current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
+                    if (rings != NULL) { rings_spread(rings, current_grid, *current_row, *current_column); }  // ...and joins its neighbor's colony
+                    if (colonies != NULL) { colony_join(colonies, current_grid, *current_row, *current_column, (*prob)); }  // ...and takes its colony id
+                } else {  // otherwise...
+                    (*next_grid)[*current_row][*current_column] = EMPTY;  // ...cell stays EMPTY in the next time step
+                }
+            }
+            break;
+        
+        // if current cell is SPORE...
+        case 1:
+            (*prob) = next_draw(draws);  // get random draw
+            if ((*prob) < rules->spore_to_young) {  // if the draw is below the probSporeToYoung threshold...
+                (*next_grid)[*current_row][*current_column] = YOUNG;  // ...cell becomes YOUNG in the next time step
+                if (rings != NULL) { rings_birth(rings, *current_row, *current_column); }  // ...and starts a new colony
+            } else {  // otherwise...
+                (*next_grid)[*current_row][*current_column] = SPORE;  // ...cell stays SPORE in the next time step
+            }
+            break;
+        
+        // if current cell is YOUNG...
+        case 2:
+            (*next_grid)[*current_row][*current_column] = MATURING;  // ...cell becomes MATURING in the next time step
+            break;
+        
+        // if current cell is MATURING...
+        case 3:
+            (*prob) = next_draw(draws);  // get random draw
+            if ((*prob) < rules->maturing_to_mushrooms) {  // if the draw is below the probMaturingToMushrooms threshold...
+                (*next_grid)[*current_row][*current_column] = MUSHROOMS;  // ...cell becomes MUSHROOMS in the next time step
+            } else {  // otherwise...
+                (*next_grid)[*current_row][*current_column] = OLDER;  // ...cell becomes OLDER in the next time step
+            }
+            break;
+        
+        // if current cell is MUSHROOMS...
+        case 4:
+            (*next_grid)[*current_row][*current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
+            break;
+        
+        // if current cell is OLDER...
+        case 5:
+            (*next_grid)[*current_row][*current_column] = DECAYING;  // ...cell becomes DECAYING in the next time step
+            break;
+        
+        // if current cell is DECAYING...
+        case 6:
+            (*next_grid)[*current_row][*current_column] = DEAD;  // ...cell becomes DEAD in the next time step
+            break;
+        
+        // if current cell is DEAD...
+        case 7:
+            (*next_grid)[*current_row][*current_column] = DEADER;  // ...cell becomes DEADER in the next time step
+            break;
+        
+        // if current cell is DEADER...
+        case 8:
+            (*next_grid)[*current_row][*current_column] = DEPLETED;  // ...cell becomes DEPLETED in the next time step
+            break;
+        
+        // if current cell is DEPLETED...
+        case 9:
+            (*prob) = next_draw(draws);  // get random draw
+            if ((*prob) < rules->depleted_to_spore) {  // if the draw is below the probDepletedToSpore threshold...
+                (*next_grid)[*current_row][*current_column] = SPORE;  // ...cell becomes SPORE in the next time step
+            } else if ((level == NULL) ? ((*prob) < rules->depleted_to_empty) : (*level >= NUTRIENT_RECOVERED)) {  // if the draw is below the probDepletedToEmpty threshold (or the nutrients have recovered)...
+                (*next_grid)[*current_row][*current_column] = EMPTY;  // ...cell becomes EMPTY in the next time step
+                if (colonies != NULL) { colony_set(colonies, *current_row, *current_column, COLONY_NONE); }  // ...and leaves its colony
+            } else {  // otherwise...
+                (*next_grid)[*current_row][*current_column] = DEPLETED;  // ...cell stays DEPLETED in the next time step
+            }
+            break;
+
+        // if current cell is INERT... (set from a terrain mask with -m)
+        case 10:
+            (*next_grid)[*current_row][*current_column] = INERT;  // ...cell stays INERT in the next time step
+            break;
+    }
+
+    // feed or recover the cell's nutrients
+    if (level != NULL) { nutrient_step(level, (*current_value)); }
+}
+
 /* copyGrid() */
 /* copies the contents of one grid into another grid of the same size */
 void copyGrid(int ***current_grid, int ***next_grid, int * ROWS, int * COLUMNS, int * current_row, int * current_column) {
+    PROFILE_BEGIN(PHASE_COPY);
     for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid (except the ghost rows)...
         for ((*current_column) = 1; (*current_column) <= (*COLUMNS); (*current_column)++) {  // for each cell in that row...
             (*current_grid)[*current_row][*current_column] = (*next_grid)[*current_row][*current_column];  // ...store next_grid value in the same spot in current_grid
         }
     }
+    PROFILE_DONE(PHASE_COPY);
+}
+
+/* diskMushrooms() */
+/* runs the simulation on grids kept in a memory-mapped scratch file, a band of rows at a time, with the next band read ahead and each finished band written behind and dropped */
+void diskMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, struct soil * soil, int * HASHES, struct runtime_rules * rules, const char * path, const char * program) {
+    struct disk_grids *disk = disk_open(path, ROWS, COLUMNS, program);
+    int **current_grid = disk->grids[0];  // grid at current time step
+    int **next_grid = disk->grids[1];  // grid at next time step
+    int band = disk->band_rows;  // rows per band
+
+    // initialize current_grid a band at a time
+    for (int first_row = 1; first_row <= (*ROWS); first_row += band) {
+        int last_row = (first_row + band - 1 < (*ROWS)) ? first_row + band - 1 : (*ROWS);
+        for ((*current_row) = first_row; (*current_row) <= last_row; (*current_row)++) {
+            trng::yarn2 row_yarn = row_stream(yarn, ROWS, COLUMNS, INITIAL_STEP, (*current_row));  // this row's block of draws
+            spore_row(current_grid[*current_row], COLUMNS, &row_yarn, rules);  // EMPTY with SPOREs at geometric gaps
+            if (terrain != NULL) { terrain_apply_row(terrain, current_grid[*current_row], (*current_row), COLUMNS); }
+            setGhostColumns(current_grid[*current_row], COLUMNS);
+        }
+        disk_write_behind(disk, current_grid, first_row, last_row);
+        disk_release(disk, current_grid, first_row - band, first_row - 1);
+    }
+
+    for ((*current_time_step) = 0; (*current_time_step) <= (*TIME_STEPS); (*current_time_step)++) {  // for each time step...
+
+        // set up ghost rows (the ghost columns were set as each row was written)
+        PROFILE_BEGIN(PHASE_GHOST_ROWS);
+        memcpy(current_grid[0], current_grid[*ROWS], disk->row_bytes);
+        memcpy(current_grid[(*ROWS) + 1], current_grid[1], disk->row_bytes);
+        PROFILE_DONE(PHASE_GHOST_ROWS);
+
+        // print the grid's hash if requested
+        PROFILE_BEGIN(PHASE_OUTPUT);
+        if (*HASHES) {
+            report_hash(&current_grid, ROWS, COLUMNS, (*current_time_step));
+        }
+        PROFILE_DONE(PHASE_OUTPUT);
+
+        // determine grid at next time step a band at a time
+        PROFILE_BEGIN(PHASE_UPDATE);
+        disk_prefetch(disk, current_grid, 1, band);
+        for (int first_row = 1; first_row <= (*ROWS); first_row += band) {  // for each band...
+            int last_row = (first_row + band - 1 < (*ROWS)) ? first_row + band - 1 : (*ROWS);
+            disk_prefetch(disk, current_grid, last_row + 1, last_row + band);  // ...read the next one ahead
+            for ((*current_row) = first_row; (*current_row) <= last_row; (*current_row)++) {
+                updateRow(&current_grid, &next_grid, ROWS, COLUMNS, current_row, current_column, current_time_step, neighbor_row, neighbor_column, current_value, prob, yarn, rules, NULL, NULL, NULL, soil);
+                setGhostColumns(next_grid[*current_row], COLUMNS);
+            }
+            disk_write_behind(disk, next_grid, first_row, last_row);  // ...write it behind
+            disk_release(disk, current_grid, first_row - band, first_row - 1);  // ...and drop the band before, which no row left this time step reads
+            disk_release(disk, next_grid, first_row - band, first_row - 1);
+        }
+        PROFILE_DONE(PHASE_UPDATE);
+
+        // the next grid becomes the current one (no copy needed)
+        int **swap = current_grid;
+        current_grid = next_grid;
+        next_grid = swap;
+    }
+
+    disk_close(disk, ROWS);
+}
+
+/* setGhostColumns() */
+/* sets the ghost columns of one row to the cells at the other end of it */
+void setGhostColumns(int * row, int * COLUMNS) {
+    row[0] = row[*COLUMNS];
+    row[(*COLUMNS) + 1] = row[1];
+}
+
+/* sparseMushrooms() */
+/* runs the simulation on sparse tiled grids, which materialize only the tiles holding something other than EMPTY, and reports how many tiles were needed */
+void sparseMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, int * HASHES, struct runtime_rules * rules) {
+    struct tile_pool pool = { NULL, 0 };  // tiles shared by both grids
+    struct sparse_grid *current = sparse_create(ROWS, COLUMNS, &pool);  // grid at current time step
+    struct sparse_grid *next = sparse_create(ROWS, COLUMNS, &pool);  // grid at next time step
+    int tile_size = SPARSE_TILE;
+    int **window, **result;  // one tile and the ring around it, before and after a time step
+    struct row_draws *draws = new struct row_draws[SPARSE_TILE];  // the draws of one band of tile rows
+    long most_materialized = 0;  // most tiles one grid has held
+
+    allocateGrid(&window, &tile_size, &tile_size, current_row);
+    allocateGrid(&result, &tile_size, &tile_size, current_row);
+    initializeSparse(current, ROWS, COLUMNS, current_row, yarn, rules, terrain);
+
+    for ((*current_time_step) = 0; (*current_time_step) <= (*TIME_STEPS); (*current_time_step)++) {  // for each time step...
+
+        // print the grid's hash if requested
+        PROFILE_BEGIN(PHASE_OUTPUT);
+        if (*HASHES) {
+            report_sparse_hash(current, (*current_time_step));
+        }
+        long materialized = sparse_materialized(current);
+        if (materialized > most_materialized) { most_materialized = materialized; }
+        PROFILE_DONE(PHASE_OUTPUT);
+
+        // determine grid at next time step
+        PROFILE_BEGIN(PHASE_UPDATE);
+        updateSparse(current, next, &window, &result, draws, ROWS, COLUMNS, current_row, current_column, current_time_step, neighbor_row, neighbor_column, current_value, prob, yarn, rules);
+        PROFILE_DONE(PHASE_UPDATE);
+
+        // the next grid becomes the current one (no copy needed)
+        struct sparse_grid *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    fprintf(stderr, "sparse: at most %ld of %ld tiles of %dx%d materialized in one grid, %ld allocated for both (%.1f MB, dense grids %.1f MB)\n", most_materialized, (long)current->tile_rows * current->tile_columns, SPARSE_TILE, SPARSE_TILE, pool.allocated, pool.allocated * sizeof(int) * SPARSE_TILE * SPARSE_TILE / 1e6, 2.0 * ((*ROWS) + 2) * ((*COLUMNS) + 2) * sizeof(int) / 1e6);
+
+    deallocateGrid(&window, &tile_size, current_row);
+    deallocateGrid(&result, &tile_size, current_row);
+    delete [] draws;
+    sparse_destroy(current);
+    sparse_destroy(next);
+    pool_destroy(&pool);
+}
+
+/* initializeSparse() */
+/* initializes a sparse grid with the same cells initializeGrid() (and the terrain mask) would give a dense one, a row at a time */
+void initializeSparse(struct sparse_grid * grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules, struct terrain * terrain) {
+    int *row = new int[(*COLUMNS) + 2];  // one row, indexed like a row of the dense grid
+    for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid...
+        trng::yarn2 row_yarn = row_stream(yarn, ROWS, COLUMNS, INITIAL_STEP, (*current_row));  // this row's block of draws
+        spore_row(row, COLUMNS, &row_yarn, rules);  // EMPTY with SPOREs at geometric gaps
+        if (terrain != NULL) { terrain_apply_row(terrain, row, (*current_row), COLUMNS); }
+        sparse_set_row(grid, (*current_row), row);
+    }
+    delete [] row;
+}
+
+/* updateSparse() */
+/* determines the sparse grid at the next time step a tile at a time, skipping the tiles in which nothing can change; tiles are taken a band of rows at a time and left to right, so every row consumes its draws in the same order as in the dense grid */
+void updateSparse(struct sparse_grid * current, struct sparse_grid * next, int ***window, int ***result, struct row_draws * draws, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules) {
+    for (int tile_row = 0; tile_row < current->tile_rows; tile_row++) {  // for each band of tiles...
+        int first_row = tile_row * SPARSE_TILE + 1;
+        int height = (first_row + SPARSE_TILE - 1 <= (*ROWS)) ? SPARSE_TILE : (*ROWS) - first_row + 1;
+        int started = 0;  // whether the band's rows have their draws yet (an all-EMPTY band never needs them)
+        for (int tile_column = 0; tile_column < current->tile_columns; tile_column++) {  // for each tile in that band...
+            int first_column = tile_column * SPARSE_TILE + 1;
+            int width = (first_column + SPARSE_TILE - 1 <= (*COLUMNS)) ? SPARSE_TILE : (*COLUMNS) - first_column + 1;
+            if (sparse_window(current, tile_row, tile_column, window) == 0) {  // ...nothing in it can change
+                sparse_release(next, tile_row, tile_column);
+                continue;
+            }
+            if (started == 0) {
+                for (int row = 0; row < height; row++) { row_draws_start(&draws[row], yarn, ROWS, COLUMNS, (*current_time_step), first_row + row); }
+                started = 1;
+            }
+            for ((*current_row) = 1; (*current_row) <= height; (*current_row)++) {  // for each row of the tile...
+                updateSpan(window, result, current_row, current_column, 1, width, neighbor_row, neighbor_column, current_value, prob, &draws[(*current_row) - 1], rules, NULL, NULL, NULL);
+            }
+            sparse_store(next, tile_row, tile_column, result);
+        }
+    }
+}
+
+/* mortonMushrooms() */
+/* runs the simulation on blocked grids whose tiles are stored in Morton order, each tile with its own halo in place of ghost rows and columns */
+void mortonMushrooms(int * ROWS, int * COLUMNS, int * TIME_STEPS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct terrain * terrain, int * HASHES, struct runtime_rules * rules) {
+    struct morton_grid *current = morton_create(ROWS, COLUMNS);  // grid at current time step
+    struct morton_grid *next = morton_create(ROWS, COLUMNS);  // grid at next time step
+    struct row_draws *draws = new struct row_draws[*ROWS];  // the draws of every row (tiles visit the rows in turn)
+
+    initializeMorton(current, ROWS, COLUMNS, current_row, yarn, rules, terrain);
+
+    for ((*current_time_step) = 0; (*current_time_step) <= (*TIME_STEPS); (*current_time_step)++) {  // for each time step...
+
+        // set up the halos
+        PROFILE_BEGIN(PHASE_GHOST_ROWS);
+        morton_halo(current);
+        PROFILE_DONE(PHASE_GHOST_ROWS);
+
+        // print the grid's hash if requested
+        PROFILE_BEGIN(PHASE_OUTPUT);
+        if (*HASHES) {
+            report_morton_hash(current, (*current_time_step));
+        }
+        PROFILE_DONE(PHASE_OUTPUT);
+
+        // determine grid at next time step
+        PROFILE_BEGIN(PHASE_UPDATE);
+        updateMorton(current, next, draws, ROWS, COLUMNS, current_row, current_column, current_time_step, neighbor_row, neighbor_column, current_value, prob, yarn, rules);
+        PROFILE_DONE(PHASE_UPDATE);
+
+        // the next grid becomes the current one (no copy needed)
+        struct morton_grid *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    delete [] draws;
+    morton_destroy(current);
+    morton_destroy(next);
+}
+
+/* initializeMorton() */
+/* initializes a blocked grid with the same cells initializeGrid() (and the terrain mask) would give a dense one, a row at a time */
+void initializeMorton(struct morton_grid * grid, int * ROWS, int * COLUMNS, int * current_row, trng::yarn2 * yarn, struct runtime_rules * rules, struct terrain * terrain) {
+    int *row = new int[(*COLUMNS) + 2];  // one row, indexed like a row of the dense grid
+    for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // for each row in the grid...
+        trng::yarn2 row_yarn = row_stream(yarn, ROWS, COLUMNS, INITIAL_STEP, (*current_row));  // this row's block of draws
+        spore_row(row, COLUMNS, &row_yarn, rules);  // EMPTY with SPOREs at geometric gaps
+        if (terrain != NULL) { terrain_apply_row(terrain, row, (*current_row), COLUMNS); }
+        morton_set_row(grid, (*current_row), row);
+    }
+    delete [] row;
+}
+
+/* updateMorton() */
+/* determines the blocked grid at the next time step a tile at a time, in storage order; the Morton order takes the tiles of each tile row left to right, so every row consumes its draws in the same order as in the dense grid */
+void updateMorton(struct morton_grid * current, struct morton_grid * next, struct row_draws * draws, int * ROWS, int * COLUMNS, int * current_row, int * current_column, int * current_time_step, int * neighbor_row, int * neighbor_column, int * current_value, unsigned long * prob, trng::yarn2 * yarn, struct runtime_rules * rules) {
+    int *current_rows[MORTON_SPAN], *next_rows[MORTON_SPAN];  // one tile of each grid, as rows
+    int **current_tile = current_rows, **next_tile = next_rows;
+    for ((*current_row) = 1; (*current_row) <= (*ROWS); (*current_row)++) {  // every row starts its draws (none are made yet)
+        row_draws_start(&draws[(*current_row) - 1], yarn, ROWS, COLUMNS, (*current_time_step), (*current_row));
+    }
+    for (int position = 0; position < current->tile_rows * current->tile_columns; position++) {  // for each tile, in storage order...
+        int tile_row = current->order[position] / current->tile_columns, tile_column = current->order[position] % current->tile_columns;
+        int first_row = tile_row * MORTON_TILE + 1;
+        int height = morton_height(current, tile_row), width = morton_width(current, tile_column);
+        morton_rows(current->cells + (size_t)position * MORTON_SPAN * MORTON_SPAN, current_rows);  // (both grids share the same order)
+        morton_rows(next->cells + (size_t)position * MORTON_SPAN * MORTON_SPAN, next_rows);
+        for ((*current_row) = 1; (*current_row) <= height; (*current_row)++) {  // for each row of the tile...
+            updateSpan(&current_tile, &next_tile, current_row, current_column, 1, width, neighbor_row, neighbor_column, current_value, prob, &draws[first_row + (*current_row) - 2], rules, NULL, NULL, NULL);
+        }
+    }
 }
 
 /* check_neighbors() */
@@ -472,11 +1046,10 @@ void print_colorful_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_r
         black();
         printf("\t%lc\t", (wint_t)9608);
         reset_color();
-    // uncomment if using inert
-    // printf("|\n|\tINERT\t\t|");
-    //     black();
-    //     printf("\t%lc\t", (wint_t)9608);
-    //     reset_color();
+    printf("|\n|\tINERT\t\t|");
+        black();
+        printf("\t%lc\t", (wint_t)9619);
+        reset_color();
     printf("|\n-----------------------------------------\n\n");
 
 
@@ -572,10 +1145,10 @@ void print_colorful_grid(int ***grid, int * ROWS, int * COLUMNS, int * current_r
                     reset_color();
                     break;
 
-                // INERT (not currently used)
+                // INERT
                 case 10:
                     black();
-                    printf("%lc", (wint_t)9608);
+                    printf("%lc", (wint_t)9619);
                     reset_color();
                     break;
             }
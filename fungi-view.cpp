@@ -0,0 +1,183 @@
+/*******************************************************************************************
+ * fungi-view.cpp
+ *******************************************************************************************
+ *
+ * watches a running parallel simulation started with -v NAME: attaches read-only to its shared
+ * memory segment (see fungi_monitor.h) and redraws the published view and counters every
+ * interval, waiting for the run to start if it hasn't yet and stopping once it is over
+ *
+ * the viewer only ever reads the segment, and the run never waits for it, so it can be attached
+ * to (and detached from, with ctrl-C) a production job at any time without changing its timing
+ *
+ * each cell of the view is drawn as one character
+ *      EMPTY ' '  SPORE '.'  YOUNG 'y'  MATURING 'm'  MUSHROOMS 'M'  OLDER 'o'
+ *      DECAYING 'd'  DEAD 'x'  DEADER 'X'  DEPLETED '-'  INERT '#'
+ * followed by the fraction of the view in each state and a sparkline of the live hyphae (YOUNG
+ * to DEADER) over the recent time steps
+ *
+*/
+
+/* LIBRARIES */
+    #include <stdlib.h>
+    #include <stdio.h>
+    #include <string.h>
+    #include <unistd.h>
+    #include <ctype.h>
+
+/* PROJECT HEADERS */
+    #include "fungi_monitor.h"  // the shared memory segment and its seqlock
+
+/* UNIVERSAL CONSTANTS */
+    #define DEFAULT_INTERVAL 500  // milliseconds between redraws
+
+    // how each state is drawn, and its name (EMPTY to INERT)
+    const char state_symbols[MONITOR_STATES + 1] = " .ymModxX-#";
+    const char * state_names[MONITOR_STATES] = { "EMPTY", "SPORE", "YOUNG", "MATURING", "MUSHROOMS", "OLDER", "DECAYING", "DEAD", "DEADER", "DEPLETED", "INERT" };
+
+    // sparkline levels, lowest to highest
+    const char spark_levels[] = " .:-=+*#%@";
+
+/* FUNCTION DECLARATIONS */
+void getArguments(int argc, char *argv[], const char ** NAME, int * INTERVAL, int * ONCE);
+void draw(const char * name, struct monitor_header * header, struct monitor_sample * latest, struct monitor_sample * history, unsigned char * view, int clear);
+
+/* main */
+int main(int argc, char **argv){
+
+    // declare variables
+    const char *NAME;  // of the run's segment
+    int INTERVAL;  // milliseconds between redraws
+    int ONCE;  // draw one snapshot and exit (1) or keep watching (0)
+    struct monitor *monitor = NULL;  // the attached segment
+    struct monitor_sample latest;  // counters of the time step in the view
+    struct monitor_sample history[MONITOR_HISTORY];  // counters of recent time steps
+    unsigned char *view;  // copy of the view
+
+    // parse command line arguments
+    getArguments(argc, argv, &NAME, &INTERVAL, &ONCE);
+
+    // wait for the run to create its segment
+    while ((monitor = monitor_attach(NAME)) == NULL) {
+        if (ONCE) {
+            fprintf(stderr, "no run is publishing to %s\n", NAME);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stderr, "\rwaiting for a run publishing to %s...", NAME);
+        usleep(INTERVAL * 1000);
+    }
+    view = new unsigned char[(size_t)monitor->header->view_rows * monitor->header->view_columns];
+
+    // redraw until the run is over
+    while (1) {
+        int finished = __atomic_load_n(&monitor->header->finished, __ATOMIC_ACQUIRE);  // (read first, so the last time step is drawn after it)
+        if (monitor_read(monitor, &latest, history, view)) {
+            draw(NAME, monitor->header, &latest, history, view, !ONCE);
+        }
+        if (ONCE || finished) { break; }
+        usleep(INTERVAL * 1000);
+    }
+
+    delete [] view;
+    monitor_detach(monitor);
+    return 0;
+}
+
+/* getArguments() */
+/* fetches and stores command line arguments for the run's name, the redraw interval, and single snapshots */
+void getArguments(int argc, char *argv[], const char ** NAME, int * INTERVAL, int * ONCE) {
+
+    // initialize variables
+    int c;
+    *NAME = NULL;
+    *INTERVAL = DEFAULT_INTERVAL;
+    *ONCE = 0;
+
+    // retrieve command line arguments
+    while ((c = getopt (argc, argv, "v:i:o")) != -1) {
+        switch (c) {
+            case 'v':
+                *NAME = optarg;
+                break;
+
+            case 'i':
+                *INTERVAL = atoi(optarg);
+                break;
+
+            case 'o':
+                *ONCE = 1;
+                break;
+
+            case '?':
+                if (strchr("vi", optopt) != NULL) {
+                    fprintf (stderr, "Option -%c requires an argument.\n", optopt);
+                } else if (isprint (optopt)) {
+                    fprintf (stderr, "Unknown option `-%c'.\n", optopt);
+                } else {
+                    fprintf (stderr, "Unknown option character `\\x%x'.\n", optopt);
+                }
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    // check command line arguments
+    if (*NAME == NULL) {
+        fprintf(stderr, "Usage: %s -v name the run was started with\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (*INTERVAL < 1) {
+        fprintf(stderr, "Usage: %s -i milliseconds between redraws must be a positive nonzero integer\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* draw() */
+/* prints a snapshot of the view, the state fractions, and the recent live hyphae (clearing the terminal first if asked to) */
+void draw(const char * name, struct monitor_header * header, struct monitor_sample * latest, struct monitor_sample * history, unsigned char * view, int clear) {
+    double cells = (double)header->view_rows * header->view_columns;
+    if (clear) { printf("\033[H\033[2J"); }  // cursor home, clear screen
+
+    // which run, and how far along
+    const struct monitor_sample *oldest = latest;  // earliest time step still in the history
+    for (int slot = 0; slot < MONITOR_HISTORY; slot++) {
+        if (history[slot].time_step >= 0 && history[slot].time_step < oldest->time_step) { oldest = &history[slot]; }
+    }
+    double rate = (latest->elapsed > oldest->elapsed) ? (latest->time_step - oldest->time_step) / (latest->elapsed - oldest->elapsed) : 0.0;
+    printf("%s: time step %d of %d, %d x %d grid (sampled every %d cells), %.1f s, %.1f time steps per second\n", name, latest->time_step, header->time_steps, header->rows, header->columns, header->factor, latest->elapsed, rate);
+
+    // the view, framed
+    printf("+");
+    for (int view_column = 0; view_column < header->view_columns; view_column++) { printf("-"); }
+    printf("+\n");
+    for (int view_row = 0; view_row < header->view_rows; view_row++) {
+        printf("|");
+        for (int view_column = 0; view_column < header->view_columns; view_column++) {
+            unsigned char state = view[(size_t)view_row * header->view_columns + view_column];
+            putchar((state < MONITOR_STATES) ? state_symbols[state] : '?');
+        }
+        printf("|\n");
+    }
+    printf("+");
+    for (int view_column = 0; view_column < header->view_columns; view_column++) { printf("-"); }
+    printf("+\n");
+
+    // state fractions
+    for (int state = 0; state < MONITOR_STATES; state++) {
+        printf("%s%c %s %.3f", (state == 0) ? "" : "  ", state_symbols[state], state_names[state], latest->counts[state] / cells);
+    }
+    printf("\n");
+
+    // live hyphae over the recent time steps, oldest first
+    printf("live hyphae: ");
+    for (int time_step = latest->time_step - MONITOR_HISTORY + 1; time_step <= latest->time_step; time_step++) {
+        if (time_step < 0) { continue; }
+        const struct monitor_sample *sample = &history[time_step % MONITOR_HISTORY];
+        if (sample->time_step != time_step) { putchar(' '); continue; }  // not published (or already overwritten)
+        long live = 0;
+        for (int state = 2; state <= 8; state++) { live += sample->counts[state]; }  // YOUNG to DEADER
+        putchar(spark_levels[(int)(live / cells * (sizeof(spark_levels) - 2) + 0.5)]);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// end of file
@@ -0,0 +1,115 @@
+/*******************************************************************************************
+ * fungi.h
+ *******************************************************************************************
+ *
+ * the C API of libfungi (fungi-lib.cpp), for driving the model from other programs without running
+ * an engine as a separate process and parsing its output
+ *
+ * a simulation is created at a grid size, given its probabilities, initialized from a seed, and
+ * then advanced any number of time steps at a time; its time step counts the updates done so far,
+ * so the grid at time step t is the one the engines print (with -k) as "hash t" for the same seed
+ * and probabilities, however the steps were split between calls
+ *
+ * the current grid can be read in place: fungi_get_view() returns a pointer to its first interior
+ * cell and the row stride, with no copy; the view stays valid until the next call that changes the
+ * grid (fungi_step(), fungi_init(), fungi_restore(), or fungi_destroy()), since the grids swap at
+ * every time step; fungi_snapshot() copies the cells out instead, and fungi_restore() puts them
+ * back, into the same simulation or another one of the same size, seed, and probabilities, which
+ * then goes on exactly as the original would have
+ *
+ * a callback set with fungi_on_step() is called with the view after every time step fungi_step()
+ * takes; if it returns nonzero, fungi_step() stops there
+ *
+ * cell states are the engines' (FUNGI_EMPTY to FUNGI_INERT); grids passed to fungi_restore() may
+ * hold INERT cells anywhere, which is how a terrain is given; functions that can fail return -1 (or
+ * NULL) and leave a message for fungi_error() rather than exiting
+ *
+ * a simulation runs on the calling thread, and separate simulations can run on separate threads
+ *
+*/
+
+#ifndef FUNGI_H
+#define FUNGI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FUNGI_API __attribute__((visibility("default")))  // exported from libfungi.so (everything else is hidden)
+
+// cell states
+#define FUNGI_EMPTY 0
+#define FUNGI_SPORE 1
+#define FUNGI_YOUNG 2
+#define FUNGI_MATURING 3
+#define FUNGI_MUSHROOMS 4
+#define FUNGI_OLDER 5
+#define FUNGI_DECAYING 6
+#define FUNGI_DEAD 7
+#define FUNGI_DEADER 8
+#define FUNGI_DEPLETED 9
+#define FUNGI_INERT 10
+
+// a simulation (opaque)
+struct fungi_sim;
+
+// the current grid, read in place
+struct fungi_view {
+    const int *cells;  // cell (row, column) is cells[row * stride + column], both from 0
+    int rows, columns;
+    int stride;  // ints from one row to the next
+    int time_step;  // updates done so far
+};
+
+// called after every time step; returning nonzero stops fungi_step()
+typedef int (*fungi_callback)(const struct fungi_view * view, void * user);
+
+/* fungi_create() */
+/* creates a simulation of a rows x columns grid with the built-in probabilities; returns NULL if the size is invalid or memory runs out */
+FUNGI_API struct fungi_sim * fungi_create(int rows, int columns);
+
+/* fungi_set_probability() */
+/* sets one probability by name (probSpore, probSporeToYoung, probSpread, probMaturingToMushrooms, probDepletedToSpore, probDepletedToEmpty), taking effect at the next fungi_init(); returns 0, or -1 if the name or value is invalid */
+FUNGI_API int fungi_set_probability(struct fungi_sim * sim, const char * name, double value);
+
+/* fungi_init() */
+/* seeds the simulation (with the engines' default seed if seed is negative) and scatters the initial SPOREs, at time step 0; returns 0, or -1 if the probabilities don't fit together */
+FUNGI_API int fungi_init(struct fungi_sim * sim, long seed);
+
+/* fungi_step() */
+/* advances the simulation by up to steps time steps; returns the number taken (fewer if the callback stopped it), or -1 if it was never initialized */
+FUNGI_API int fungi_step(struct fungi_sim * sim, int steps);
+
+/* fungi_get_view() */
+/* describes the current grid without copying it; returns 0, or -1 if it was never initialized */
+FUNGI_API int fungi_get_view(const struct fungi_sim * sim, struct fungi_view * view);
+
+/* fungi_snapshot() */
+/* copies the current grid into cells (rows * columns ints, row by row); returns its time step, or -1 if it was never initialized */
+FUNGI_API int fungi_snapshot(const struct fungi_sim * sim, int * cells);
+
+/* fungi_restore() */
+/* replaces the grid with cells (rows * columns ints, row by row, as fungi_snapshot() writes them) at a time step; returns 0, or -1 if it was never initialized or a cell or the time step is invalid */
+FUNGI_API int fungi_restore(struct fungi_sim * sim, const int * cells, int time_step);
+
+/* fungi_hash() */
+/* returns the hash of the current grid, the one the engines print with -k */
+FUNGI_API unsigned long long fungi_hash(const struct fungi_sim * sim);
+
+/* fungi_on_step() */
+/* sets the callback called after every time step (NULL for none) and the pointer passed to it */
+FUNGI_API void fungi_on_step(struct fungi_sim * sim, fungi_callback callback, void * user);
+
+/* fungi_error() */
+/* returns the message of the last call that failed ("" if none has) */
+FUNGI_API const char * fungi_error(const struct fungi_sim * sim);
+
+/* fungi_destroy() */
+/* frees a simulation (does nothing if there is none) */
+FUNGI_API void fungi_destroy(struct fungi_sim * sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
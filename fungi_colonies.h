@@ -0,0 +1,253 @@
+/*******************************************************************************************
+ * fungi_colonies.h
+ *******************************************************************************************
+ *
+ * competing colonies for the engines (-y TIE): every cell carries the id of the colony it belongs
+ * to, so colonies that meet stay distinguishable
+ *      every SPORE of the initial grid founds a colony, numbered from 1 in row-major order
+ *      every network of live hyphae on the initial grid (from a state raster, -m states:) founds one
+ *          more, numbered after the SPOREs' in the row-major order of the networks' first cells
+ *      an EMPTY cell that becomes YOUNG joins the colony of one of its YOUNG neighbors, picked by TIE
+ *          first    - the first YOUNG neighbor, row by row from the top left
+ *          majority - the colony most of its YOUNG neighbors belong to (the first of those tied)
+ *          random   - a YOUNG neighbor at random, picked by the same draw that let the cell grow
+ *              (below the spread threshold, so it adds no draws and changes no other cell)
+ *      a cell keeps its colony through every later state, including the SPORE a DEPLETED cell
+ *          may become, and loses it (COLONY_NONE) when it becomes EMPTY again
+ *
+ * the ids are 16 bits each, or 32 bits each on grids whose initial SPOREs and networks found more colonies than
+ * 16 bits can tell apart, in one contiguous array of their own next to the grid, as the nutrient
+ * levels are (fungi_nutrients.h): a run without -y passes NULL, so the state-only kernel moves
+ * exactly the bytes it did before and every grid hash is the same with or without -y; only the ids
+ * of cells that are not YOUNG ever change during a time step, and joining only reads the ids of
+ * YOUNG cells, so the ids are updated in place, by any number of threads, in the same pass as the
+ * states, and a run gives the same colonies at any thread count and in either layout
+ *
+ * the update of the last time step counts, as it reads each cell, the cells (neither EMPTY nor
+ * INERT) every colony holds on the final grid, into per-thread tallies, so the report needs no
+ * pass of its own over the grid
+ *
+ * these ids are kept apart from the ring tracker's (fungi_rings.h, -g) on purpose: a ring colony is
+ * born every time a SPORE becomes YOUNG, even a SPORE that grew out of a colony, and a growing cell
+ * joins its first YOUNG neighbor's ring, while a colony here is founded once, on the initial grid,
+ * keeps its SPOREs, and is joined by TIE; sharing one array would change the rings -g reports, or
+ * make every -g run pay for the wider ids the rings need
+ *
+ * must be included after the cell states are defined and after fungi_networks.h
+ *
+*/
+
+#ifndef FUNGI_COLONIES_H
+#define FUNGI_COLONIES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#define COLONY_NONE 0             // id of a cell that belongs to no colony
+#define COLONY_MAX USHRT_MAX      // most colonies the 16-bit ids can tell apart (more switch to 32-bit ids)
+#define COLONY_REPORT_LIMIT 10    // colonies listed individually in the report (most cells first)
+
+// ways of picking a colony when an EMPTY cell has YOUNG neighbors of more than one
+#define COLONY_FIRST 0
+#define COLONY_MAJORITY 1
+#define COLONY_RANDOM 2
+
+// a colony id, whichever width the field stores it in
+typedef unsigned int colony_id_t;
+
+// colony ids of the interior cells, row by row
+struct colony_field {
+    unsigned short *ids;  // ROWS * COLUMNS 16-bit ids (NULL if the wide ids are used)
+    colony_id_t *wide_ids;  // ROWS * COLUMNS 32-bit ids, if more than COLONY_MAX colonies were founded (NULL otherwise)
+    int rows, columns;  // cells (not counting ghosts)
+    int tie;  // COLONY_*
+    long count;  // colonies founded (ids 1 to count)
+    long *origins;  // (row - 1) * columns + (column - 1) of every colony's founding SPORE (or first network cell), by id
+    int threads;  // tallies kept
+    long *tallies;  // cells each colony holds, (count + 1) per thread
+    int counting;  // 1 while the update of the last time step counts the cells
+};
+
+/* colonies_create() */
+/* parses the tie-breaking rule; the ids are allocated once colonies_found() knows how wide they must be; exits with a usage message if the rule is unknown */
+struct colony_field * colonies_create(const char * tie, int * ROWS, int * COLUMNS, const char * program) {
+    struct colony_field *colonies = new struct colony_field;
+    if (strcmp(tie, "first") == 0) {
+        colonies->tie = COLONY_FIRST;
+    } else if (strcmp(tie, "majority") == 0) {
+        colonies->tie = COLONY_MAJORITY;
+    } else if (strcmp(tie, "random") == 0) {
+        colonies->tie = COLONY_RANDOM;
+    } else {
+        fprintf(stderr, "Usage: %s -y unknown colony tie-breaking rule %s (known: first, majority, random)\n", program, tie);
+        exit(EXIT_FAILURE);
+    }
+    colonies->rows = *ROWS;
+    colonies->columns = *COLUMNS;
+    colonies->ids = NULL;
+    colonies->wide_ids = NULL;
+    colonies->count = 0;
+    colonies->origins = NULL;
+    colonies->threads = 1;
+    #ifdef _OPENMP
+        colonies->threads = omp_get_max_threads();
+    #endif
+    colonies->tallies = NULL;
+    colonies->counting = 0;
+    return colonies;
+}
+
+/* colony_store() */
+/* stores the colony id of the cell at index (row - 1) * columns + (column - 1) */
+static inline void colony_store(struct colony_field * colonies, size_t cell, colony_id_t id) {
+    if (colonies->wide_ids != NULL) {
+        colonies->wide_ids[cell] = id;
+    } else {
+        colonies->ids[cell] = (unsigned short)id;
+    }
+}
+
+/* colonies_found() */
+/* gives every SPORE of the initial grid a colony of its own, in row-major order, then every network of live hyphae on it, with 32-bit ids if there are more than COLONY_MAX; exits with a usage message if there are more than even those can tell apart */
+void colonies_found(struct colony_field * colonies, int ***grid, const char * program) {
+    std::vector<long> origins(1, -1);  // (id 0 is COLONY_NONE)
+    int live = 0;  // 1 if the grid holds any live hyphae
+    for (int current_row = 1; current_row <= colonies->rows; current_row++) {  // for each row in the grid...
+        for (int current_column = 1; current_column <= colonies->columns; current_column++) {
+            int state = (*grid)[current_row][current_column];
+            if (state == SPORE) { origins.push_back((long)(current_row - 1) * colonies->columns + (current_column - 1)); }
+            live |= IS_LIVE(state);
+        }
+    }
+    long spores = (long)origins.size() - 1;  // colonies founded by SPOREs
+    struct network_labels * labels = live ? network_labels_create(grid, &colonies->rows, &colonies->columns) : NULL;
+    colonies->count = spores + ((labels != NULL) ? labels->count : 0);
+    if (colonies->count > (long)UINT_MAX - 1) {
+        fprintf(stderr, "Usage: %s -y at most %u colonies can be told apart, so the initial grid must hold fewer SPOREs and networks of hyphae\n", program, UINT_MAX - 1);
+        exit(EXIT_FAILURE);
+    }
+    size_t cells = (size_t)colonies->rows * colonies->columns;
+    if (colonies->count > COLONY_MAX) {
+        colonies->wide_ids = new colony_id_t[cells]();  // (all COLONY_NONE)
+    } else {
+        colonies->ids = new unsigned short[cells]();
+    }
+    for (long id = 1; id <= spores; id++) { colony_store(colonies, (size_t)origins[id], (colony_id_t)id); }
+    if (labels != NULL) {  // network ids run in the order of the networks' roots, their first cells
+        origins.resize(colonies->count + 1, -1);
+        for (int current_row = 1; current_row <= colonies->rows; current_row++) {  // for each row in the grid...
+            for (int current_column = 1; current_column <= colonies->columns; current_column++) {
+                long network = network_label(labels, current_row, current_column);
+                if (network == NOT_LIVE) { continue; }
+                long id = spores + 1 + network;
+                size_t cell = (size_t)(current_row - 1) * colonies->columns + (current_column - 1);
+                if (origins[id] < 0) { origins[id] = (long)cell; }
+                colony_store(colonies, cell, (colony_id_t)id);
+            }
+        }
+        network_labels_destroy(labels);
+    }
+    colonies->origins = new long[origins.size()];
+    std::copy(origins.begin(), origins.end(), colonies->origins);
+    colonies->tallies = new long[(size_t)colonies->threads * (colonies->count + 1)]();
+}
+
+/* colony_get() */
+/* returns the colony id of one interior cell */
+static inline colony_id_t colony_get(struct colony_field * colonies, int current_row, int current_column) {
+    size_t cell = (size_t)(current_row - 1) * colonies->columns + (current_column - 1);
+    return (colonies->wide_ids != NULL) ? colonies->wide_ids[cell] : colonies->ids[cell];
+}
+
+/* colony_set() */
+/* sets the colony id of one interior cell */
+static inline void colony_set(struct colony_field * colonies, int current_row, int current_column, colony_id_t id) {
+    colony_store(colonies, (size_t)(current_row - 1) * colonies->columns + (current_column - 1), id);
+}
+
+/* colony_neighbor() */
+/* returns the colony id of a neighbor of an interior cell, wrapping ghost cells back into the grid */
+static inline colony_id_t colony_neighbor(struct colony_field * colonies, int neighbor_row, int neighbor_column) {
+    int wrapped_row = (neighbor_row == 0) ? colonies->rows : (neighbor_row == colonies->rows + 1) ? 1 : neighbor_row;
+    int wrapped_column = (neighbor_column == 0) ? colonies->columns : (neighbor_column == colonies->columns + 1) ? 1 : neighbor_column;
+    return colony_get(colonies, wrapped_row, wrapped_column);
+}
+
+/* colony_join() */
+/* called when the EMPTY cell at (row, column) becomes YOUNG after drawing prob; the cell joins the colony of a YOUNG neighbor, picked by the run's tie-breaking rule */
+static inline void colony_join(struct colony_field * colonies, int ***current_grid, int current_row, int current_column, unsigned long prob) {
+    colony_id_t neighbors[8];  // colonies of the YOUNG neighbors, row by row from the top left
+    int young = 0;
+    for (int neighbor_row = current_row - 1; neighbor_row <= current_row + 1; neighbor_row++) {  // for each row in the 3x3 sub-grid...
+        for (int neighbor_column = current_column - 1; neighbor_column <= current_column + 1; neighbor_column++) {  // for each cell in that row...
+            if ((neighbor_row != current_row || neighbor_column != current_column) && (*current_grid)[neighbor_row][neighbor_column] == YOUNG) {
+                neighbors[young++] = colony_neighbor(colonies, neighbor_row, neighbor_column);
+            }
+        }
+    }
+    colony_id_t id = neighbors[0];  // (first)
+    if (colonies->tie == COLONY_RANDOM) {
+        id = neighbors[prob % young];
+    } else if (colonies->tie == COLONY_MAJORITY) {
+        int most = 0;
+        for (int first = 0; first < young; first++) {  // for each neighbor, in order...
+            int votes = 0;
+            for (int other = first; other < young; other++) { votes += (neighbors[other] == neighbors[first]); }
+            if (votes > most) {  // (strictly more, so the first of those tied wins)
+                most = votes;
+                id = neighbors[first];
+            }
+        }
+    }
+    colony_set(colonies, current_row, current_column, id);
+}
+
+/* colony_count() */
+/* called with every cell's state as the update reads it; tallies the cell for its colony if this is the update that counts and the cell is neither EMPTY nor INERT */
+static inline void colony_count(struct colony_field * colonies, int current_row, int current_column, int state) {
+    if (!colonies->counting || state == EMPTY || state == INERT) { return; }
+    int thread = 0;
+    #ifdef _OPENMP
+        thread = omp_get_thread_num();
+    #endif
+    colonies->tallies[(size_t)thread * (colonies->count + 1) + colony_get(colonies, current_row, current_column)]++;
+}
+
+/* report_colonies() */
+/* prints to stderr how many colonies were founded and still hold cells at a time step, and the ones holding the most */
+void report_colonies(struct colony_field * colonies, int time_step) {
+    std::vector<long> cells(colonies->count + 1, 0);
+    for (int thread = 0; thread < colonies->threads; thread++) {
+        for (long id = 0; id <= colonies->count; id++) { cells[id] += colonies->tallies[(size_t)thread * (colonies->count + 1) + id]; }
+    }
+    std::vector<long> holding;  // colonies that still hold cells
+    for (long id = 1; id <= colonies->count; id++) {
+        if (cells[id] > 0) { holding.push_back(id); }
+    }
+    std::stable_sort(holding.begin(), holding.end(), [&cells](long a, long b) { return cells[a] > cells[b]; });
+    fprintf(stderr, "colonies: %ld founded, %zu hold cells at time step %d\n", colonies->count, holding.size(), time_step);
+    for (size_t rank = 0; rank < holding.size() && rank < COLONY_REPORT_LIMIT; rank++) {
+        long id = holding[rank];
+        fprintf(stderr, "colony %ld (from row %ld, column %ld): %ld cells\n", id, colonies->origins[id] / colonies->columns + 1, colonies->origins[id] % colonies->columns + 1, cells[id]);
+    }
+}
+
+/* colonies_destroy() */
+/* frees a colony field (does nothing if there is none) */
+void colonies_destroy(struct colony_field * colonies) {
+    if (colonies == NULL) { return; }
+    delete [] colonies->ids;
+    delete [] colonies->wide_ids;
+    delete [] colonies->origins;
+    delete [] colonies->tallies;
+    delete colonies;
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*******************************************************************************************
+ * fungi_disk.h
+ *******************************************************************************************
+ *
+ * out-of-core grids for the sequential engine (-o FILE), for grids larger than memory: both grids
+ * live in one memory-mapped scratch file on local disk (removed again at exit), row by row with
+ * their ghost columns, and the engine reaches them through ordinary row pointers, so the kernels
+ * run on them unchanged; only the two ghost rows of each grid are kept in memory
+ *
+ * a time step walks the grid in bands of about DISK_BAND_BYTES; around the band being updated
+ *      disk_prefetch() asks for the next band of the current grid ahead of time (readahead)
+ *      disk_write_behind() starts writing the band just updated back to disk without waiting
+ *      disk_release() drops the band before the last one from the process and, once written,
+ *          from the page cache, since nothing reads it again this time step
+ * so only a few bands plus their halo rows are resident at any time, whatever the grid size; the
+ * grids swap roles between time steps, so no copy is ever made
+ *
+*/
+
+#ifndef FUNGI_DISK_H
+#define FUNGI_DISK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define DISK_BAND_BYTES (8 << 20)  // bytes of one grid per band
+
+// both grids of a simulation in a mapped scratch file
+struct disk_grids {
+    char *path;  // the scratch file
+    int file;  // its descriptor (kept open for the write-behind and cache hints)
+    char *map;  // the whole mapped file
+    size_t length;  // bytes mapped
+    size_t row_bytes;  // bytes per row, ghost columns included
+    int rows;  // rows per grid
+    int band_rows;  // rows per band
+    int **grids[2];  // row pointers of each grid (rows 0 and ROWS + 1 in memory, the others in the file)
+};
+
+/* disk_open() */
+/* creates and maps the scratch file for two grids; exits with a usage message if it can't */
+struct disk_grids * disk_open(const char * path, int * ROWS, int * COLUMNS, const char * program) {
+    struct disk_grids *disk = new struct disk_grids;
+    disk->path = strdup(path);
+    disk->row_bytes = sizeof(int) * ((*COLUMNS) + 2);
+    disk->rows = *ROWS;
+    disk->length = 2 * (size_t)(*ROWS) * disk->row_bytes;
+    disk->band_rows = (disk->row_bytes >= DISK_BAND_BYTES) ? 1 : (int)(DISK_BAND_BYTES / disk->row_bytes);
+    disk->file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (disk->file < 0 || ftruncate(disk->file, (off_t)disk->length) != 0) {
+        fprintf(stderr, "Usage: %s -o could not create scratch file %s\n", program, path);
+        exit(EXIT_FAILURE);
+    }
+    disk->map = (char *)mmap(NULL, disk->length, PROT_READ | PROT_WRITE, MAP_SHARED, disk->file, 0);
+    if (disk->map == MAP_FAILED) {
+        fprintf(stderr, "Usage: %s -o could not map scratch file %s\n", program, path);
+        exit(EXIT_FAILURE);
+    }
+    for (int grid = 0; grid < 2; grid++) {
+        disk->grids[grid] = new int*[(*ROWS) + 2];
+        disk->grids[grid][0] = new int[(*COLUMNS) + 2];  // ghost rows stay in memory
+        disk->grids[grid][(*ROWS) + 1] = new int[(*COLUMNS) + 2];
+        for (int current_row = 1; current_row <= (*ROWS); current_row++) {
+            disk->grids[grid][current_row] = (int *)(disk->map + ((size_t)grid * (*ROWS) + (current_row - 1)) * disk->row_bytes);
+        }
+    }
+    return disk;
+}
+
+/* disk_range() */
+/* finds the page-aligned part of the mapping holding rows first_row to last_row of a grid (cut down to the rows in the file); returns 0 if there are none */
+static int disk_range(struct disk_grids * disk, int ** grid, int first_row, int last_row, char ** start, size_t * length) {
+    static size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (first_row < 1) { first_row = 1; }
+    if (last_row > disk->rows) { last_row = disk->rows; }
+    if (first_row > last_row) { return 0; }
+    char *begin = (char *)grid[first_row];
+    char *end = (char *)grid[last_row] + disk->row_bytes;
+    *start = disk->map + (size_t)(begin - disk->map) / page * page;  // round down to a page
+    *length = (size_t)(end - *start);
+    return 1;
+}
+
+/* disk_prefetch() */
+/* asks for rows first_row to last_row of a grid to be read in ahead of use */
+void disk_prefetch(struct disk_grids * disk, int ** grid, int first_row, int last_row) {
+    char *start;
+    size_t length;
+    if (disk_range(disk, grid, first_row, last_row, &start, &length)) {
+        madvise(start, length, MADV_WILLNEED);
+    }
+}
+
+/* disk_write_behind() */
+/* starts writing rows first_row to last_row of a grid back to disk without waiting for it */
+void disk_write_behind(struct disk_grids * disk, int ** grid, int first_row, int last_row) {
+    char *start;
+    size_t length;
+    if (disk_range(disk, grid, first_row, last_row, &start, &length)) {
+        sync_file_range(disk->file, (off_t)(start - disk->map), (off_t)length, SYNC_FILE_RANGE_WRITE);
+    }
+}
+
+/* disk_release() */
+/* drops rows first_row to last_row of a grid from memory (they stay in the file, and dirty pages are written first) */
+void disk_release(struct disk_grids * disk, int ** grid, int first_row, int last_row) {
+    char *start;
+    size_t length;
+    if (disk_range(disk, grid, first_row, last_row, &start, &length)) {
+        madvise(start, length, MADV_DONTNEED);  // unmap from the process
+        posix_fadvise(disk->file, (off_t)(start - disk->map), (off_t)length, POSIX_FADV_DONTNEED);  // and evict whatever is already written
+    }
+}
+
+/* disk_close() */
+/* unmaps and removes the scratch file (does nothing if there is none) */
+void disk_close(struct disk_grids * disk, int * ROWS) {
+    if (disk == NULL) { return; }
+    for (int grid = 0; grid < 2; grid++) {
+        delete [] disk->grids[grid][0];
+        delete [] disk->grids[grid][(*ROWS) + 1];
+        delete [] disk->grids[grid];
+    }
+    munmap(disk->map, disk->length);
+    close(disk->file);
+    unlink(disk->path);
+    free(disk->path);
+    delete disk;
+}
+
+#endif
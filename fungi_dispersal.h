@@ -0,0 +1,300 @@
+/*******************************************************************************************
+ * fungi_dispersal.h
+ *******************************************************************************************
+ *
+ * long-range spore dispersal (-l KERNEL:SCALE:YIELD:EVERY): every EVERY time steps, the spores
+ * released by the MUSHROOMS cells are carried by the wind and land on the grid; each MUSHROOMS cell
+ * sends YIELD spores on average, spread over the torus by a dispersal kernel of the given SCALE (in
+ * cells), and an EMPTY cell where lambda spores are expected becomes a SPORE with probability
+ * 1 - exp(-lambda), the chance that at least one lands
+ *      gauss - k(d) ~ exp(-d^2 / (2 SCALE^2)), mostly short-range
+ *      exp   - k(d) ~ exp(-d / SCALE), with a longer tail
+ * where d is the distance across the torus (the grid wraps around as its ghost rows and columns
+ * do); the kernel is normalized to sum to 1 over the whole grid, so it has no cutoff radius
+ *
+ * the expected spores are the convolution of the MUSHROOMS cells with the kernel, which a direct
+ * sum would make O(N^2) in the number of cells N; instead it is computed with FFTs in O(N log N): the
+ * kernel's transform is computed once, and each dispersal transforms the MUSHROOMS cells, multiplies
+ * the two, and transforms back (the inverse as the conjugate of a forward transform, of which only
+ * the real part is kept); the FFT is self-contained, an iterative radix-2 transform for sides that
+ * are powers of 2 and Bluestein's algorithm (a chirp convolution done with the radix-2 transform of
+ * the next power of 2 at least twice as long) for the others, and a 2D transform is a 1D transform of
+ * every row and then of every column, rows and columns split between threads; each 1D transform is
+ * done start to finish by one thread, so the result does not depend on the number of threads and
+ * both engines compute the same probabilities to the bit
+ *
+ * dispersal happens after the update of a time step t with (t + 1) % EVERY == 0, on the new grid,
+ * and draws from blocks of its own, far past those of the update in the seeded sequence (row r of
+ * time step t starts at DISPERSAL_OFFSET + (t * ROWS + r - 1) * COLUMNS), one draw per cell, so the
+ * update's draws are the same with or without it
+ *
+ * must be included after the cell states are defined and after fungi_streams.h and fungi_rules.h
+ *
+*/
+
+#ifndef FUNGI_DISPERSAL_H
+#define FUNGI_DISPERSAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex>
+
+#define DISPERSAL_OFFSET (1ULL << 61)  // first draw of the dispersal blocks in the sequence
+#define DISPERSAL_GAUSS 0
+#define DISPERSAL_EXP 1
+
+typedef std::complex<double> fft_complex;
+
+// a 1D transform of one length
+struct fft_plan {
+    int length;  // points transformed
+    int padded;  // radix-2 length (length itself if it is a power of 2)
+    fft_complex *twiddles;  // exp(-2 pi i j / padded), j < padded / 2
+    fft_complex *chirp;  // exp(-pi i n^2 / length), n < length (NULL for powers of 2)
+    fft_complex *chirp_transform;  // transform of the conjugate chirp, wrapped around padded (NULL for powers of 2)
+};
+
+// the dispersal of a run
+struct dispersal {
+    int kernel;  // DISPERSAL_*
+    double scale;  // of the kernel, in cells
+    double yield;  // spores sent per MUSHROOMS cell
+    int every;  // time steps between dispersals
+    int rows, columns;
+    struct fft_plan row_plan;  // transforms along a row (columns points)
+    struct fft_plan column_plan;  // transforms along a column (rows points)
+    fft_complex *kernel_transform;  // rows x columns, row by row
+    fft_complex *field;  // rows x columns scratch, row by row
+    long events;  // dispersals done
+    long arrivals;  // SPOREs they placed
+};
+
+/* fft_multiply() */
+/* multiplies two complex numbers (without the checks for infinities std::complex makes, which none of these values need) */
+static inline fft_complex fft_multiply(fft_complex a, fft_complex b) {
+    return fft_complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+/* fft_radix2() */
+/* transforms data (a power-of-2 length with twiddles for at least that length) in place, forward */
+static void fft_radix2(fft_complex * data, int length, const fft_complex * twiddles, int twiddle_stride) {
+    for (int index = 1, reversed = 0; index < length; index++) {  // bit-reversal permutation
+        int bit = length >> 1;
+        for (; reversed & bit; bit >>= 1) { reversed ^= bit; }
+        reversed ^= bit;
+        if (index < reversed) { std::swap(data[index], data[reversed]); }
+    }
+    for (int span = 2; span <= length; span <<= 1) {  // butterflies of each size
+        int step = (length / span) * twiddle_stride;
+        for (int start = 0; start < length; start += span) {
+            for (int offset = 0; offset < span / 2; offset++) {
+                fft_complex odd = fft_multiply(data[start + offset + span / 2], twiddles[offset * step]);
+                data[start + offset + span / 2] = data[start + offset] - odd;
+                data[start + offset] += odd;
+            }
+        }
+    }
+}
+
+/* fft_plan_create() */
+/* sets up the transforms of one length */
+void fft_plan_create(struct fft_plan * plan, int length) {
+    plan->length = length;
+    plan->padded = 1;
+    while (plan->padded < length) { plan->padded <<= 1; }
+    if (plan->padded != length) {  // Bluestein: the chirp convolution must not wrap onto itself
+        plan->padded = 1;
+        while (plan->padded < 2 * length - 1) { plan->padded <<= 1; }
+    }
+    plan->twiddles = new fft_complex[plan->padded / 2 + 1];
+    for (int j = 0; j < plan->padded / 2 + 1; j++) { plan->twiddles[j] = std::polar(1.0, -2.0 * M_PI * j / plan->padded); }
+    plan->chirp = NULL;
+    plan->chirp_transform = NULL;
+    if (plan->padded == length) { return; }
+    plan->chirp = new fft_complex[length];
+    plan->chirp_transform = new fft_complex[plan->padded]();
+    for (int n = 0; n < length; n++) {
+        long long square = ((long long)n * n) % (2LL * length);  // (reduced, so large n keeps its precision)
+        plan->chirp[n] = std::polar(1.0, -M_PI * square / length);
+    }
+    plan->chirp_transform[0] = std::conj(plan->chirp[0]);
+    for (int n = 1; n < length; n++) {
+        plan->chirp_transform[n] = std::conj(plan->chirp[n]);
+        plan->chirp_transform[plan->padded - n] = std::conj(plan->chirp[n]);
+    }
+    fft_radix2(plan->chirp_transform, plan->padded, plan->twiddles, 1);
+}
+
+/* fft_transform() */
+/* transforms data (plan->length points) in place, forward; scratch holds plan->padded points */
+static void fft_transform(struct fft_plan * plan, fft_complex * data, fft_complex * scratch) {
+    if (plan->chirp == NULL) {  // a power of 2
+        fft_radix2(data, plan->length, plan->twiddles, 1);
+        return;
+    }
+    for (int n = 0; n < plan->padded; n++) {  // chirped and zero-padded
+        scratch[n] = (n < plan->length) ? fft_multiply(data[n], plan->chirp[n]) : fft_complex(0.0, 0.0);
+    }
+    fft_radix2(scratch, plan->padded, plan->twiddles, 1);
+    for (int n = 0; n < plan->padded; n++) {  // convolved with the conjugate chirp, conjugated for the inverse
+        scratch[n] = std::conj(fft_multiply(scratch[n], plan->chirp_transform[n]));
+    }
+    fft_radix2(scratch, plan->padded, plan->twiddles, 1);
+    for (int k = 0; k < plan->length; k++) {
+        data[k] = fft_multiply(std::conj(scratch[k]), plan->chirp[k]) / (double)plan->padded;
+    }
+}
+
+/* fft_plan_destroy() */
+/* frees the tables of a plan */
+void fft_plan_destroy(struct fft_plan * plan) {
+    delete [] plan->twiddles;
+    delete [] plan->chirp;
+    delete [] plan->chirp_transform;
+}
+
+/* fft_2d() */
+/* transforms a rows x columns field (row by row) in place, forward: every row, then every column */
+void fft_2d(struct dispersal * dispersal, fft_complex * field) {
+    int rows = dispersal->rows, columns = dispersal->columns;
+    #pragma omp parallel
+    {
+        fft_complex *scratch = new fft_complex[(dispersal->row_plan.padded > dispersal->column_plan.padded) ? dispersal->row_plan.padded : dispersal->column_plan.padded];
+        fft_complex *column = new fft_complex[rows];
+        #pragma omp for
+        for (int row = 0; row < rows; row++) {
+            fft_transform(&dispersal->row_plan, &field[(size_t)row * columns], scratch);
+        }
+        #pragma omp for
+        for (int current_column = 0; current_column < columns; current_column++) {  // (gathered, so the transform reads contiguous points)
+            for (int row = 0; row < rows; row++) { column[row] = field[(size_t)row * columns + current_column]; }
+            fft_transform(&dispersal->column_plan, column, scratch);
+            for (int row = 0; row < rows; row++) { field[(size_t)row * columns + current_column] = column[row]; }
+        }
+        delete [] scratch;
+        delete [] column;
+    }
+}
+
+/* dispersal_create() */
+/* parses KERNEL:SCALE:YIELD:EVERY and transforms the kernel for a grid; exits with a usage message if the list is invalid */
+struct dispersal * dispersal_create(const char * list, int * ROWS, int * COLUMNS, const char * program) {
+    char kernel[16];
+    struct dispersal *dispersal = new struct dispersal;
+    if (sscanf(list, "%15[^:]:%lf:%lf:%d", kernel, &dispersal->scale, &dispersal->yield, &dispersal->every) != 4) {
+        fprintf(stderr, "Usage: %s -l dispersal must be KERNEL:SCALE:YIELD:EVERY (e.g. gauss:10:0.5:1)\n", program);
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(kernel, "gauss") == 0) {
+        dispersal->kernel = DISPERSAL_GAUSS;
+    } else if (strcmp(kernel, "exp") == 0) {
+        dispersal->kernel = DISPERSAL_EXP;
+    } else {
+        fprintf(stderr, "Usage: %s -l unknown dispersal kernel %s (known: gauss, exp)\n", program, kernel);
+        exit(EXIT_FAILURE);
+    }
+    if (!(dispersal->scale > 0.0) || !(dispersal->yield >= 0.0) || dispersal->every < 1) {
+        fprintf(stderr, "Usage: %s -l dispersal scale must be positive, yield nonnegative, and the time steps between dispersals a positive nonzero integer\n", program);
+        exit(EXIT_FAILURE);
+    }
+    dispersal->rows = *ROWS;
+    dispersal->columns = *COLUMNS;
+    dispersal->events = 0;
+    dispersal->arrivals = 0;
+    fft_plan_create(&dispersal->row_plan, *COLUMNS);
+    fft_plan_create(&dispersal->column_plan, *ROWS);
+    dispersal->field = new fft_complex[(size_t)(*ROWS) * (*COLUMNS)];
+    dispersal->kernel_transform = new fft_complex[(size_t)(*ROWS) * (*COLUMNS)];
+
+    // the kernel at every offset across the torus, normalized
+    double total = 0.0;
+    for (int row = 0; row < (*ROWS); row++) {
+        int dy = (row <= (*ROWS) - row) ? row : (*ROWS) - row;
+        for (int column = 0; column < (*COLUMNS); column++) {
+            int dx = (column <= (*COLUMNS) - column) ? column : (*COLUMNS) - column;
+            double distance = sqrt((double)dx * dx + (double)dy * dy);
+            double weight = (dispersal->kernel == DISPERSAL_GAUSS) ? exp(-distance * distance / (2.0 * dispersal->scale * dispersal->scale)) : exp(-distance / dispersal->scale);
+            dispersal->kernel_transform[(size_t)row * (*COLUMNS) + column] = weight;
+            total += weight;
+        }
+    }
+    for (size_t cell = 0; cell < (size_t)(*ROWS) * (*COLUMNS); cell++) { dispersal->kernel_transform[cell] /= total; }
+    fft_2d(dispersal, dispersal->kernel_transform);
+    return dispersal;
+}
+
+/* dispersal_density() */
+/* leaves the expected spores landing on every interior cell in the real parts of dispersal->field, row by row; returns the number of MUSHROOMS cells sending them */
+long dispersal_density(struct dispersal * dispersal, int ***grid) {
+    int rows = dispersal->rows, columns = dispersal->columns;
+    fft_complex *field = dispersal->field;
+    long sources = 0;
+    #pragma omp parallel for reduction(+:sources)
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            int mushrooms = ((*grid)[row + 1][column + 1] == MUSHROOMS);
+            field[(size_t)row * columns + column] = (double)mushrooms;
+            sources += mushrooms;
+        }
+    }
+    if (sources == 0) { return 0; }
+    fft_2d(dispersal, field);
+    #pragma omp parallel for
+    for (size_t cell = 0; cell < (size_t)rows * columns; cell++) {  // convolve, and conjugate so the next forward transform inverts
+        field[cell] = std::conj(fft_multiply(field[cell], dispersal->kernel_transform[cell])) * dispersal->yield;
+    }
+    fft_2d(dispersal, field);
+    double cells = (double)rows * columns;
+    #pragma omp parallel for
+    for (size_t cell = 0; cell < (size_t)rows * columns; cell++) {  // (the real part of the conjugate is the real part)
+        double expected = field[cell].real() / cells;
+        field[cell] = (expected > 0.0) ? expected : 0.0;  // (rounding can leave tiny negatives far from any source)
+    }
+    return sources;
+}
+
+/* dispersal_step() */
+/* lands the spores released by the MUSHROOMS cells of the new grid after the update of a time step, if dispersal is due then */
+void dispersal_step(struct dispersal * dispersal, int ***grid, int * ROWS, int * COLUMNS, int current_time_step, trng::yarn2 * yarn) {
+    if ((current_time_step + 1) % dispersal->every != 0) { return; }
+    dispersal->events++;
+    if (dispersal_density(dispersal, grid) == 0) { return; }  // no MUSHROOMS, so no spores (the draws are never needed)
+    long arrivals = 0;
+    #pragma omp parallel for reduction(+:arrivals)
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
+        struct row_draws draws;  // this row's block of dispersal draws, one per cell
+        trng::yarn2 offset = *yarn;
+        offset.jump(DISPERSAL_OFFSET);
+        row_draws_start(&draws, &offset, ROWS, COLUMNS, current_time_step - 1, current_row);  // (row_draws_start() counts from time step -1)
+        const fft_complex *expected = &dispersal->field[(size_t)(current_row - 1) * (*COLUMNS)];
+        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {
+            unsigned long prob = next_draw(&draws);
+            if ((*grid)[current_row][current_column] == EMPTY && prob < RULE_THRESHOLD(-expm1(-expected[current_column - 1].real()))) {
+                (*grid)[current_row][current_column] = SPORE;
+                arrivals++;
+            }
+        }
+    }
+    dispersal->arrivals += arrivals;
+}
+
+/* report_dispersal() */
+/* prints how many dispersals there were and how many spores they landed to stderr */
+void report_dispersal(struct dispersal * dispersal) {
+    fprintf(stderr, "dispersal: %ld dispersals landed %ld spores\n", dispersal->events, dispersal->arrivals);
+}
+
+/* dispersal_destroy() */
+/* frees a run's dispersal (does nothing if there is none) */
+void dispersal_destroy(struct dispersal * dispersal) {
+    if (dispersal == NULL) { return; }
+    fft_plan_destroy(&dispersal->row_plan);
+    fft_plan_destroy(&dispersal->column_plan);
+    delete [] dispersal->field;
+    delete [] dispersal->kernel_transform;
+    delete dispersal;
+}
+
+#endif
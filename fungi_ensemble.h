@@ -0,0 +1,116 @@
+/*******************************************************************************************
+ * fungi_ensemble.h
+ *******************************************************************************************
+ *
+ * statistics for ensemble runs of the parallel engine (-e N), which simulate N independent
+ * replicas of the same grid seeded SEED, SEED + 1, ..., SEED + N - 1 in one process
+ *
+ * replica k is the same simulation a single run with -x SEED+k would produce; when it finishes,
+ * its final grid is counted state by state, and once every replica is done the counts are
+ * reported to stderr as fractions of the grid, replica by replica and then as the mean, standard
+ * deviation, minimum, and maximum over the ensemble, followed by the throughput in replicas per hour
+ *
+ * the engine decides how to share the threads (ensemble_split()): small grids scale poorly inside
+ * one replica, so each thread runs whole replicas on its own; grids with more than
+ * ENSEMBLE_CELLS_PER_THREAD cells per thread are also split between a team of threads inside each
+ * replica (nested parallelism)
+ *
+ * must be included after the cell states are defined
+ *
+*/
+
+#ifndef FUNGI_ENSEMBLE_H
+#define FUNGI_ENSEMBLE_H
+
+#include <stdio.h>
+#include <math.h>
+
+// a replica gets another thread of its own for every this many cells
+#define ENSEMBLE_CELLS_PER_THREAD 250000
+
+// number of cell states counted per replica
+#define CENSUS_STATES (INERT + 1)
+
+const char * census_names[] = { "EMPTY", "SPORE", "YOUNG", "MATURING", "MUSHROOMS", "OLDER", "DECAYING", "DEAD", "DEADER", "DEPLETED", "INERT" };
+
+// what one replica ended up as
+struct replica_stats {
+    long seed;  // RNG seed of the replica
+    double runtime;  // seconds the replica took (initialization and time steps)
+    int steps;  // time steps it simulated (fewer than TIME_STEPS if it died out and -d stopped it)
+    long counts[CENSUS_STATES];  // cells in each state after the last time step
+};
+
+/* ensemble_split() */
+/* decides how many replicas run at once (groups) and how many threads each one gets (inner_threads) */
+void ensemble_split(int * ROWS, int * COLUMNS, int * THREADS, int * REPLICAS, int * groups, int * inner_threads) {
+    double cells = (double)(*ROWS) * (*COLUMNS);
+    *inner_threads = (int)(cells / ENSEMBLE_CELLS_PER_THREAD);  // threads a single replica can keep busy
+    if (*inner_threads < 1) { *inner_threads = 1; }
+    if (*inner_threads > *THREADS) { *inner_threads = *THREADS; }
+    *groups = (*THREADS) / (*inner_threads);
+    if (*groups > *REPLICAS) {  // too few replicas to go around, so give the spare threads to the replicas
+        *groups = *REPLICAS;
+        *inner_threads = (*THREADS) / (*groups);
+    }
+}
+
+/* census() */
+/* counts the cells of a replica's final grid in each state */
+void census(int ***grid, int * ROWS, int * COLUMNS, struct replica_stats * stats) {
+    long counts[CENSUS_STATES] = { 0 };
+    #pragma omp parallel for reduction(+:counts[:CENSUS_STATES])
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
+        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
+            counts[(*grid)[current_row][current_column]]++;
+        }
+    }
+    for (int state = 0; state < CENSUS_STATES; state++) {
+        stats->counts[state] = counts[state];
+    }
+}
+
+/* report_ensemble() */
+/* prints every replica's final state fractions, their summary over the ensemble, and the throughput to stderr */
+void report_ensemble(struct replica_stats * stats, int * REPLICAS, int * ROWS, int * COLUMNS, int * TIME_STEPS, int groups, int inner_threads, double total_time) {
+    double cells = (double)(*ROWS) * (*COLUMNS);
+    double sum[CENSUS_STATES + 1] = { 0.0 }, sum_squares[CENSUS_STATES + 1] = { 0.0 };  // the extra column is the runtime
+    double low[CENSUS_STATES + 1], high[CENSUS_STATES + 1];
+
+    fprintf(stderr, "\nensemble: %d replicas of %d x %d for %d time steps, %d at a time with %d thread(s) each\n", *REPLICAS, *ROWS, *COLUMNS, *TIME_STEPS, groups, inner_threads);
+    fprintf(stderr, "replica\tseed\truntime");
+    for (int state = 0; state < CENSUS_STATES; state++) { fprintf(stderr, "\t%s", census_names[state]); }
+    fprintf(stderr, "\n");
+
+    // one row per replica
+    for (int replica = 0; replica < (*REPLICAS); replica++) {
+        fprintf(stderr, "%d\t%ld\t%.6f", replica, stats[replica].seed, stats[replica].runtime);
+        for (int column = 0; column <= CENSUS_STATES; column++) {
+            double value = (column < CENSUS_STATES) ? stats[replica].counts[column] / cells : stats[replica].runtime;
+            if (column < CENSUS_STATES) { fprintf(stderr, "\t%.6f", value); }
+            sum[column] += value;
+            sum_squares[column] += value * value;
+            low[column] = (replica == 0 || value < low[column]) ? value : low[column];
+            high[column] = (replica == 0 || value > high[column]) ? value : high[column];
+        }
+        fprintf(stderr, "\n");
+    }
+
+    // summary rows (the runtime column summarizes the replicas' own runtimes)
+    const char * labels[] = { "mean", "stddev", "min", "max" };
+    for (int row = 0; row < 4; row++) {
+        fprintf(stderr, "%s\t-", labels[row]);
+        for (int column = 0; column <= CENSUS_STATES; column++) {
+            int index = (column == 0) ? CENSUS_STATES : column - 1;  // runtime first, then the states
+            double mean = sum[index] / (*REPLICAS);
+            double deviation = sqrt(fmax(sum_squares[index] / (*REPLICAS) - mean * mean, 0.0));
+            double value = (row == 0) ? mean : (row == 1) ? deviation : (row == 2) ? low[index] : high[index];
+            fprintf(stderr, "\t%.6f", value);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "throughput: %.1f replicas per hour (%.3e cell updates per second)\n", (*REPLICAS) * 3600.0 / total_time, (*REPLICAS) * cells * ((*TIME_STEPS) + 1) / total_time);
+}
+
+#endif
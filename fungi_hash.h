@@ -0,0 +1,56 @@
+/*******************************************************************************************
+ * fungi_hash.h
+ *******************************************************************************************
+ *
+ * hashes of the grid state, printed by the engines at every time step when run with -k so that
+ * two engines (or two thread counts) started from the same seed can be compared step by step
+ *
+ * each interior row is hashed with 64-bit FNV-1a (rows in parallel when built with OpenMP) and the
+ * row hashes are then folded together in row order, so the result depends only on the cell states
+ * and not on how the rows were split between threads; ghost rows and columns are left out
+ *
+ * the lines go to stderr as "hash<TAB>time step<TAB>16 hex digits" so stdout keeps only the runtime
+ *
+*/
+
+#ifndef FUNGI_HASH_H
+#define FUNGI_HASH_H
+
+#include <stdio.h>
+
+#define HASH_OFFSET 14695981039346656037ULL  // FNV-1a 64-bit offset basis
+#define HASH_PRIME 1099511628211ULL          // FNV-1a 64-bit prime
+
+/* hash_bytes() */
+/* folds a run of bytes into an FNV-1a hash */
+static inline unsigned long long hash_bytes(unsigned long long hash, const unsigned char * bytes, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+/* grid_hash() */
+/* returns the hash of the interior cells of the grid */
+unsigned long long grid_hash(int ***grid, int * ROWS, int * COLUMNS) {
+    unsigned long long *row_hashes = new unsigned long long[(*ROWS) + 1];
+    #pragma omp parallel for
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
+        row_hashes[current_row] = hash_bytes(HASH_OFFSET, (const unsigned char *)&(*grid)[current_row][1], sizeof(int) * (*COLUMNS));
+    }
+    unsigned long long hash = HASH_OFFSET;
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // fold the rows in order
+        hash = hash_bytes(hash, (const unsigned char *)&row_hashes[current_row], sizeof(unsigned long long));
+    }
+    delete [] row_hashes;
+    return hash;
+}
+
+/* report_hash() */
+/* prints the hash of the grid at one time step to stderr */
+void report_hash(int ***grid, int * ROWS, int * COLUMNS, int current_time_step) {
+    fprintf(stderr, "hash\t%d\t%016llx\n", current_time_step, grid_hash(grid, ROWS, COLUMNS));
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*******************************************************************************************
+ * fungi_lines.h
+ *******************************************************************************************
+ *
+ * rolling line buffers for the parallel engine's in-place update (-i), which keeps one grid instead
+ * of a current and a next one: every thread updates its own band of rows, writing each new row into
+ * a spare line and swapping the line into the grid (by its row pointer, so nothing is copied) as
+ * soon as the row below it is done, since only that row still reads the old one; the first and last
+ * rows of a band are read by the neighboring bands, so they wait until every thread is past a
+ * barrier before they are swapped in
+ *
+ * a thread never holds more than LINE_BUFFER_ROWS new rows at once (its band's first row, the row
+ * waiting for the next one, and the row being written), and every line it swaps out of the grid
+ * becomes one of its spares, so the lines all stay the same size and only change hands
+ *
+*/
+
+#ifndef FUNGI_LINES_H
+#define FUNGI_LINES_H
+
+#define LINE_BUFFER_ROWS 3  // spare lines per thread
+
+// one thread's spare lines
+struct line_buffer {
+    int *lines[LINE_BUFFER_ROWS];
+    int count;  // lines currently spare
+};
+
+/* line_buffers_create() */
+/* allocates the spare lines of every thread, each as long as a grid row */
+struct line_buffer * line_buffers_create(int threads, int * COLUMNS) {
+    struct line_buffer *buffers = new struct line_buffer[threads];
+    for (int thread = 0; thread < threads; thread++) {
+        for (int line = 0; line < LINE_BUFFER_ROWS; line++) { buffers[thread].lines[line] = new int[(*COLUMNS) + 2]; }
+        buffers[thread].count = LINE_BUFFER_ROWS;
+    }
+    return buffers;
+}
+
+/* line_take() */
+/* returns one of a thread's spare lines */
+static inline int * line_take(struct line_buffer * buffer) {
+    return buffer->lines[--buffer->count];
+}
+
+/* line_swap() */
+/* puts a new line into the grid as one row, and keeps the line it replaces as a spare */
+static inline void line_swap(struct line_buffer * buffer, int ** grid, int current_row, int * line) {
+    buffer->lines[buffer->count++] = grid[current_row];
+    grid[current_row] = line;
+}
+
+/* line_buffers_destroy() */
+/* frees the spare lines of every thread (does nothing if there are none) */
+void line_buffers_destroy(struct line_buffer * buffers, int threads) {
+    if (buffers == NULL) { return; }
+    for (int thread = 0; thread < threads; thread++) {
+        for (int line = 0; line < buffers[thread].count; line++) { delete [] buffers[thread].lines[line]; }
+    }
+    delete [] buffers;
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*******************************************************************************************
+ * fungi_monitor.h
+ *******************************************************************************************
+ *
+ * live monitoring of a parallel run (-v NAME) through a POSIX shared-memory segment /NAME that
+ * any number of viewers (fungi-view.cpp) can attach to while the run goes on, without DEBUG
+ * builds or anything printed to stdout
+ *
+ * once per time step, between the update's parallel regions, the engine's master thread publishes
+ *      the view: every factor-th cell of every factor-th row, at most MONITOR_VIEW_ROWS x
+ *          MONITOR_VIEW_COLUMNS cells, one byte each
+ *      the counters: how many cells of the view are in each state, with the time step and the
+ *          seconds since the run began, also kept for the last MONITOR_HISTORY time steps in a
+ *          ring indexed by time step
+ * the segment is guarded by a seqlock: the writer makes the sequence number odd, writes, and makes
+ * it even again, and a reader copies what it needs and retries if the number was odd or changed
+ * meanwhile; the writer never waits for (or even knows about) a reader, so a viewer can't slow the
+ * run, and publishing reads only the sampled cells, so it costs the same whatever the grid size
+ *
+ * the segment is created when the run starts and removed when it ends, after the finished flag is
+ * set for the viewers still attached
+ *
+*/
+
+#ifndef FUNGI_MONITOR_H
+#define FUNGI_MONITOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MONITOR_MAGIC 0x464d4f4e  // "FMON", marks a segment written by this version
+#define MONITOR_VIEW_ROWS 48      // largest view, sized for a terminal
+#define MONITOR_VIEW_COLUMNS 120
+#define MONITOR_HISTORY 64        // time steps kept in the counter ring
+#define MONITOR_STATES 11         // cell states, EMPTY to INERT
+
+// the counters of one time step
+struct monitor_sample {
+    int time_step;  // -1 if not published yet
+    double elapsed;  // seconds since the run began
+    long counts[MONITOR_STATES];  // cells of the view in each state
+};
+
+// the start of the segment (the view follows it)
+struct monitor_header {
+    int magic;  // MONITOR_MAGIC
+    int rows, columns, time_steps;  // of the run
+    int view_rows, view_columns, factor;  // of the view (view cell (r, c) is grid cell (r * factor + 1, c * factor + 1))
+    unsigned long sequence;  // seqlock (odd while the writer is in the middle of an update)
+    int finished;  // 1 once the run is over
+    struct monitor_sample latest;  // counters of the time step in the view
+    struct monitor_sample history[MONITOR_HISTORY];  // counters of recent time steps, at time_step % MONITOR_HISTORY
+};
+
+// an open segment
+struct monitor {
+    char *name;  // of the segment ("/" and the name given)
+    struct monitor_header *header;  // the mapped segment
+    unsigned char *view;  // view_rows * view_columns states, row by row, right after the header
+    size_t length;  // bytes mapped
+};
+
+/* monitor_size() */
+/* returns the bytes of a segment with a view of view_rows x view_columns */
+static inline size_t monitor_size(int view_rows, int view_columns) {
+    return sizeof(struct monitor_header) + (size_t)view_rows * view_columns;
+}
+
+/* monitor_name() */
+/* returns the shared-memory name of a monitor name, which must not hold a slash (free() it) */
+static char * monitor_name(const char * name) {
+    char *path = (char *)malloc(strlen(name) + 2);
+    sprintf(path, "/%s", name);
+    return path;
+}
+
+/* monitor_open() */
+/* creates the segment of a run and sizes its view; exits with a usage message if it can't */
+struct monitor * monitor_open(const char * name, int * ROWS, int * COLUMNS, int * TIME_STEPS, const char * program) {
+    struct monitor *monitor = new struct monitor;
+    int factor_rows = ((*ROWS) + MONITOR_VIEW_ROWS - 1) / MONITOR_VIEW_ROWS;
+    int factor_columns = ((*COLUMNS) + MONITOR_VIEW_COLUMNS - 1) / MONITOR_VIEW_COLUMNS;
+    int factor = (factor_rows > factor_columns) ? factor_rows : factor_columns;  // the same in both directions, so the view keeps the grid's shape
+    int view_rows = ((*ROWS) + factor - 1) / factor, view_columns = ((*COLUMNS) + factor - 1) / factor;
+    monitor->name = monitor_name(name);
+    monitor->length = monitor_size(view_rows, view_columns);
+    int file = (strchr(name, '/') == NULL) ? shm_open(monitor->name, O_RDWR | O_CREAT | O_TRUNC, 0644) : -1;
+    if (file < 0 || ftruncate(file, (off_t)monitor->length) != 0) {
+        fprintf(stderr, "Usage: %s -v could not create shared memory %s (the name can't hold a slash)\n", program, monitor->name);
+        exit(EXIT_FAILURE);
+    }
+    void *map = mmap(NULL, monitor->length, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);  // the mapping keeps the segment open
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Usage: %s -v could not map shared memory %s\n", program, monitor->name);
+        exit(EXIT_FAILURE);
+    }
+    monitor->header = (struct monitor_header *)map;
+    monitor->view = (unsigned char *)map + sizeof(struct monitor_header);
+    monitor->header->rows = *ROWS;
+    monitor->header->columns = *COLUMNS;
+    monitor->header->time_steps = *TIME_STEPS;
+    monitor->header->view_rows = view_rows;
+    monitor->header->view_columns = view_columns;
+    monitor->header->factor = factor;
+    monitor->header->latest.time_step = -1;
+    for (int slot = 0; slot < MONITOR_HISTORY; slot++) { monitor->header->history[slot].time_step = -1; }
+    __atomic_store_n(&monitor->header->magic, MONITOR_MAGIC, __ATOMIC_RELEASE);  // (last, so a viewer never sees a half-made header)
+    return monitor;
+}
+
+/* monitor_publish() */
+/* samples the grid into the view and publishes it with its counters (called by one thread, outside any parallel region) */
+void monitor_publish(struct monitor * monitor, int ***grid, int current_time_step, double elapsed) {
+    struct monitor_header *header = monitor->header;
+    unsigned long sequence = header->sequence;
+    __atomic_store_n(&header->sequence, sequence + 1, __ATOMIC_RELAXED);  // odd: readers retry
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    struct monitor_sample sample = { current_time_step, elapsed, { 0 } };
+    for (int view_row = 0; view_row < header->view_rows; view_row++) {  // for each sampled row...
+        const int *row = (*grid)[view_row * header->factor + 1];
+        unsigned char *view = &monitor->view[(size_t)view_row * header->view_columns];
+        for (int view_column = 0; view_column < header->view_columns; view_column++) {  // ...and each sampled cell in it
+            int state = row[view_column * header->factor + 1];
+            view[view_column] = (unsigned char)state;
+            sample.counts[state]++;
+        }
+    }
+    header->latest = sample;
+    header->history[current_time_step % MONITOR_HISTORY] = sample;
+
+    __atomic_store_n(&header->sequence, sequence + 2, __ATOMIC_RELEASE);  // even again: the update is whole
+}
+
+/* monitor_close() */
+/* tells the viewers the run is over and removes the segment (does nothing if there is none) */
+void monitor_close(struct monitor * monitor) {
+    if (monitor == NULL) { return; }
+    __atomic_store_n(&monitor->header->finished, 1, __ATOMIC_RELEASE);
+    munmap(monitor->header, monitor->length);
+    shm_unlink(monitor->name);  // (viewers still attached keep their mapping)
+    free(monitor->name);
+    delete monitor;
+}
+
+/* monitor_attach() */
+/* maps the segment of a running job read-only for a viewer; returns NULL if there is none (yet) */
+struct monitor * monitor_attach(const char * name) {
+    char *path = monitor_name(name);
+    int file = shm_open(path, O_RDONLY, 0);
+    free(path);
+    if (file < 0) { return NULL; }
+    struct stat status;
+    void *map = MAP_FAILED;
+    if (fstat(file, &status) == 0 && (size_t)status.st_size >= sizeof(struct monitor_header)) {
+        map = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    close(file);
+    if (map == MAP_FAILED) { return NULL; }
+    struct monitor *monitor = new struct monitor;
+    monitor->name = NULL;
+    monitor->header = (struct monitor_header *)map;
+    monitor->view = (unsigned char *)map + sizeof(struct monitor_header);
+    monitor->length = (size_t)status.st_size;
+    if (__atomic_load_n(&monitor->header->magic, __ATOMIC_ACQUIRE) != MONITOR_MAGIC || monitor->length < monitor_size(monitor->header->view_rows, monitor->header->view_columns)) {
+        munmap(map, monitor->length);  // not (or not yet) a whole segment
+        delete monitor;
+        return NULL;
+    }
+    return monitor;
+}
+
+/* monitor_read() */
+/* copies a consistent snapshot of the latest counters, the history, and the view (view_rows * view_columns bytes); returns 0 if the run hasn't published a time step yet */
+int monitor_read(struct monitor * monitor, struct monitor_sample * latest, struct monitor_sample * history, unsigned char * view) {
+    struct monitor_header *header = monitor->header;
+    size_t view_bytes = (size_t)header->view_rows * header->view_columns;
+    unsigned long before, after;
+    do {
+        before = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) { continue; }  // the writer is busy
+        memcpy(latest, &header->latest, sizeof(struct monitor_sample));
+        memcpy(history, header->history, sizeof(header->history));
+        memcpy(view, monitor->view, view_bytes);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+    return latest->time_step >= 0;
+}
+
+/* monitor_detach() */
+/* unmaps a viewer's segment */
+void monitor_detach(struct monitor * monitor) {
+    munmap(monitor->header, monitor->length);
+    delete monitor;
+}
+
+#endif
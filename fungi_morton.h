@@ -0,0 +1,172 @@
+/*******************************************************************************************
+ * fungi_morton.h
+ *******************************************************************************************
+ *
+ * blocked grids in Morton (Z) order for the sequential engine (-b), for wide grids whose rows are
+ * too long for the three rows check_neighbors() reads to stay in cache: the grid is cut into tiles
+ * of MORTON_TILE x MORTON_TILE cells, each stored contiguously with a ring of halo cells around it
+ * (MORTON_SPAN cells square in all), and the tiles are laid out in the order of their Morton codes
+ * (the bits of the tile row and tile column interleaved), so tiles close together in the grid are
+ * mostly close together in memory as well
+ *
+ * each tile's halo plays the part of the dense grid's ghost rows and columns: morton_halo() copies
+ * into it the edge cells of the eight neighboring tiles (with the same periodic wraparound), after
+ * which a tile's rows are ordinary row pointers and the dense kernels run on it unchanged, reading
+ * the current grid's tile and writing the next grid's; the engine visits the tiles in storage
+ * order too, and since the Morton order visits the tiles of any one tile row left to right, every
+ * row still consumes its draws in the same order as in the dense grid
+ *
+ * every cell is reached through morton_tile() and morton_cell(), so the update, halo, output, and
+ * hash code agree on the layout; tiles on the bottom and right edges may be cut short, and their
+ * unused cells are never read
+ *
+ * must be included after the cell states are defined and after fungi_hash.h
+ *
+*/
+
+#ifndef FUNGI_MORTON_H
+#define FUNGI_MORTON_H
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define MORTON_TILE 64                  // rows and columns per tile
+#define MORTON_SPAN (MORTON_TILE + 2)   // rows and columns per tile with its halo
+
+// a grid stored as tiles in Morton order
+struct morton_grid {
+    int rows, columns;  // interior cells
+    int tile_rows, tile_columns;  // tiles down and across (the last ones may be cut short)
+    int *rank;  // position in storage of each tile, tile row by tile row
+    int *order;  // tile (tile_row * tile_columns + tile_column) at each position in storage
+    int *cells;  // MORTON_SPAN * MORTON_SPAN cells per tile, halo included, row by row
+};
+
+/* morton_code() */
+/* interleaves the bits of a tile row and a tile column (the column in the even bits) */
+static inline unsigned long long morton_code(unsigned int tile_row, unsigned int tile_column) {
+    unsigned long long code = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        code |= (unsigned long long)((tile_column >> bit) & 1) << (2 * bit);
+        code |= (unsigned long long)((tile_row >> bit) & 1) << (2 * bit + 1);
+    }
+    return code;
+}
+
+/* morton_create() */
+/* allocates a blocked grid and ranks its tiles by Morton code (cells are not cleared) */
+struct morton_grid * morton_create(int * ROWS, int * COLUMNS) {
+    struct morton_grid *grid = new struct morton_grid;
+    grid->rows = *ROWS;
+    grid->columns = *COLUMNS;
+    grid->tile_rows = ((*ROWS) + MORTON_TILE - 1) / MORTON_TILE;
+    grid->tile_columns = ((*COLUMNS) + MORTON_TILE - 1) / MORTON_TILE;
+    int tiles = grid->tile_rows * grid->tile_columns;
+    grid->rank = new int[tiles];
+    grid->order = new int[tiles];
+    for (int tile = 0; tile < tiles; tile++) { grid->order[tile] = tile; }
+    std::sort(grid->order, grid->order + tiles, [grid](int first, int second) {
+        return morton_code(first / grid->tile_columns, first % grid->tile_columns) < morton_code(second / grid->tile_columns, second % grid->tile_columns);
+    });
+    for (int position = 0; position < tiles; position++) { grid->rank[grid->order[position]] = position; }
+    grid->cells = new int[(size_t)tiles * MORTON_SPAN * MORTON_SPAN];
+    return grid;
+}
+
+/* morton_tile() */
+/* returns the first cell (the halo's top-left corner) of the tile at a tile position, wrapping around the edges */
+static inline int * morton_tile(struct morton_grid * grid, int tile_row, int tile_column) {
+    if (tile_row < 0) { tile_row += grid->tile_rows; } else if (tile_row >= grid->tile_rows) { tile_row -= grid->tile_rows; }
+    if (tile_column < 0) { tile_column += grid->tile_columns; } else if (tile_column >= grid->tile_columns) { tile_column -= grid->tile_columns; }
+    return grid->cells + (size_t)grid->rank[tile_row * grid->tile_columns + tile_column] * MORTON_SPAN * MORTON_SPAN;
+}
+
+/* morton_height() */
+/* returns the rows of interior cells in a tile row */
+static inline int morton_height(struct morton_grid * grid, int tile_row) {
+    int first_row = tile_row * MORTON_TILE + 1;
+    return (first_row + MORTON_TILE - 1 <= grid->rows) ? MORTON_TILE : grid->rows - first_row + 1;
+}
+
+/* morton_width() */
+/* returns the columns of interior cells in a tile column */
+static inline int morton_width(struct morton_grid * grid, int tile_column) {
+    int first_column = tile_column * MORTON_TILE + 1;
+    return (first_column + MORTON_TILE - 1 <= grid->columns) ? MORTON_TILE : grid->columns - first_column + 1;
+}
+
+/* morton_cell() */
+/* returns a pointer to an interior cell */
+static inline int * morton_cell(struct morton_grid * grid, int current_row, int current_column) {
+    int *tile = morton_tile(grid, (current_row - 1) / MORTON_TILE, (current_column - 1) / MORTON_TILE);
+    return &tile[((current_row - 1) % MORTON_TILE + 1) * MORTON_SPAN + (current_column - 1) % MORTON_TILE + 1];
+}
+
+/* morton_rows() */
+/* points rows[0] to rows[MORTON_SPAN - 1] at the rows of a tile, so it can be indexed like a window of the dense grid */
+static inline void morton_rows(int * tile, int ** rows) {
+    for (int row = 0; row < MORTON_SPAN; row++) { rows[row] = tile + row * MORTON_SPAN; }
+}
+
+/* morton_set_row() */
+/* stores one row of cells (row[1] to row[COLUMNS], as in the dense grid) */
+void morton_set_row(struct morton_grid * grid, int current_row, const int * row) {
+    for (int tile_column = 0; tile_column < grid->tile_columns; tile_column++) {  // for each tile the row crosses...
+        int first = tile_column * MORTON_TILE + 1;
+        memcpy(morton_cell(grid, current_row, first), &row[first], sizeof(int) * morton_width(grid, tile_column));
+    }
+}
+
+/* morton_halo() */
+/* fills the halo of every tile with the edge cells of its neighbors, wrapping around the grid like the ghost rows and columns */
+void morton_halo(struct morton_grid * grid) {
+    for (int position = 0; position < grid->tile_rows * grid->tile_columns; position++) {  // for each tile, in storage order...
+        int tile_row = grid->order[position] / grid->tile_columns, tile_column = grid->order[position] % grid->tile_columns;
+        int height = morton_height(grid, tile_row), width = morton_width(grid, tile_column);
+        int above = morton_height(grid, (tile_row + grid->tile_rows - 1) % grid->tile_rows);  // last row of the tile above
+        int left = morton_width(grid, (tile_column + grid->tile_columns - 1) % grid->tile_columns);  // last column of the tile to the left
+        int *tile = grid->cells + (size_t)position * MORTON_SPAN * MORTON_SPAN;
+
+        // top and bottom edges, corners included
+        int *up = morton_tile(grid, tile_row - 1, tile_column), *down = morton_tile(grid, tile_row + 1, tile_column);
+        memcpy(&tile[1], &up[above * MORTON_SPAN + 1], sizeof(int) * width);
+        memcpy(&tile[(height + 1) * MORTON_SPAN + 1], &down[MORTON_SPAN + 1], sizeof(int) * width);
+        tile[0] = morton_tile(grid, tile_row - 1, tile_column - 1)[above * MORTON_SPAN + left];
+        tile[width + 1] = morton_tile(grid, tile_row - 1, tile_column + 1)[above * MORTON_SPAN + 1];
+        tile[(height + 1) * MORTON_SPAN] = morton_tile(grid, tile_row + 1, tile_column - 1)[MORTON_SPAN + left];
+        tile[(height + 1) * MORTON_SPAN + width + 1] = morton_tile(grid, tile_row + 1, tile_column + 1)[MORTON_SPAN + 1];
+
+        // left and right edges
+        int *west = morton_tile(grid, tile_row, tile_column - 1), *east = morton_tile(grid, tile_row, tile_column + 1);
+        for (int row = 1; row <= height; row++) {
+            tile[row * MORTON_SPAN] = west[row * MORTON_SPAN + left];
+            tile[row * MORTON_SPAN + width + 1] = east[row * MORTON_SPAN + 1];
+        }
+    }
+}
+
+/* report_morton_hash() */
+/* prints the hash of a blocked grid at one time step to stderr, equal to grid_hash() of the same cells in a dense grid */
+void report_morton_hash(struct morton_grid * grid, int current_time_step) {
+    unsigned long long hash = HASH_OFFSET;
+    for (int current_row = 1; current_row <= grid->rows; current_row++) {  // hash each row a tile at a time, then fold it in in order
+        unsigned long long row_hash = HASH_OFFSET;
+        for (int tile_column = 0; tile_column < grid->tile_columns; tile_column++) {
+            row_hash = hash_bytes(row_hash, (const unsigned char *)morton_cell(grid, current_row, tile_column * MORTON_TILE + 1), sizeof(int) * morton_width(grid, tile_column));
+        }
+        hash = hash_bytes(hash, (const unsigned char *)&row_hash, sizeof(unsigned long long));
+    }
+    fprintf(stderr, "hash\t%d\t%016llx\n", current_time_step, hash);
+}
+
+/* morton_destroy() */
+/* frees a blocked grid */
+void morton_destroy(struct morton_grid * grid) {
+    delete [] grid->rank;
+    delete [] grid->order;
+    delete [] grid->cells;
+    delete grid;
+}
+
+#endif
@@ -0,0 +1,367 @@
+/*******************************************************************************************
+ * fungi_networks.h
+ *******************************************************************************************
+ *
+ * labels the connected mycelium networks (live hyphae joined through any of their 8
+ * neighbors) in a grid and reports how many there are, how big they are, and where they are
+ *
+ * the labeling is a parallel union-find:
+ *      1) the grid is split into one band of rows per thread, and each thread joins the
+ *         cells of its own band (no other thread touches those cells, so no locking)
+ *      2) one thread then joins the cells along the seams between bands, including the
+ *         wraparound seams between the last and first rows and columns (the same torus the
+ *         ghost rows and columns in mushrooms() create)
+ *      3) every cell is pointed directly at the root of its network, the roots are numbered,
+ *         and each network's size and bounding box are tallied
+ *
+ * the union-find entries are 32-bit ints whenever every cell index (and every negative network id)
+ * fits in one, and longs only for grids of INT_MAX cells or more; network_labels_create() keeps
+ * them after labeling, so other trackers can look up the network of any cell (network_label())
+ *
+ * must be included after the cell states are defined
+ *
+*/
+
+#ifndef FUNGI_NETWORKS_H
+#define FUNGI_NETWORKS_H
+
+#include <algorithm>
+#include <limits.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+// number of networks listed individually in each report (largest first)
+#define NETWORK_REPORT_LIMIT 10
+
+// union-find entry for a cell that is not part of any network
+#define NOT_LIVE -1
+
+// a cell is part of a network if it holds live hyphae
+#define IS_LIVE(value) ((value) >= YOUNG && (value) <= OLDER)
+
+// size and torus-aware bounding box of one network
+struct network {
+    long size;  // number of cells in the network
+    int min_row, max_row;  // bounding rows
+    int min_column, max_column;  // bounding columns
+    int min_shifted_row, max_shifted_row;  // bounding rows with the grid rolled by half its height
+    int min_shifted_column, max_shifted_column;  // bounding columns with the grid rolled by half its width
+};
+
+/* network_index() */
+/* returns the union-find index of a grid cell (rows and columns start at 1, like the grid) */
+static inline long network_index(int current_row, int current_column, int COLUMNS) {
+    return (long)(current_row - 1) * COLUMNS + (current_column - 1);
+}
+
+/* network_find() */
+/* returns the root of a cell's network, halving the path on the way up */
+template <class INDEX> static inline INDEX network_find(INDEX * parent, INDEX cell) {
+    while (parent[cell] != cell) {
+        parent[cell] = parent[parent[cell]];
+        cell = parent[cell];
+    }
+    return cell;
+}
+
+/* network_union() */
+/* joins the networks of two live cells; the smaller index always becomes the root */
+template <class INDEX> static inline void network_union(INDEX * parent, INDEX cell_a, INDEX cell_b) {
+    INDEX root_a = network_find(parent, cell_a);
+    INDEX root_b = network_find(parent, cell_b);
+    if (root_a < root_b) {
+        parent[root_b] = root_a;
+    } else if (root_b < root_a) {
+        parent[root_a] = root_b;
+    }
+}
+
+/* network_join_up() */
+/* joins a live cell with its live neighbors in the row above (wrapping columns) */
+template <class INDEX> static inline void network_join_up(int ***grid, INDEX * parent, int current_row, int upper_row, int current_column, int * COLUMNS) {
+    int left = (current_column == 1) ? (*COLUMNS) : current_column - 1;  // wrapped column to the left
+    int right = (current_column == (*COLUMNS)) ? 1 : current_column + 1;  // wrapped column to the right
+    INDEX cell = (INDEX)network_index(current_row, current_column, *COLUMNS);
+
+    if (IS_LIVE((*grid)[upper_row][left])) { network_union(parent, cell, (INDEX)network_index(upper_row, left, *COLUMNS)); }
+    if (IS_LIVE((*grid)[upper_row][current_column])) { network_union(parent, cell, (INDEX)network_index(upper_row, current_column, *COLUMNS)); }
+    if (IS_LIVE((*grid)[upper_row][right])) { network_union(parent, cell, (INDEX)network_index(upper_row, right, *COLUMNS)); }
+}
+
+/* network_id() */
+/* returns the id of a labeled cell's network (roots hold their id, other cells point at their root), or NOT_LIVE */
+template <class INDEX> static inline long network_id(INDEX * parent, long cell) {
+    INDEX entry = parent[cell];
+    if (entry == NOT_LIVE) { return NOT_LIVE; }
+    return (entry < 0) ? -(long)entry - 2 : -(long)parent[entry] - 2;
+}
+
+/* network_atomic_min() */
+/* lowers a shared bound to value if value is smaller */
+static inline void network_atomic_min(int * bound, int value) {
+    int seen = __atomic_load_n(bound, __ATOMIC_RELAXED);
+    while (value < seen && !__atomic_compare_exchange_n(bound, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+/* network_atomic_max() */
+/* raises a shared bound to value if value is larger */
+static inline void network_atomic_max(int * bound, int value) {
+    int seen = __atomic_load_n(bound, __ATOMIC_RELAXED);
+    while (value > seen && !__atomic_compare_exchange_n(bound, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+/* label_networks() */
+/* labels the mycelium networks in the grid using parent (one entry per cell) for the union-find; returns the number of networks and stores a newly allocated array of their stats in *networks */
+template <class INDEX> long label_networks(int ***grid, int * ROWS, int * COLUMNS, struct network ** networks, INDEX * parent) {
+    int bands = 1;  // number of row bands (one per thread)
+    #ifdef _OPENMP
+        bands = omp_get_max_threads();
+    #endif
+    if (bands > (*ROWS)) { bands = (*ROWS); }
+    long * band_roots = new long[bands + 1];  // number of networks rooted in each band, then the first id of each band
+    long network_count = 0;  // total number of networks
+    struct network * stats = NULL;  // stats of every network
+
+    #pragma omp parallel num_threads(bands)
+    {
+        int band = 0;  // this thread's band
+        #ifdef _OPENMP
+            band = omp_get_thread_num();
+        #endif
+        int first_row = 1 + (int)((long)(*ROWS) * band / bands);  // first row of this band
+        int last_row = (int)((long)(*ROWS) * (band + 1) / bands);  // last row of this band
+
+        // 1) every live cell starts as its own network (first touch also places this band's memory near its thread)
+        for (int current_row = first_row; current_row <= last_row; current_row++) {
+            for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {
+                INDEX cell = (INDEX)network_index(current_row, current_column, *COLUMNS);
+                parent[cell] = IS_LIVE((*grid)[current_row][current_column]) ? cell : (INDEX)NOT_LIVE;
+            }
+        }
+
+        // join each live cell with its live neighbors inside the band (columns wrap around); neighbors that
+        // touch each other are already joined, so e.g. a live cell straight above makes the others redundant
+        for (int current_row = first_row; current_row <= last_row; current_row++) {
+            for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {
+                if (!IS_LIVE((*grid)[current_row][current_column])) { continue; }
+                INDEX cell = (INDEX)network_index(current_row, current_column, *COLUMNS);
+                int left = (current_column == 1) ? (*COLUMNS) : current_column - 1;
+                int right = (current_column == (*COLUMNS)) ? 1 : current_column + 1;
+                int upper_row = current_row - 1;
+                int has_upper = (current_row > first_row);  // the row above belongs to this band
+
+                if (has_upper && IS_LIVE((*grid)[upper_row][current_column])) {  // above touches above-left, above-right and left
+                    network_union(parent, cell, (INDEX)network_index(upper_row, current_column, *COLUMNS));
+                    continue;
+                }
+                if (has_upper && IS_LIVE((*grid)[upper_row][right])) {
+                    network_union(parent, cell, (INDEX)network_index(upper_row, right, *COLUMNS));
+                }
+                if (has_upper && IS_LIVE((*grid)[upper_row][left])) {  // above-left touches left
+                    network_union(parent, cell, (INDEX)network_index(upper_row, left, *COLUMNS));
+                } else if (IS_LIVE((*grid)[current_row][left])) {
+                    network_union(parent, cell, (INDEX)network_index(current_row, left, *COLUMNS));
+                }
+            }
+        }
+        #pragma omp barrier
+
+        // 2) join across the seam above each band (the first band's seam is the wraparound to the last row)
+        #pragma omp single
+        {
+            for (int seam = 0; seam < bands; seam++) {
+                int seam_row = 1 + (int)((long)(*ROWS) * seam / bands);
+                int upper_row = (seam_row == 1) ? (*ROWS) : seam_row - 1;
+                for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {
+                    if (IS_LIVE((*grid)[seam_row][current_column])) {
+                        network_join_up(grid, parent, seam_row, upper_row, current_column, COLUMNS);
+                    }
+                }
+            }
+        }  // (implicit barrier)
+
+        // 3) point every cell directly at its root (other threads may be reading the same entries, so use atomics)
+        long roots = 0;  // networks rooted in this band
+        for (int current_row = first_row; current_row <= last_row; current_row++) {
+            for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {
+                INDEX cell = (INDEX)network_index(current_row, current_column, *COLUMNS);
+                INDEX root = __atomic_load_n(&parent[cell], __ATOMIC_RELAXED);
+                if (root == NOT_LIVE) { continue; }
+                INDEX above = __atomic_load_n(&parent[root], __ATOMIC_RELAXED);
+                while (above != root) {
+                    root = above;
+                    above = __atomic_load_n(&parent[root], __ATOMIC_RELAXED);
+                }
+                __atomic_store_n(&parent[cell], root, __ATOMIC_RELAXED);
+                if (root == cell) { roots++; }
+            }
+        }
+        band_roots[band + 1] = roots;
+        #pragma omp barrier
+
+        // number the networks band by band and allocate their stats
+        #pragma omp single
+        {
+            band_roots[0] = 0;
+            for (int b = 1; b <= bands; b++) { band_roots[b] += band_roots[b - 1]; }
+            network_count = band_roots[bands];
+            stats = new struct network[network_count];
+            for (long id = 0; id < network_count; id++) {
+                stats[id].size = 0;
+                stats[id].min_row = stats[id].min_shifted_row = (*ROWS) + 1;
+                stats[id].max_row = stats[id].max_shifted_row = 0;
+                stats[id].min_column = stats[id].min_shifted_column = (*COLUMNS) + 1;
+                stats[id].max_column = stats[id].max_shifted_column = 0;
+            }
+        }  // (implicit barrier)
+
+        // each root now stores its network's id, encoded as a negative number below NOT_LIVE
+        long next_id = band_roots[band];
+        for (long cell = network_index(first_row, 1, *COLUMNS); cell <= network_index(last_row, *COLUMNS, *COLUMNS); cell++) {
+            if (parent[cell] == cell) {
+                parent[cell] = (INDEX)(-(next_id + 2));
+                next_id++;
+            }
+        }
+        #pragma omp barrier
+
+        // tally sizes and bounds, one run of same-network cells at a time to keep atomics rare
+        int half_rows = (*ROWS) / 2;
+        int half_columns = (*COLUMNS) / 2;
+        for (int current_row = first_row; current_row <= last_row; current_row++) {
+            int shifted_row = (current_row - 1 + half_rows) % (*ROWS) + 1;
+            int current_column = 1;
+            while (current_column <= (*COLUMNS)) {
+                long id = network_id(parent, network_index(current_row, current_column, *COLUMNS));
+                if (id == NOT_LIVE) {
+                    current_column++;
+                    continue;
+                }
+
+                // extend the run while the following cells belong to the same network
+                int run_start = current_column;
+                int min_shifted = (current_column - 1 + half_columns) % (*COLUMNS) + 1;
+                int max_shifted = min_shifted;
+                current_column++;
+                while (current_column <= (*COLUMNS)) {
+                    if (network_id(parent, network_index(current_row, current_column, *COLUMNS)) != id) { break; }
+                    int shifted_column = (current_column - 1 + half_columns) % (*COLUMNS) + 1;
+                    if (shifted_column < min_shifted) { min_shifted = shifted_column; }
+                    if (shifted_column > max_shifted) { max_shifted = shifted_column; }
+                    current_column++;
+                }
+
+                // fold the run into the network's stats
+                __atomic_fetch_add(&stats[id].size, (long)(current_column - run_start), __ATOMIC_RELAXED);
+                network_atomic_min(&stats[id].min_row, current_row);
+                network_atomic_max(&stats[id].max_row, current_row);
+                network_atomic_min(&stats[id].min_shifted_row, shifted_row);
+                network_atomic_max(&stats[id].max_shifted_row, shifted_row);
+                network_atomic_min(&stats[id].min_column, run_start);
+                network_atomic_max(&stats[id].max_column, current_column - 1);
+                network_atomic_min(&stats[id].min_shifted_column, min_shifted);
+                network_atomic_max(&stats[id].max_shifted_column, max_shifted);
+            }
+        }
+    }
+
+    // keep whichever bounding box (plain or rolled by half the grid) is tighter, so networks
+    // that wrap across an edge of the grid report their real extent
+    for (long id = 0; id < network_count; id++) {
+        if (stats[id].max_shifted_row - stats[id].min_shifted_row < stats[id].max_row - stats[id].min_row) {
+            stats[id].min_row = ((stats[id].min_shifted_row - 1) + (*ROWS) - (*ROWS) / 2) % (*ROWS) + 1;
+            stats[id].max_row = ((stats[id].max_shifted_row - 1) + (*ROWS) - (*ROWS) / 2) % (*ROWS) + 1;
+        }
+        if (stats[id].max_shifted_column - stats[id].min_shifted_column < stats[id].max_column - stats[id].min_column) {
+            stats[id].min_column = ((stats[id].min_shifted_column - 1) + (*COLUMNS) - (*COLUMNS) / 2) % (*COLUMNS) + 1;
+            stats[id].max_column = ((stats[id].max_shifted_column - 1) + (*COLUMNS) - (*COLUMNS) / 2) % (*COLUMNS) + 1;
+        }
+    }
+
+    delete [] band_roots;
+    *networks = stats;
+    return network_count;
+}
+
+// the networks of a grid, with every cell's union-find entry kept for network_label()
+struct network_labels {
+    int * parent;  // union-find entry of every cell (NULL if the grid needs wide_parent)
+    long * wide_parent;  // the same for grids of INT_MAX cells or more (NULL otherwise)
+    int columns;  // columns of the grid (not counting ghosts)
+    long count;  // number of networks
+    struct network * networks;  // stats of every network, by id
+};
+
+/* network_labels_create() */
+/* labels the mycelium networks in the grid and keeps every cell's label */
+struct network_labels * network_labels_create(int ***grid, int * ROWS, int * COLUMNS) {
+    struct network_labels * labels = new struct network_labels;
+    long cells = (long)(*ROWS) * (*COLUMNS);  // number of cells in the grid (not counting ghosts)
+    labels->parent = NULL;
+    labels->wide_parent = NULL;
+    labels->columns = (*COLUMNS);
+    if (cells < INT_MAX) {  // (ids are stored as -(id + 2), so the most negative entry is -(cells + 1))
+        labels->parent = new int[cells];
+        labels->count = label_networks(grid, ROWS, COLUMNS, &labels->networks, labels->parent);
+    } else {
+        labels->wide_parent = new long[cells];
+        labels->count = label_networks(grid, ROWS, COLUMNS, &labels->networks, labels->wide_parent);
+    }
+    return labels;
+}
+
+/* network_label() */
+/* returns the id of the network a grid cell belongs to (rows and columns start at 1), or NOT_LIVE if it holds no live hyphae */
+static inline long network_label(struct network_labels * labels, int current_row, int current_column) {
+    long cell = network_index(current_row, current_column, labels->columns);
+    return (labels->parent != NULL) ? network_id(labels->parent, cell) : network_id(labels->wide_parent, cell);
+}
+
+/* network_labels_destroy() */
+/* frees the labels of a grid and the stats of its networks */
+void network_labels_destroy(struct network_labels * labels) {
+    delete [] labels->parent;
+    delete [] labels->wide_parent;
+    delete [] labels->networks;
+    delete labels;
+}
+
+/* label_networks() */
+/* labels the mycelium networks in the grid; returns the number of networks and stores a newly allocated array of their stats in *networks */
+long label_networks(int ***grid, int * ROWS, int * COLUMNS, struct network ** networks) {
+    struct network_labels * labels = network_labels_create(grid, ROWS, COLUMNS);
+    long network_count = labels->count;
+    *networks = labels->networks;
+    labels->networks = NULL;  // (handed over to the caller)
+    network_labels_destroy(labels);
+    return network_count;
+}
+
+/* report_networks() */
+/* labels the mycelium networks in the grid and prints their count, sizes and bounding boxes to stderr */
+void report_networks(int ***grid, int * ROWS, int * COLUMNS, int current_time_step) {
+    struct network * networks;  // stats of every network
+    long network_count = label_networks(grid, ROWS, COLUMNS, &networks);
+    long live_cells = 0;  // cells in any network
+    for (long id = 0; id < network_count; id++) { live_cells += networks[id].size; }
+
+    // order the largest networks first
+    long listed = std::min(network_count, (long)NETWORK_REPORT_LIMIT);
+    long * order = new long[network_count];
+    for (long id = 0; id < network_count; id++) { order[id] = id; }
+    std::partial_sort(order, order + listed, order + network_count, [networks](long a, long b) { return networks[a].size > networks[b].size; });
+
+    fprintf(stderr, "networks at time step %d: %ld networks, %ld live hyphae cells\n", current_time_step, network_count, live_cells);
+    for (long i = 0; i < listed; i++) {
+        struct network * n = &networks[order[i]];
+        // a bound whose min is past its max wraps around the edge of the grid
+        fprintf(stderr, "    network %ld: %ld cells, rows %d-%d, columns %d-%d%s\n", i + 1, n->size, n->min_row, n->max_row, n->min_column, n->max_column,
+                (n->min_row > n->max_row || n->min_column > n->max_column) ? " (wraps)" : "");
+    }
+
+    delete [] order;
+    delete [] networks;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*******************************************************************************************
+ * fungi_nutrients.h
+ *******************************************************************************************
+ *
+ * an optional nutrient field for the engines (-u): every cell holds a nutrient level from 0 to
+ * NUTRIENT_FULL in one byte (fixed point, NUTRIENT_FULL meaning fully fed soil), and the level is
+ * coupled to the transitions:
+ *      hyphae (YOUNG, MATURING, MUSHROOMS, OLDER) use up NUTRIENT_CONSUMED per time step
+ *      every other cell recovers NUTRIENT_RECOVERY per time step, up to NUTRIENT_FULL
+ *      an EMPTY cell next to YOUNG hyphae becomes YOUNG with probability probSpread scaled by
+ *          its level, so hyphae don't spread back into soil they have just exhausted
+ *      a DEPLETED cell becomes EMPTY once its level is back to NUTRIENT_RECOVERED, which takes the
+ *          place of the probDepletedToEmpty coin flip (probDepletedToSpore still applies)
+ *
+ * the levels are a structure of arrays next to the grid rather than a field of each cell: they live
+ * in one contiguous array of their own, so a run without -u passes NULL and the state-only kernel
+ * moves exactly the bytes it did before; a cell's level depends only on the cell itself, so it is
+ * updated in place in the same pass as the state and needs no second buffer
+ *
+ * must be included after the cell states are defined
+ *
+*/
+
+#ifndef FUNGI_NUTRIENTS_H
+#define FUNGI_NUTRIENTS_H
+
+#include <string.h>
+
+#define NUTRIENT_FULL 255       // level of fully fed soil (the initial level)
+#define NUTRIENT_CONSUMED 48    // level used up per time step by hyphae
+#define NUTRIENT_RECOVERY 3     // level regained per time step by every other cell
+#define NUTRIENT_RECOVERED 192  // level at which DEPLETED soil becomes EMPTY again
+
+// nutrient levels of the interior cells, row by row
+struct nutrient_field {
+    unsigned char *levels;  // ROWS * COLUMNS levels
+    int columns;  // cells per row
+};
+
+/* nutrients_create() */
+/* allocates a nutrient field for the grid, with every cell fully fed */
+struct nutrient_field * nutrients_create(int * ROWS, int * COLUMNS) {
+    struct nutrient_field *nutrients = new struct nutrient_field;
+    nutrients->levels = new unsigned char[(size_t)(*ROWS) * (*COLUMNS)];
+    nutrients->columns = *COLUMNS;
+    memset(nutrients->levels, NUTRIENT_FULL, (size_t)(*ROWS) * (*COLUMNS));
+    return nutrients;
+}
+
+/* nutrients_reset() */
+/* feeds every cell fully again (for runs that reuse a field) */
+void nutrients_reset(struct nutrient_field * nutrients, int * ROWS) {
+    memset(nutrients->levels, NUTRIENT_FULL, (size_t)(*ROWS) * nutrients->columns);
+}
+
+/* nutrient_level() */
+/* returns a pointer to the level of one interior cell */
+static inline unsigned char * nutrient_level(struct nutrient_field * nutrients, int current_row, int current_column) {
+    return &nutrients->levels[(size_t)(current_row - 1) * nutrients->columns + (current_column - 1)];
+}
+
+/* nutrient_spread() */
+/* returns 1 if a draw is below the spread threshold scaled by a cell's level */
+static inline int nutrient_spread(unsigned long prob, unsigned long threshold, unsigned char level) {
+    return prob * NUTRIENT_FULL < threshold * level;  // prob < threshold * level / NUTRIENT_FULL without the division
+}
+
+/* nutrient_step() */
+/* uses up or recovers a cell's level for one time step, given its state at that step */
+static inline void nutrient_step(unsigned char * level, int state) {
+    if (state >= YOUNG && state <= OLDER) {  // hyphae feed
+        *level = (*level > NUTRIENT_CONSUMED) ? (*level - NUTRIENT_CONSUMED) : 0;
+    } else if (state != INERT) {  // everything else recovers
+        *level = (*level < NUTRIENT_FULL - NUTRIENT_RECOVERY) ? (*level + NUTRIENT_RECOVERY) : NUTRIENT_FULL;
+    }
+}
+
+/* nutrients_destroy() */
+/* frees a nutrient field (does nothing if there is none) */
+void nutrients_destroy(struct nutrient_field * nutrients) {
+    if (nutrients == NULL) { return; }
+    delete [] nutrients->levels;
+    delete nutrients;
+}
+
+#endif
@@ -0,0 +1,317 @@
+/*******************************************************************************************
+ * fungi_profile.h
+ *******************************************************************************************
+ *
+ * opt-in instrumentation that breaks each time step of mushrooms() into phases and times every
+ * phase on every thread, summarized on stderr at exit
+ *
+ * build with -DPROFILE to time the phases; each thread's time in a parallel phase is split into
+ * busy time (its share of the loop) and wait time (at the barrier for the other threads), so load
+ * imbalance and synchronization cost show up directly
+ *
+ * build with -DPROFILE -DCOUNTERS to also read the cycles, instructions, cache misses, and branch
+ * misses of each thread's busy time through perf_event_open (if the kernel does not allow it, a
+ * warning is printed and only the times are reported)
+ *
+ * the same hooks also feed the timeline tracer in fungi_trace.h (-DTRACE); with neither PROFILE
+ * nor TRACE every hook compiles to nothing
+ *
+*/
+
+#ifndef FUNGI_PROFILE_H
+#define FUNGI_PROFILE_H
+
+// phases of a time step
+#define PHASE_GHOST_ROWS 0     // copying the ghost rows
+#define PHASE_GHOST_COLUMNS 1  // copying the ghost columns
+#define PHASE_UPDATE 2         // determining the next grid
+#define PHASE_COPY 3           // copying the next grid onto the current grid
+#define PHASE_OUTPUT 4         // DEBUG prints and analysis reports
+#define PHASES 5
+
+#include "fungi_trace.h"
+
+#ifdef PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+#ifdef COUNTERS
+    #include <unistd.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+#endif
+
+// hardware counters read per thread
+#define COUNTER_CYCLES 0
+#define COUNTER_INSTRUCTIONS 1
+#define COUNTER_CACHE_MISSES 2
+#define COUNTER_BRANCH_MISSES 3
+#define COUNTERS_READ 4
+
+// one thread's measurements, padded so threads don't share cache lines
+struct profile_slot {
+    double busy[PHASES];  // seconds spent working in each phase
+    double wait[PHASES];  // seconds spent waiting at each phase's barrier
+    long calls[PHASES];  // number of times each phase ran
+    long long counts[PHASES][COUNTERS_READ];  // hardware counts during each phase's busy time
+    double started;  // when the current phase started
+    double finished;  // when the current phase's work finished
+    long long start_counts[COUNTERS_READ];  // hardware counts when the current phase started
+    int counter_fd;  // perf event group leader (-1 if counters are unavailable)
+    char padding[64];
+};
+
+// all threads' measurements
+struct profile_slot * profile_slots = NULL;
+int profile_threads = 0;
+
+const char * profile_phase_names[PHASES] = { "ghost rows", "ghost columns", "update", "copy", "output" };
+
+/* profile_thread() */
+/* returns the calling thread's slot index */
+static inline int profile_thread() {
+    #ifdef _OPENMP
+        return omp_get_thread_num();
+    #else
+        return 0;
+    #endif
+}
+
+/* profile_now() */
+/* returns the current monotonic time in seconds */
+static inline double profile_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+}
+
+#ifdef COUNTERS
+/* profile_open_counters() */
+/* opens the calling thread's hardware counters as one perf event group; returns the group leader or -1 */
+int profile_open_counters() {
+    static const unsigned long long events[COUNTERS_READ] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+    int leader = -1;
+    for (int counter = 0; counter < COUNTERS_READ; counter++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = events[counter];
+        attr.disabled = (counter == 0);  // the whole group starts with its leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);  // this thread, any cpu
+        if (fd < 0) {
+            if (leader >= 0) { close(leader); }
+            return -1;
+        }
+        if (leader < 0) { leader = fd; }
+    }
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return leader;
+}
+
+/* profile_read_counters() */
+/* reads all of a thread's counters with one system call */
+static inline void profile_read_counters(int fd, long long * counts) {
+    long long group[1 + COUNTERS_READ];  // number of counters, then each count
+    if (fd < 0 || read(fd, group, sizeof(group)) != (ssize_t)sizeof(group)) { return; }
+    for (int counter = 0; counter < COUNTERS_READ; counter++) { counts[counter] = group[1 + counter]; }
+}
+#endif
+
+/* profile_init() */
+/* allocates a slot per thread and, with COUNTERS, opens every thread's hardware counters */
+void profile_init() {
+    profile_threads = 1;
+    #ifdef _OPENMP
+        profile_threads = omp_get_max_threads();
+    #endif
+    profile_slots = new struct profile_slot[profile_threads];
+    memset(profile_slots, 0, sizeof(struct profile_slot) * profile_threads);
+    for (int thread = 0; thread < profile_threads; thread++) { profile_slots[thread].counter_fd = -1; }
+
+    #ifdef COUNTERS
+        // counters count the thread that opens them, so each thread opens its own
+        int unavailable = 0;
+        #pragma omp parallel num_threads(profile_threads) reduction(+:unavailable)
+        {
+            profile_slots[profile_thread()].counter_fd = profile_open_counters();
+            if (profile_slots[profile_thread()].counter_fd < 0) { unavailable++; }
+        }
+        if (unavailable > 0) {
+            fprintf(stderr, "profile: hardware counters unavailable on %d of %d threads (check /proc/sys/kernel/perf_event_paranoid)\n", unavailable, profile_threads);
+        }
+    #endif
+}
+
+/* profile_begin() */
+/* marks the start of the calling thread's work in a phase */
+static inline void profile_begin(int phase) {
+    struct profile_slot * slot = &profile_slots[profile_thread()];
+    #ifdef COUNTERS
+        profile_read_counters(slot->counter_fd, slot->start_counts);
+    #endif
+    slot->started = profile_now();
+    (void)phase;
+}
+
+/* profile_work_done() */
+/* marks the end of the calling thread's work in a phase (before it waits for the other threads) */
+static inline void profile_work_done(int phase) {
+    struct profile_slot * slot = &profile_slots[profile_thread()];
+    slot->finished = profile_now();
+    slot->busy[phase] += slot->finished - slot->started;
+    slot->calls[phase]++;
+    #ifdef COUNTERS
+        long long counts[COUNTERS_READ];
+        memcpy(counts, slot->start_counts, sizeof(counts));
+        profile_read_counters(slot->counter_fd, counts);
+        for (int counter = 0; counter < COUNTERS_READ; counter++) { slot->counts[phase][counter] += counts[counter] - slot->start_counts[counter]; }
+    #endif
+}
+
+/* profile_end() */
+/* marks the end of the calling thread's wait at a phase's barrier */
+static inline void profile_end(int phase) {
+    struct profile_slot * slot = &profile_slots[profile_thread()];
+    slot->wait[phase] += profile_now() - slot->finished;
+}
+
+/* profile_report() */
+/* prints each phase's time, imbalance, and counters to stderr */
+void profile_report() {
+    fprintf(stderr, "\nprofile (%d threads):\n", profile_threads);
+    fprintf(stderr, "%-14s %8s %12s %12s %12s %10s %8s", "phase", "calls", "wall (s)", "mean busy", "max busy", "imbalance", "wait %");
+    #ifdef COUNTERS
+        fprintf(stderr, " %8s %14s %14s", "IPC", "cache miss/ki", "branch miss/ki");
+    #endif
+    fprintf(stderr, "\n");
+
+    for (int phase = 0; phase < PHASES; phase++) {
+        double busy_sum = 0, busy_max = 0, wait_sum = 0, wall = 0;
+        long calls = 0;
+        long long counts[COUNTERS_READ] = { 0 };
+        int active = 0;  // threads that took part in the phase
+        for (int thread = 0; thread < profile_threads; thread++) {
+            struct profile_slot * slot = &profile_slots[thread];
+            if (slot->calls[phase] == 0) { continue; }
+            active++;
+            busy_sum += slot->busy[phase];
+            wait_sum += slot->wait[phase];
+            if (slot->busy[phase] > busy_max) { busy_max = slot->busy[phase]; }
+            if (slot->busy[phase] + slot->wait[phase] > wall) { wall = slot->busy[phase] + slot->wait[phase]; }
+            if (slot->calls[phase] > calls) { calls = slot->calls[phase]; }
+            for (int counter = 0; counter < COUNTERS_READ; counter++) { counts[counter] += slot->counts[phase][counter]; }
+        }
+        if (active == 0) { continue; }
+        double busy_mean = busy_sum / active;
+        fprintf(stderr, "%-14s %8ld %12.6f %12.6f %12.6f %10.2f %7.1f%%", profile_phase_names[phase], calls, wall, busy_mean, busy_max,
+                (busy_mean > 0) ? busy_max / busy_mean : 1.0, (busy_sum + wait_sum > 0) ? 100.0 * wait_sum / (busy_sum + wait_sum) : 0.0);
+        #ifdef COUNTERS
+            double kilo_instructions = counts[COUNTER_INSTRUCTIONS] / 1000.0;
+            if (counts[COUNTER_CYCLES] > 0) {
+                fprintf(stderr, " %8.2f %14.2f %14.2f", (double)counts[COUNTER_INSTRUCTIONS] / counts[COUNTER_CYCLES],
+                        counts[COUNTER_CACHE_MISSES] / kilo_instructions, counts[COUNTER_BRANCH_MISSES] / kilo_instructions);
+            } else {
+                fprintf(stderr, " %8s %14s %14s", "-", "-", "-");  // counters were unavailable
+            }
+        #endif
+        fprintf(stderr, "\n");
+    }
+
+    #ifdef COUNTERS
+        for (int thread = 0; thread < profile_threads; thread++) {
+            if (profile_slots[thread].counter_fd >= 0) { close(profile_slots[thread].counter_fd); }
+        }
+    #endif
+    delete [] profile_slots;
+}
+
+#endif
+
+/* PHASE HOOKS */
+// the engines call these around every phase; they feed the profiler (PROFILE) and the
+// timeline tracer (TRACE, see fungi_trace.h), and compile to nothing when neither is enabled
+#if defined(PROFILE) || defined(TRACE)
+
+/* phase_init() */
+/* sets up whichever of the profiler and tracer are enabled */
+void phase_init() {
+    #ifdef PROFILE
+        profile_init();
+    #endif
+    #ifdef TRACE
+        trace_init();
+    #endif
+}
+
+/* phase_begin() */
+/* marks the start of the calling thread's work in a phase */
+static inline void phase_begin(int phase) {
+    #ifdef PROFILE
+        profile_begin(phase);
+    #endif
+    #ifdef TRACE
+        trace_begin(phase);
+    #endif
+}
+
+/* phase_work_done() */
+/* marks the end of the calling thread's work in a phase */
+static inline void phase_work_done(int phase) {
+    #ifdef PROFILE
+        profile_work_done(phase);
+    #endif
+    #ifdef TRACE
+        trace_work_done(phase);
+    #endif
+}
+
+/* phase_end() */
+/* marks the end of the calling thread's wait at a phase's barrier */
+static inline void phase_end(int phase) {
+    #ifdef PROFILE
+        profile_end(phase);
+    #endif
+    #ifdef TRACE
+        trace_end(phase);
+    #endif
+}
+
+/* phase_report() */
+/* prints the profile and writes the trace */
+void phase_report() {
+    #ifdef PROFILE
+        profile_report();
+    #endif
+    #ifdef TRACE
+        trace_write();
+    #endif
+}
+
+#define PROFILE_INIT() phase_init()
+#define PROFILE_BEGIN(phase) phase_begin(phase)
+#define PROFILE_WORK_DONE(phase) phase_work_done(phase)
+#define PROFILE_END(phase) phase_end(phase)
+#define PROFILE_DONE(phase) phase_work_done(phase)  // for phases with no barrier (nothing to wait for)
+#define PROFILE_REPORT() phase_report()
+
+#else
+
+#define PROFILE_INIT()
+#define PROFILE_BEGIN(phase)
+#define PROFILE_WORK_DONE(phase)
+#define PROFILE_END(phase)
+#define PROFILE_DONE(phase)
+#define PROFILE_REPORT()
+
+#endif
+
+#endif
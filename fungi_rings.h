@@ -0,0 +1,350 @@
+/*******************************************************************************************
+ * fungi_rings.h
+ *******************************************************************************************
+ *
+ * tracks the geometry of each fairy ring as the simulation runs: where its growth front is
+ * centered, how big the ring is, and how fast it is expanding
+ *
+ * a colony is born whenever a SPORE becomes YOUNG, and a cell that becomes YOUNG by spreading
+ * joins the colony of the YOUNG neighbor it grew from; since YOUNG only lasts one time step,
+ * the cells that become YOUNG in a step are exactly that step's growth front; colonies are numbered in
+ * the order they are born, and those born in the same time step by row and then column, so the
+ * numbers (and the reports) are the same in either engine and at any thread count
+ *
+ * nothing here rescans the grid: mushrooms() hands over each front cell as it writes it, the
+ * cells are folded into per-colony sums, and a circle is fit to each colony's front from those
+ * sums (the algebraic least-squares "Kasa" fit), with the ring's expansion rate being the
+ * least-squares slope of its radius over time
+ *
+ * hyphae already on the initial grid (from a state raster, -m states:) never had a SPORE to be born
+ * from, so rings_found() gives every network of them (fungi_networks.h) a colony of its own, born at
+ * time step 0 in the middle of the network's bounding box, and numbered before any born later
+ *
+ * must be included after the cell states are defined and after fungi_networks.h
+ *
+*/
+
+#ifndef FUNGI_RINGS_H
+#define FUNGI_RINGS_H
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+// number of colonies listed individually in each report (largest radius first)
+#define RING_REPORT_LIMIT 10
+
+// colony id of a cell that has never been YOUNG
+#define NO_COLONY -1
+
+// one front cell handed over by mushrooms()
+struct ring_sample {
+    int colony;  // colony the cell belongs to
+    int row, column;  // where the cell is
+};
+
+// geometry of one colony
+struct colony {
+    int origin_row, origin_column;  // spore the colony grew from
+    int birth_step;  // time step the colony's first YOUNG cell appeared
+
+    // sums over this step's front cells, relative to the origin (reset every step)
+    long front;  // number of front cells
+    double sx, sy, sxx, syy, sxy, sxr, syr;  // x, y, x^2, y^2, xy, x(x^2+y^2), y(x^2+y^2) summed
+
+    // latest fit
+    long last_front;  // number of front cells at the latest fit
+    int last_step;  // time step of the latest fit
+    double center_row, center_column;  // center of the fitted ring
+    double radius;  // radius of the fitted ring
+
+    // radius over time, for the expansion rate
+    long fits;  // number of fits so far
+    double st, sr, stt, str;  // t, r, t^2, tr summed
+};
+
+// per-thread list of front cells, padded so threads don't share cache lines
+struct ring_buffer {
+    std::vector<struct ring_sample> samples;  // front cells found by this thread this step
+    std::vector<struct ring_sample> births;  // colonies born in this thread this step (numbered once the step is over)
+    char padding[64];
+};
+
+// everything the ring tracker needs between time steps
+struct ring_tracker {
+    int rows, columns;  // grid size (not counting ghosts)
+    int report_interval;  // print a report every this many time steps
+    int * colony_ids;  // colony of every cell's latest YOUNG phase
+    int colony_count;  // number of colonies born so far
+    std::vector<struct colony> colonies;  // geometry of every colony
+    std::vector<struct ring_buffer> buffers;  // one front list per thread
+};
+
+/* rings_thread() */
+/* returns the calling thread's buffer index */
+static inline int rings_thread() {
+    #ifdef _OPENMP
+        return omp_get_thread_num();
+    #else
+        return 0;
+    #endif
+}
+
+/* rings_create() */
+/* allocates a ring tracker for a ROWS x COLUMNS grid that reports every report_interval time steps */
+struct ring_tracker * rings_create(int * ROWS, int * COLUMNS, int report_interval) {
+    struct ring_tracker * rings = new struct ring_tracker;
+    rings->rows = (*ROWS);
+    rings->columns = (*COLUMNS);
+    rings->report_interval = report_interval;
+    rings->colony_ids = new int[(long)(*ROWS) * (*COLUMNS)];
+    rings->colony_count = 0;
+    int threads = 1;
+    #ifdef _OPENMP
+        threads = omp_get_max_threads();
+    #endif
+    rings->buffers.resize(threads);
+
+    #pragma omp parallel for
+    for (int current_row = 0; current_row < (*ROWS); current_row++) {  // for each row of ids...
+        for (int current_column = 0; current_column < (*COLUMNS); current_column++) {
+            rings->colony_ids[(long)current_row * (*COLUMNS) + current_column] = NO_COLONY;  // ...no cell belongs to a colony yet
+        }
+    }
+    return rings;
+}
+
+/* rings_found() */
+/* gives every network of live hyphae on the initial grid a colony, so the YOUNG cells among them have a colony for the cells they spread to to join; does nothing on a grid without hyphae */
+void rings_found(struct ring_tracker * rings, int ***grid) {
+    int live = 0;  // 1 if the grid holds any live hyphae
+    #pragma omp parallel for reduction(|:live)
+    for (int current_row = 1; current_row <= rings->rows; current_row++) {  // for each row in the grid...
+        for (int current_column = 1; current_column <= rings->columns; current_column++) { live |= IS_LIVE((*grid)[current_row][current_column]); }
+    }
+    if (!live) { return; }
+
+    struct network_labels * labels = network_labels_create(grid, &rings->rows, &rings->columns);
+    rings->colonies.resize(labels->count);
+    for (long id = 0; id < labels->count; id++) {  // each network's colony starts in the middle of its bounding box (which may wrap)
+        struct network * n = &labels->networks[id];
+        struct colony * c = &rings->colonies[id];
+        memset(c, 0, sizeof(struct colony));
+        c->origin_row = (n->min_row - 1 + ((n->max_row - n->min_row + rings->rows) % rings->rows) / 2) % rings->rows + 1;
+        c->origin_column = (n->min_column - 1 + ((n->max_column - n->min_column + rings->columns) % rings->columns) / 2) % rings->columns + 1;
+        c->last_step = -1;
+    }
+    rings->colony_count = (int)labels->count;
+
+    #pragma omp parallel for
+    for (int current_row = 1; current_row <= rings->rows; current_row++) {  // for each row in the grid...
+        for (int current_column = 1; current_column <= rings->columns; current_column++) {
+            long id = network_label(labels, current_row, current_column);
+            if (id != NOT_LIVE) { rings->colony_ids[(long)(current_row - 1) * rings->columns + (current_column - 1)] = (int)id; }
+        }
+    }
+    network_labels_destroy(labels);
+}
+
+/* rings_destroy() */
+/* deallocates a ring tracker */
+void rings_destroy(struct ring_tracker * rings) {
+    if (rings == NULL) { return; }
+    delete [] rings->colony_ids;
+    delete rings;
+}
+
+/* rings_birth() */
+/* called by mushrooms() when the SPORE at (row, column) becomes YOUNG; starts a new colony there (its id is given by rings_end_step(), since no cell reads it before the next time step) */
+static inline void rings_birth(struct ring_tracker * rings, int current_row, int current_column) {
+    struct ring_sample sample = { NO_COLONY, current_row, current_column };
+    rings->buffers[rings_thread()].births.push_back(sample);
+}
+
+/* rings_spread() */
+/* called by mushrooms() when the EMPTY at (row, column) becomes YOUNG; the cell joins the colony of its first YOUNG neighbor that has one (and stays out of every colony if none does) */
+static inline void rings_spread(struct ring_tracker * rings, int ***current_grid, int current_row, int current_column) {
+    for (int neighbor_row = current_row - 1; neighbor_row <= current_row + 1; neighbor_row++) {  // for each row in the 3x3 sub-grid...
+        for (int neighbor_column = current_column - 1; neighbor_column <= current_column + 1; neighbor_column++) {  // for each cell in that row...
+            if ((*current_grid)[neighbor_row][neighbor_column] != YOUNG) { continue; }
+
+            // ghost cells hold copies of the far edge, so wrap the neighbor back into the grid to find its id
+            int wrapped_row = (neighbor_row == 0) ? rings->rows : (neighbor_row == rings->rows + 1) ? 1 : neighbor_row;
+            int wrapped_column = (neighbor_column == 0) ? rings->columns : (neighbor_column == rings->columns + 1) ? 1 : neighbor_column;
+            int id = rings->colony_ids[(long)(wrapped_row - 1) * rings->columns + (wrapped_column - 1)];
+            if (id == NO_COLONY) { continue; }  // (YOUNG without ever joining a colony, e.g. straight from a state raster)
+            struct ring_sample sample = { id, current_row, current_column };
+            rings->colony_ids[(long)(current_row - 1) * rings->columns + (current_column - 1)] = id;
+            rings->buffers[rings_thread()].samples.push_back(sample);
+            return;
+        }
+    }
+    rings->colony_ids[(long)(current_row - 1) * rings->columns + (current_column - 1)] = NO_COLONY;  // (no neighbor had a colony to join)
+}
+
+/* rings_offset() */
+/* returns the shortest signed distance from origin to position on a wrapped axis of the given length */
+static inline int rings_offset(int position, int origin, int length) {
+    int offset = position - origin;
+    if (offset > length / 2) { offset -= length; }
+    if (offset < -((length - 1) / 2)) { offset += length; }
+    return offset;
+}
+
+/* rings_fit() */
+/* fits a circle to a colony's front from its sums and folds the radius into its expansion history */
+void rings_fit(struct ring_tracker * rings, struct colony * c, int time_step) {
+    double n = (double)c->front;
+    double mean_x = c->sx / n;
+    double mean_y = c->sy / n;
+    double center_x = mean_x, center_y = mean_y;
+    double radius;
+
+    // least-squares circle x^2 + y^2 + Dx + Ey + F = 0: solve the 3x3 normal equations by Cramer's rule
+    double a11 = c->sxx, a12 = c->sxy, a13 = c->sx;
+    double a22 = c->syy, a23 = c->sy, a33 = n;
+    double b1 = -c->sxr, b2 = -c->syr, b3 = -(c->sxx + c->syy);
+    double det = a11 * (a22 * a33 - a23 * a23) - a12 * (a12 * a33 - a23 * a13) + a13 * (a12 * a23 - a22 * a13);
+    if (c->front >= 3 && fabs(det) > 1e-9 * n * n * n) {
+        double D = (b1 * (a22 * a33 - a23 * a23) - a12 * (b2 * a33 - a23 * b3) + a13 * (b2 * a23 - a22 * b3)) / det;
+        double E = (a11 * (b2 * a33 - b3 * a23) - b1 * (a12 * a33 - a23 * a13) + a13 * (a12 * b3 - b2 * a13)) / det;
+        double F = (a11 * (a22 * b3 - a23 * b2) - a12 * (a12 * b3 - b2 * a13) + b1 * (a12 * a23 - a22 * a13)) / det;
+        center_x = -D / 2;
+        center_y = -E / 2;
+        radius = sqrt(fmax(center_x * center_x + center_y * center_y - F, 0.0));
+    } else {
+        // too few cells or all in a line: use the RMS distance from the centroid instead
+        radius = sqrt(fmax((c->sxx + c->syy) / n - mean_x * mean_x - mean_y * mean_y, 0.0));
+    }
+
+    // store the fit in grid coordinates (wrapped back into the grid)
+    c->center_row = fmod(c->origin_row - 1 + center_y + 2.0 * rings->rows, (double)rings->rows) + 1;
+    c->center_column = fmod(c->origin_column - 1 + center_x + 2.0 * rings->columns, (double)rings->columns) + 1;
+    c->radius = radius;
+    c->last_front = c->front;
+    c->last_step = time_step;
+
+    // fold into the radius history
+    c->fits++;
+    c->st += time_step;
+    c->sr += radius;
+    c->stt += (double)time_step * time_step;
+    c->str += (double)time_step * radius;
+}
+
+/* rings_expansion() */
+/* returns a colony's expansion rate in cells per time step (slope of its radius over time) */
+static inline double rings_expansion(struct colony * c) {
+    double denominator = c->fits * c->stt - c->st * c->st;
+    if (c->fits < 2 || denominator == 0) { return 0.0; }
+    return (c->fits * c->str - c->st * c->sr) / denominator;
+}
+
+/* rings_report() */
+/* prints the active colonies' geometry to stderr */
+void rings_report(struct ring_tracker * rings, int time_step) {
+    std::vector<int> active;  // colonies with a front this step
+    double radius_sum = 0, expansion_sum = 0;
+    for (int id = 0; id < (int)rings->colonies.size(); id++) {
+        if (rings->colonies[id].last_step == time_step) {
+            active.push_back(id);
+            radius_sum += rings->colonies[id].radius;
+            expansion_sum += rings_expansion(&rings->colonies[id]);
+        }
+    }
+    long listed = std::min((long)active.size(), (long)RING_REPORT_LIMIT);
+    std::partial_sort(active.begin(), active.begin() + listed, active.end(), [rings](int a, int b) {
+        return (rings->colonies[a].radius != rings->colonies[b].radius) ? rings->colonies[a].radius > rings->colonies[b].radius : a < b;  // (ties by id)
+    });
+
+    fprintf(stderr, "rings at time step %d: %ld growing colonies (of %d), mean radius %.2f, mean expansion %.3f cells/step\n", time_step,
+            (long)active.size(), rings->colony_count, active.empty() ? 0.0 : radius_sum / active.size(), active.empty() ? 0.0 : expansion_sum / active.size());
+    for (long i = 0; i < listed; i++) {
+        struct colony * c = &rings->colonies[active[i]];
+        fprintf(stderr, "    colony %d: born step %d at (%d, %d), center (%.1f, %.1f), radius %.2f, front %ld cells, expansion %.3f cells/step\n", active[i],
+                c->birth_step, c->origin_row, c->origin_column, c->center_row, c->center_column, c->radius, c->last_front, rings_expansion(c));
+    }
+}
+
+/* rings_end_step() */
+/* called by mushrooms() once the next grid is complete; fits every colony that grew a front, and reports if it is time */
+void rings_end_step(struct ring_tracker * rings, int time_step, int last_step) {
+
+    // number the colonies born this step by where they were born, whichever thread found them, and record their origins
+    std::vector<struct ring_sample> births;
+    for (int thread = 0; thread < (int)rings->buffers.size(); thread++) {
+        births.insert(births.end(), rings->buffers[thread].births.begin(), rings->buffers[thread].births.end());
+        rings->buffers[thread].births.clear();
+    }
+    std::sort(births.begin(), births.end(), [](const struct ring_sample & a, const struct ring_sample & b) { return (a.row != b.row) ? a.row < b.row : a.column < b.column; });
+    rings->colonies.resize(rings->colony_count + births.size());
+    for (struct ring_sample & birth : births) {
+        int id = rings->colony_count++;
+        struct colony * c = &rings->colonies[id];
+        memset(c, 0, sizeof(struct colony));
+        c->origin_row = birth.row;
+        c->origin_column = birth.column;
+        c->birth_step = time_step;
+        c->last_step = -1;
+        c->front = 1;  // (the birth cell is the first of its front, at the origin, so it adds nothing to the other sums)
+        rings->colony_ids[(long)(birth.row - 1) * rings->columns + (birth.column - 1)] = id;
+    }
+
+    // fold each thread's front cells into the colonies, one run of same-colony cells at a time to keep atomics rare
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int thread = 0; thread < (int)rings->buffers.size(); thread++) {
+        std::vector<struct ring_sample> & samples = rings->buffers[thread].samples;
+        size_t i = 0;
+        while (i < samples.size()) {
+            int id = samples[i].colony;
+            struct colony * c = &rings->colonies[id];
+            long front = 0;
+            double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0, sxr = 0, syr = 0;
+            for (; i < samples.size() && samples[i].colony == id; i++) {
+                double x = rings_offset(samples[i].column, c->origin_column, rings->columns);
+                double y = rings_offset(samples[i].row, c->origin_row, rings->rows);
+                double r2 = x * x + y * y;
+                front++;
+                sx += x; sy += y; sxx += x * x; syy += y * y; sxy += x * y;
+                sxr += x * r2; syr += y * r2;
+            }
+            #pragma omp atomic
+            c->front += front;
+            #pragma omp atomic
+            c->sx += sx;
+            #pragma omp atomic
+            c->sy += sy;
+            #pragma omp atomic
+            c->sxx += sxx;
+            #pragma omp atomic
+            c->syy += syy;
+            #pragma omp atomic
+            c->sxy += sxy;
+            #pragma omp atomic
+            c->sxr += sxr;
+            #pragma omp atomic
+            c->syr += syr;
+        }
+        samples.clear();
+    }
+
+    // fit every colony that grew this step and reset its sums for the next one
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int id = 0; id < (int)rings->colonies.size(); id++) {
+        struct colony * c = &rings->colonies[id];
+        if (c->front == 0) { continue; }
+        rings_fit(rings, c, time_step);
+        c->front = 0;
+        c->sx = c->sy = c->sxx = c->syy = c->sxy = c->sxr = c->syr = 0;
+    }
+
+    if (time_step % rings->report_interval == 0 || time_step == last_step) {
+        rings_report(rings, time_step);
+    }
+}
+
+#endif
@@ -0,0 +1,189 @@
+/*******************************************************************************************
+ * fungi_rules.h
+ *******************************************************************************************
+ *
+ * the probabilities of the state transitions, settable at runtime with -f (a config file) and
+ * -p (a comma-separated list), without giving up a specialized update kernel
+ *
+ * every probability p is turned into an integer threshold once, up front: a transition happens
+ * when a raw yarn2 draw (an integer from 0 to DRAW_RANGE - 1) is below p * DRAW_RANGE, so the
+ * kernel compares integers and never converts a draw to a double; each decision takes exactly
+ * one draw, which is what the per-row blocks of fungi_streams.h budget for
+ *
+ * the update kernels are templates over the rule set: default_rules holds the thresholds of the
+ * built-in probabilities as compile-time constants, which the compiler folds into the kernel,
+ * and runtime_rules holds thresholds computed from the command line; the engines run the
+ * default_rules instantiation whenever the parameters are the built-in ones, so a run that sets
+ * no parameters (or sets them to their defaults) costs exactly what it did before; another common
+ * parameter set can be given its own instantiation the same way
+ *
+ * initializeGrid() does not draw per cell: spores are rare, so spore_row() fills a row with EMPTY
+ * and then jumps from one SPORE to the next by drawing the gap between them from the geometric
+ * distribution (the number of failures before a success with probability probSpore), which gives
+ * every cell the same independent probSpore chance as a draw per cell would at the cost of about
+ * one draw per spore; a row never takes more than COLUMNS draws, so it stays in its block
+ *
+ * parameter names are the names of the constants (probSpore, probSporeToYoung, probSpread,
+ * probMaturingToMushrooms, probDepletedToSpore, probDepletedToEmpty); config files hold one
+ * "name = value" per line, and lines starting with # are comments
+ *
+ * must be included after the probabilities are defined
+ *
+*/
+
+#ifndef FUNGI_RULES_H
+#define FUNGI_RULES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// yarn2 draws are integers from 0 to 2^31 - 2 (its modulus is 2^31 - 1)
+#define DRAW_RANGE 2147483647.0
+
+// threshold a draw must be below for a transition of probability p to happen
+#define RULE_THRESHOLD(p) ((unsigned long)((p) * DRAW_RANGE + 0.5))
+
+// parameters, in the order of rule_names
+#define RULE_SPORE 0
+#define RULE_SPORE_TO_YOUNG 1
+#define RULE_SPREAD 2
+#define RULE_MATURING_TO_MUSHROOMS 3
+#define RULE_DEPLETED_TO_SPORE 4
+#define RULE_DEPLETED_TO_EMPTY 5
+#define RULE_COUNT 6
+
+const char * rule_names[] = { "probSpore", "probSporeToYoung", "probSpread", "probMaturingToMushrooms", "probDepletedToSpore", "probDepletedToEmpty" };
+const double rule_defaults[] = { probSpore, probSporeToYoung, probSpread, probMaturingToMushrooms, probDepletedToSpore, probDepletedToEmpty };
+
+// the built-in probabilities, as thresholds known at compile time
+struct default_rules {
+    static constexpr unsigned long spore_to_young = RULE_THRESHOLD(probSporeToYoung);
+    static constexpr unsigned long spread = RULE_THRESHOLD(probSpread);
+    static constexpr unsigned long maturing_to_mushrooms = RULE_THRESHOLD(probMaturingToMushrooms);
+    static constexpr unsigned long depleted_to_spore = RULE_THRESHOLD(probDepletedToSpore);
+    static constexpr unsigned long depleted_to_empty = RULE_THRESHOLD(probDepletedToEmpty);
+};
+const struct default_rules built_in_rules = {};  // passed to the kernels to pick the default_rules instantiation
+
+// probabilities given at runtime, and their thresholds
+struct runtime_rules {
+    double probabilities[RULE_COUNT];  // indexed by RULE_*
+    unsigned long spore_to_young;
+    unsigned long spread;
+    unsigned long maturing_to_mushrooms;
+    unsigned long depleted_to_spore;
+    unsigned long depleted_to_empty;
+    double spore_gap_scale;  // 1 / log(1 - probSpore), to turn a uniform draw into a geometric gap
+    int is_default;  // 1 if every probability is the built-in one (so default_rules can be used)
+};
+
+/* draw() */
+/* returns the next raw draw of an engine, to compare with a threshold */
+static inline unsigned long draw(trng::yarn2 * yarn) {
+    return (unsigned long)(*yarn)();
+}
+
+/* rules_default() */
+/* sets every probability to its built-in value */
+void rules_default(struct runtime_rules * rules) {
+    for (int rule = 0; rule < RULE_COUNT; rule++) {
+        rules->probabilities[rule] = rule_defaults[rule];
+    }
+}
+
+/* rules_set() */
+/* sets one probability by name; exits with a usage message if the name or value is invalid */
+void rules_set(struct runtime_rules * rules, const char * name, double value, const char * program) {
+    for (int rule = 0; rule < RULE_COUNT; rule++) {
+        if (strcmp(name, rule_names[rule]) == 0) {
+            if (value < 0.0 || value > 1.0) {
+                fprintf(stderr, "Usage: %s -p %s must be a probability between 0 and 1\n", program, name);
+                exit(EXIT_FAILURE);
+            }
+            rules->probabilities[rule] = value;
+            return;
+        }
+    }
+    fprintf(stderr, "Usage: %s -p unknown parameter %s (known: probSpore, probSporeToYoung, probSpread, probMaturingToMushrooms, probDepletedToSpore, probDepletedToEmpty)\n", program, name);
+    exit(EXIT_FAILURE);
+}
+
+/* rules_parse() */
+/* sets the probabilities in a comma-separated list of name=value pairs */
+void rules_parse(struct runtime_rules * rules, char * list, const char * program) {
+    for (char *pair = strtok(list, ","); pair != NULL; pair = strtok(NULL, ",")) {  // for each name=value pair...
+        char *equals = strchr(pair, '=');
+        if (equals == NULL) {
+            fprintf(stderr, "Usage: %s -p parameters must be comma-separated name=value pairs\n", program);
+            exit(EXIT_FAILURE);
+        }
+        *equals = '\0';
+        rules_set(rules, pair, atof(equals + 1), program);
+    }
+}
+
+/* rules_load() */
+/* sets the probabilities listed in a config file, one "name = value" per line */
+void rules_load(struct runtime_rules * rules, const char * path, const char * program) {
+    FILE *file = fopen(path, "r");
+    char line[256], name[64];
+    double value;
+    if (file == NULL) {
+        fprintf(stderr, "Usage: %s -f could not open parameter file %s\n", program, path);
+        exit(EXIT_FAILURE);
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {  // for each line...
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') { continue; }  // ...skip comments and blank lines
+        if (sscanf(start, "%63[^= \t] = %lf", name, &value) != 2) {
+            fprintf(stderr, "Usage: %s -f lines of %s must be \"name = value\": %s", program, path, line);
+            exit(EXIT_FAILURE);
+        }
+        rules_set(rules, name, value, program);
+    }
+    fclose(file);
+}
+
+/* rules_finish() */
+/* checks the probabilities together and computes their thresholds */
+void rules_finish(struct runtime_rules * rules, const char * program) {
+    double *probabilities = rules->probabilities;
+    if (probabilities[RULE_DEPLETED_TO_SPORE] > probabilities[RULE_DEPLETED_TO_EMPTY]) {  // the DEPLETED thresholds are cumulative
+        fprintf(stderr, "Usage: %s -p probDepletedToSpore cannot be greater than probDepletedToEmpty\n", program);
+        exit(EXIT_FAILURE);
+    }
+    rules->spore_to_young = RULE_THRESHOLD(probabilities[RULE_SPORE_TO_YOUNG]);
+    rules->spread = RULE_THRESHOLD(probabilities[RULE_SPREAD]);
+    rules->maturing_to_mushrooms = RULE_THRESHOLD(probabilities[RULE_MATURING_TO_MUSHROOMS]);
+    rules->depleted_to_spore = RULE_THRESHOLD(probabilities[RULE_DEPLETED_TO_SPORE]);
+    rules->depleted_to_empty = RULE_THRESHOLD(probabilities[RULE_DEPLETED_TO_EMPTY]);
+    rules->spore_gap_scale = (probabilities[RULE_SPORE] > 0.0 && probabilities[RULE_SPORE] < 1.0) ? 1.0 / log1p(-probabilities[RULE_SPORE]) : 0.0;
+    rules->is_default = 1;
+    for (int rule = 0; rule < RULE_COUNT; rule++) {
+        if (probabilities[rule] != rule_defaults[rule]) { rules->is_default = 0; }
+    }
+}
+
+/* spore_row() */
+/* fills the interior of one row with EMPTY and places its SPOREs at geometric gaps, drawing from the row's stream */
+void spore_row(int * row, int * COLUMNS, trng::yarn2 * yarn, struct runtime_rules * rules) {
+    double probability = rules->probabilities[RULE_SPORE];
+    memset(&row[1], 0, sizeof(int) * (*COLUMNS));  // every cell starts EMPTY (which is 0)
+    if (probability <= 0.0) { return; }  // no spores at all
+    if (probability >= 1.0) {  // every cell is a spore
+        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) { row[current_column] = SPORE; }
+        return;
+    }
+    for (long current_column = 0; ; ) {  // the column of the last spore placed (0 before the first)
+        double uniform = (draw(yarn) + 1.0) / DRAW_RANGE;  // in (0, 1], so the log is finite
+        double gap = floor(log(uniform) * rules->spore_gap_scale);  // EMPTY cells before the next spore
+        if (gap >= (double)((*COLUMNS) - current_column)) { return; }  // ...the next spore is past the end of the row
+        current_column += (long)gap + 1;
+        row[current_column] = SPORE;
+        if (current_column == (*COLUMNS)) { return; }  // the row is full, so don't draw again
+    }
+}
+
+#endif
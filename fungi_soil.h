@@ -0,0 +1,104 @@
+/*******************************************************************************************
+ * fungi_soil.h
+ *******************************************************************************************
+ *
+ * spatially varying soil quality for the engines (-q FILE): a raster in the formats of
+ * fungi_terrain.h, one byte per cell, whose value v (out of the raster's maxval) scales that
+ * cell's spread and recovery probabilities by v / maxval
+ *      probSpread becomes probSpread * v / maxval
+ *      probDepletedToEmpty becomes probDepletedToEmpty * v / maxval (but never less than
+ *          probDepletedToSpore, since the DEPLETED thresholds are cumulative)
+ * so a cell at maxval behaves exactly as it would without the map, and a cell at 0 never takes
+ * on hyphae from its neighbors and never recovers
+ *
+ * every possible value gets its own runtime_rules up front (levels), so a cell only picks a rule
+ * set and the kernels run unchanged; the rows are cut into tiles of SOIL_TILE columns, and
+ * soil_open() marks every tile whose cells all hold the same value, so the engines update a
+ * uniform tile as one span with one rule set (the compiled-in default_rules kernel when that set
+ * is the built-in one) and pick a rule set per cell only inside the tiles that vary
+ *
+ * must be included after fungi_rules.h and fungi_terrain.h
+ *
+*/
+
+#ifndef FUNGI_SOIL_H
+#define FUNGI_SOIL_H
+
+#define SOIL_TILE 64     // columns per tile
+#define SOIL_LEVELS 256  // possible cell values
+#define SOIL_VARIED -1   // tile value of a tile whose cells differ
+
+// a mapped soil quality map
+struct soil {
+    struct terrain *raster;  // the mapped values
+    int columns;  // cells per row
+    int tiles_per_row;  // tiles per row (the last one may be narrower)
+    short *tiles;  // value shared by each tile's cells (SOIL_VARIED if they differ), row by row
+    struct runtime_rules levels[SOIL_LEVELS];  // rule set for each cell value
+};
+
+/* soil_open() */
+/* maps a soil quality map, finds its uniform tiles, and derives a rule set for every value; exits with a usage message if the map doesn't fit */
+struct soil * soil_open(const char * path, int * ROWS, int * COLUMNS, struct runtime_rules * rules, const char * program) {
+    struct soil *soil = new struct soil;
+    soil->raster = terrain_open(path, ROWS, COLUMNS, "-q", program);
+    soil->columns = *COLUMNS;
+    soil->tiles_per_row = ((*COLUMNS) + SOIL_TILE - 1) / SOIL_TILE;
+    soil->tiles = new short[(size_t)(*ROWS) * soil->tiles_per_row];
+
+    // rule sets, scaled from the run's probabilities
+    for (int value = 0; value <= soil->raster->maxval; value++) {
+        struct runtime_rules *level = &soil->levels[value];
+        double scale = (double)value / soil->raster->maxval;
+        *level = *rules;
+        if (value < soil->raster->maxval) {  // (the top value keeps the run's probabilities exactly)
+            level->probabilities[RULE_SPREAD] *= scale;
+            level->probabilities[RULE_DEPLETED_TO_EMPTY] = fmax(level->probabilities[RULE_DEPLETED_TO_EMPTY] * scale, level->probabilities[RULE_DEPLETED_TO_SPORE]);
+        }
+        rules_finish(level, program);
+    }
+
+    // uniform tiles
+    int highest = 0;  // largest value in the map
+    #pragma omp parallel for reduction(max:highest)
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
+        const unsigned char *values = soil->raster->cells + (size_t)(current_row - 1) * (*COLUMNS);
+        for (int tile = 0; tile < soil->tiles_per_row; tile++) {  // for each tile in that row...
+            int first = tile * SOIL_TILE, last = (first + SOIL_TILE < (*COLUMNS)) ? first + SOIL_TILE : (*COLUMNS);
+            short value = values[first];
+            for (int current_column = first; current_column < last; current_column++) {
+                if (values[current_column] != values[first]) { value = SOIL_VARIED; }
+                if (values[current_column] > highest) { highest = values[current_column]; }
+            }
+            soil->tiles[(size_t)(current_row - 1) * soil->tiles_per_row + tile] = value;
+        }
+    }
+    if (highest > soil->raster->maxval) {
+        fprintf(stderr, "Usage: %s -q raster %s holds values above its maxval %d\n", program, path, soil->raster->maxval);
+        exit(EXIT_FAILURE);
+    }
+    return soil;
+}
+
+/* soil_tile() */
+/* returns the value shared by the cells of one tile, or SOIL_VARIED */
+static inline int soil_tile(struct soil * soil, int current_row, int tile) {
+    return soil->tiles[(size_t)(current_row - 1) * soil->tiles_per_row + tile];
+}
+
+/* soil_cell() */
+/* returns the rule set of one interior cell */
+static inline struct runtime_rules * soil_cell(struct soil * soil, int current_row, int current_column) {
+    return &soil->levels[soil->raster->cells[(size_t)(current_row - 1) * soil->columns + (current_column - 1)]];
+}
+
+/* soil_close() */
+/* unmaps a soil quality map (does nothing if there is none) */
+void soil_close(struct soil * soil) {
+    if (soil == NULL) { return; }
+    terrain_close(soil->raster);
+    delete [] soil->tiles;
+    delete soil;
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*******************************************************************************************
+ * fungi_sparse.h
+ *******************************************************************************************
+ *
+ * sparse tiled grids for the sequential engine (-z), for large landscapes that are mostly EMPTY:
+ * the grid is cut into tiles of SPARSE_TILE x SPARSE_TILE cells, and only the tiles holding
+ * something other than EMPTY are materialized; an all-EMPTY tile is a NULL entry in the tile
+ * directory, so the memory used follows the colonies rather than the area
+ *
+ * tiles come from a pool shared by the current and next grids: a tile whose cells all become EMPTY
+ * goes back to the pool (threaded through its own first bytes, so the pool needs no bookkeeping of
+ * its own) and is handed out again before anything new is allocated
+ *
+ * the engine updates a tile through a window, a (SPARSE_TILE + 2)-square grid holding the tile and
+ * a ring of its neighbors' cells (with the same periodic wraparound as the dense grid's ghost rows
+ * and columns), so the dense kernels run on it unchanged; an EMPTY tile with no YOUNG cell around it
+ * neither changes nor draws, so it is skipped without a window, and skipping it leaves every row's
+ * draws in the same order as in the dense grid
+ *
+ * must be included after the cell states are defined and after fungi_hash.h
+ *
+*/
+
+#ifndef FUNGI_SPARSE_H
+#define FUNGI_SPARSE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define SPARSE_TILE 16  // rows and columns per tile
+
+// released tiles, ready to be reused
+struct tile_pool {
+    int *free;  // first released tile (each one's first bytes point at the next)
+    long allocated;  // tiles ever allocated (the most materialized at once)
+};
+
+// a grid stored as a directory of tiles
+struct sparse_grid {
+    int rows, columns;  // interior cells
+    int tile_rows, tile_columns;  // tiles down and across (the last ones may be cut short)
+    int **tiles;  // SPARSE_TILE * SPARSE_TILE cells per tile, row by row (NULL for an all-EMPTY tile)
+    struct tile_pool *pool;  // where tiles come from and go back to
+};
+
+/* pool_take() */
+/* returns a tile from the pool, allocating one if none is free (its cells are not cleared) */
+static inline int * pool_take(struct tile_pool * pool) {
+    int *tile = pool->free;
+    if (tile == NULL) {
+        pool->allocated++;
+        return new int[SPARSE_TILE * SPARSE_TILE];
+    }
+    pool->free = *(int **)tile;
+    return tile;
+}
+
+/* pool_give() */
+/* puts a tile back into the pool */
+static inline void pool_give(struct tile_pool * pool, int * tile) {
+    *(int **)tile = pool->free;
+    pool->free = tile;
+}
+
+/* pool_destroy() */
+/* frees every tile in the pool */
+void pool_destroy(struct tile_pool * pool) {
+    while (pool->free != NULL) {
+        delete [] pool_take(pool);
+    }
+}
+
+/* sparse_create() */
+/* allocates an all-EMPTY sparse grid (no tiles materialized) */
+struct sparse_grid * sparse_create(int * ROWS, int * COLUMNS, struct tile_pool * pool) {
+    struct sparse_grid *grid = new struct sparse_grid;
+    grid->rows = *ROWS;
+    grid->columns = *COLUMNS;
+    grid->tile_rows = ((*ROWS) + SPARSE_TILE - 1) / SPARSE_TILE;
+    grid->tile_columns = ((*COLUMNS) + SPARSE_TILE - 1) / SPARSE_TILE;
+    grid->tiles = new int*[(size_t)grid->tile_rows * grid->tile_columns]();
+    grid->pool = pool;
+    return grid;
+}
+
+/* sparse_tile() */
+/* returns the tile at a tile position, wrapping around the edges (NULL if it is all EMPTY) */
+static inline int * sparse_tile(struct sparse_grid * grid, int tile_row, int tile_column) {
+    if (tile_row < 0) { tile_row += grid->tile_rows; } else if (tile_row >= grid->tile_rows) { tile_row -= grid->tile_rows; }
+    if (tile_column < 0) { tile_column += grid->tile_columns; } else if (tile_column >= grid->tile_columns) { tile_column -= grid->tile_columns; }
+    return grid->tiles[(size_t)tile_row * grid->tile_columns + tile_column];
+}
+
+/* sparse_cell() */
+/* returns the state of a cell, with rows 0 and ROWS + 1 and columns 0 and COLUMNS + 1 wrapping around like ghost cells */
+static inline int sparse_cell(struct sparse_grid * grid, int current_row, int current_column) {
+    if (current_row < 1) { current_row += grid->rows; } else if (current_row > grid->rows) { current_row -= grid->rows; }
+    if (current_column < 1) { current_column += grid->columns; } else if (current_column > grid->columns) { current_column -= grid->columns; }
+    int *tile = grid->tiles[(size_t)((current_row - 1) / SPARSE_TILE) * grid->tile_columns + (current_column - 1) / SPARSE_TILE];
+    return (tile == NULL) ? EMPTY : tile[((current_row - 1) % SPARSE_TILE) * SPARSE_TILE + (current_column - 1) % SPARSE_TILE];
+}
+
+/* sparse_release() */
+/* makes a tile all EMPTY, returning its storage to the pool */
+static inline void sparse_release(struct sparse_grid * grid, int tile_row, int tile_column) {
+    int **tile = &grid->tiles[(size_t)tile_row * grid->tile_columns + tile_column];
+    if (*tile != NULL) {
+        pool_give(grid->pool, *tile);
+        *tile = NULL;
+    }
+}
+
+/* sparse_set_row() */
+/* stores one row of cells (row[1] to row[COLUMNS], as in the dense grid), materializing only the tiles it puts something other than EMPTY in */
+void sparse_set_row(struct sparse_grid * grid, int current_row, const int * row) {
+    int tile_row = (current_row - 1) / SPARSE_TILE;
+    int offset = ((current_row - 1) % SPARSE_TILE) * SPARSE_TILE;  // of the row within its tiles
+    for (int tile_column = 0; tile_column < grid->tile_columns; tile_column++) {  // for each tile the row crosses...
+        int first = tile_column * SPARSE_TILE + 1;
+        int width = (first + SPARSE_TILE - 1 <= grid->columns) ? SPARSE_TILE : grid->columns - first + 1;
+        int **tile = &grid->tiles[(size_t)tile_row * grid->tile_columns + tile_column];
+        if (*tile == NULL) {
+            int occupied = 0;  // nonzero if any cell isn't EMPTY (which is 0)
+            for (int column = first; column < first + width; column++) { occupied |= row[column]; }
+            if (occupied == 0) { continue; }  // ...it stays implicit
+            *tile = pool_take(grid->pool);
+            memset(*tile, 0, sizeof(int) * SPARSE_TILE * SPARSE_TILE);  // the rows not stored yet are EMPTY
+        }
+        memcpy(&(*tile)[offset], &row[first], sizeof(int) * width);
+    }
+}
+
+/* sparse_get_row() */
+/* copies one row of cells into row[1] to row[COLUMNS] */
+void sparse_get_row(struct sparse_grid * grid, int current_row, int * row) {
+    int tile_row = (current_row - 1) / SPARSE_TILE;
+    int offset = ((current_row - 1) % SPARSE_TILE) * SPARSE_TILE;
+    for (int tile_column = 0; tile_column < grid->tile_columns; tile_column++) {
+        int first = tile_column * SPARSE_TILE + 1;
+        int width = (first + SPARSE_TILE - 1 <= grid->columns) ? SPARSE_TILE : grid->columns - first + 1;
+        int *tile = grid->tiles[(size_t)tile_row * grid->tile_columns + tile_column];
+        if (tile == NULL) {
+            memset(&row[first], 0, sizeof(int) * width);
+        } else {
+            memcpy(&row[first], &tile[offset], sizeof(int) * width);
+        }
+    }
+}
+
+/* sparse_window() */
+/* fills a window with a tile and the ring of cells around it; returns 0 without filling the tile if the tile is all EMPTY and has no YOUNG cell around it, since then nothing in it can change */
+int sparse_window(struct sparse_grid * grid, int tile_row, int tile_column, int ***window) {
+    int first_row = tile_row * SPARSE_TILE + 1, first_column = tile_column * SPARSE_TILE + 1;
+    int height = (first_row + SPARSE_TILE - 1 <= grid->rows) ? SPARSE_TILE : grid->rows - first_row + 1;
+    int width = (first_column + SPARSE_TILE - 1 <= grid->columns) ? SPARSE_TILE : grid->columns - first_column + 1;
+    int *tile = sparse_tile(grid, tile_row, tile_column);
+
+    // an EMPTY tile in an EMPTY neighborhood
+    if (tile == NULL) {
+        int neighbors = 0;  // materialized tiles around it
+        for (int row_offset = -1; row_offset <= 1; row_offset++) {
+            for (int column_offset = -1; column_offset <= 1; column_offset++) {
+                if (sparse_tile(grid, tile_row + row_offset, tile_column + column_offset) != NULL) { neighbors++; }
+            }
+        }
+        if (neighbors == 0) { return 0; }
+    }
+
+    // the ring
+    for (int row = 0; row <= height + 1; row += height + 1) {  // top and bottom
+        for (int column = 0; column <= width + 1; column++) {
+            (*window)[row][column] = sparse_cell(grid, first_row - 1 + row, first_column - 1 + column);
+        }
+    }
+    for (int row = 1; row <= height; row++) {  // left and right
+        (*window)[row][0] = sparse_cell(grid, first_row - 1 + row, first_column - 1);
+        (*window)[row][width + 1] = sparse_cell(grid, first_row - 1 + row, first_column + width);
+    }
+
+    // the tile itself
+    if (tile == NULL) {
+        int young = 0;  // YOUNG cells in the ring
+        for (int column = 0; column <= width + 1; column++) { young += ((*window)[0][column] == YOUNG) + ((*window)[height + 1][column] == YOUNG); }
+        for (int row = 1; row <= height; row++) { young += ((*window)[row][0] == YOUNG) + ((*window)[row][width + 1] == YOUNG); }
+        if (young == 0) { return 0; }
+        for (int row = 1; row <= height; row++) { memset(&(*window)[row][1], 0, sizeof(int) * width); }
+    } else {
+        for (int row = 1; row <= height; row++) { memcpy(&(*window)[row][1], &tile[(row - 1) * SPARSE_TILE], sizeof(int) * width); }
+    }
+    return 1;
+}
+
+/* sparse_store() */
+/* stores the cells of an updated window as a tile, returning the tile to the pool instead if they are all EMPTY */
+void sparse_store(struct sparse_grid * grid, int tile_row, int tile_column, int ***window) {
+    int first_row = tile_row * SPARSE_TILE + 1, first_column = tile_column * SPARSE_TILE + 1;
+    int height = (first_row + SPARSE_TILE - 1 <= grid->rows) ? SPARSE_TILE : grid->rows - first_row + 1;
+    int width = (first_column + SPARSE_TILE - 1 <= grid->columns) ? SPARSE_TILE : grid->columns - first_column + 1;
+    int occupied = 0;  // nonzero if any cell isn't EMPTY (which is 0)
+    for (int row = 1; row <= height; row++) {
+        for (int column = 1; column <= width; column++) { occupied |= (*window)[row][column]; }
+    }
+    if (occupied == 0) {
+        sparse_release(grid, tile_row, tile_column);
+        return;
+    }
+    int **tile = &grid->tiles[(size_t)tile_row * grid->tile_columns + tile_column];
+    if (*tile == NULL) { *tile = pool_take(grid->pool); }
+    for (int row = 1; row <= height; row++) { memcpy(&(*tile)[(row - 1) * SPARSE_TILE], &(*window)[row][1], sizeof(int) * width); }
+}
+
+/* sparse_materialized() */
+/* returns the number of tiles a grid has materialized */
+long sparse_materialized(struct sparse_grid * grid) {
+    long count = 0;
+    for (size_t tile = 0; tile < (size_t)grid->tile_rows * grid->tile_columns; tile++) {
+        if (grid->tiles[tile] != NULL) { count++; }
+    }
+    return count;
+}
+
+/* report_sparse_hash() */
+/* prints the hash of a sparse grid at one time step to stderr, equal to grid_hash() of the same cells in a dense grid */
+void report_sparse_hash(struct sparse_grid * grid, int current_time_step) {
+    int *row = new int[grid->columns + 2];
+    unsigned long long hash = HASH_OFFSET;
+    for (int current_row = 1; current_row <= grid->rows; current_row++) {  // hash each row, then fold it in in order
+        sparse_get_row(grid, current_row, row);
+        unsigned long long row_hash = hash_bytes(HASH_OFFSET, (const unsigned char *)&row[1], sizeof(int) * grid->columns);
+        hash = hash_bytes(hash, (const unsigned char *)&row_hash, sizeof(unsigned long long));
+    }
+    delete [] row;
+    fprintf(stderr, "hash\t%d\t%016llx\n", current_time_step, hash);
+}
+
+/* sparse_destroy() */
+/* returns every tile of a sparse grid to its pool and frees the directory */
+void sparse_destroy(struct sparse_grid * grid) {
+    for (int tile_row = 0; tile_row < grid->tile_rows; tile_row++) {
+        for (int tile_column = 0; tile_column < grid->tile_columns; tile_column++) { sparse_release(grid, tile_row, tile_column); }
+    }
+    delete [] grid->tiles;
+    delete grid;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*******************************************************************************************
+ * fungi_steady.h
+ *******************************************************************************************
+ *
+ * extinction detection for the parallel engine (-d): while the update writes each new row, the
+ * thread that wrote it counts (while the row is still in cache) its YOUNG cells and its active
+ * cells, the ones that are neither EMPTY nor INERT; these per-step tallies drive two shortcuts
+ *      a grid with no YOUNG cell is quiet: no EMPTY cell has a YOUNG neighbor, so the update
+ *          skips check_neighbors() and keeps every EMPTY cell EMPTY (the cells that draw, and the
+ *          order they draw in, are the same, so the grids are too)
+ *      a grid with no active cell is extinct: only EMPTY and INERT cells are left, none of which
+ *          ever changes or draws again, so the run stops there (with -k, the final hash is printed
+ *          for every time step left, so the output matches a full run)
+ *
+ * a grid holding SPORE or DEPLETED cells is never treated as extinct, even long after the last
+ * hyphae died and whatever its hash did from one step to the next: a SPORE can still become YOUNG
+ * and a DEPLETED cell can still become a SPORE, so only the absorbing all-EMPTY state is safe to
+ * stop at
+ *
+ * must be included after the cell states are defined and after fungi_ensemble.h
+ *
+*/
+
+#ifndef FUNGI_STEADY_H
+#define FUNGI_STEADY_H
+
+#include <stdio.h>
+
+// per-step indicators of a run
+struct steady_tally {
+    long young, active;  // YOUNG cells, and cells neither EMPTY nor INERT, in the current grid
+    long next_young, next_active;  // the same in the next grid, counted as its rows are written
+};
+
+/* steady_start() */
+/* sets up the tally of a freshly initialized grid, which may hold any state if it came from a state raster (-m states:) */
+static inline void steady_start(struct steady_tally * tally) {
+    tally->young = 1;  // (not counted, so neither quiet nor extinct until the first update shows it)
+    tally->active = 1;
+    tally->next_young = 0;
+    tally->next_active = 0;
+}
+
+/* steady_count_row() */
+/* adds the YOUNG and active cells of one new row (row[1] to row[COLUMNS]) to a thread's own counts */
+static inline void steady_count_row(const int * row, int * COLUMNS, long * young, long * active) {
+    for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in the row...
+        (*young) += (row[current_column] == YOUNG);
+        (*active) += (row[current_column] != EMPTY && row[current_column] != INERT);
+    }
+}
+
+/* steady_add() */
+/* adds a thread's counts for the next grid to the tally (called inside a parallel region) */
+static inline void steady_add(struct steady_tally * tally, long young, long active) {
+    #pragma omp atomic
+    tally->next_young += young;
+    #pragma omp atomic
+    tally->next_active += active;
+}
+
+/* steady_advance() */
+/* makes the next grid's counts the current grid's once a time step is done */
+static inline void steady_advance(struct steady_tally * tally) {
+    tally->young = tally->next_young;
+    tally->active = tally->next_active;
+    tally->next_young = 0;
+    tally->next_active = 0;
+}
+
+/* steady_quiet() */
+/* returns 1 if the current grid has no YOUNG cell, otherwise 0 */
+static inline int steady_quiet(struct steady_tally * tally) {
+    return tally->young == 0;
+}
+
+/* steady_extinct() */
+/* returns 1 if the current grid holds only EMPTY and INERT cells, otherwise 0 */
+static inline int steady_extinct(struct steady_tally * tally) {
+    return tally->active == 0;
+}
+
+/* report_steady() */
+/* prints how many runs (replicas or points) died out before their last time step, and the time steps that saved, to stderr (prints nothing if none did) */
+void report_steady(struct replica_stats * stats, int runs, int * TIME_STEPS, const char * noun) {
+    int stopped = 0;  // runs that died out early
+    long skipped = 0;  // time steps they didn't simulate
+    for (int run = 0; run < runs; run++) {
+        if (stats[run].steps < (*TIME_STEPS)) {
+            stopped++;
+            skipped += (*TIME_STEPS) - stats[run].steps;
+        }
+    }
+    if (stopped > 0) {
+        fprintf(stderr, "steady: %d of %d %s died out early, skipping %ld of %ld time steps (%.1f%%)\n", stopped, runs, noun, skipped, (long)runs * (*TIME_STEPS), 100.0 * skipped / ((double)runs * (*TIME_STEPS)));
+    }
+}
+
+#endif
@@ -0,0 +1,66 @@
+/*******************************************************************************************
+ * fungi_streams.h
+ *******************************************************************************************
+ *
+ * deterministic random streams for the engines: every row of every time step draws from its own
+ * block of the seeded yarn2 sequence, so the grid a seed produces does not depend on the order the
+ * rows are visited in or on how many threads visit them
+ *
+ * a cell draws at most once per time step, so a block of COLUMNS draws per row is enough; row r
+ * of time step t starts at draw ((t + 1) * ROWS + r - 1) * COLUMNS of the sequence, where time
+ * step -1 is initializeGrid()
+ *
+ * jumping ahead in yarn2 costs a few dozen multiplications whatever the distance, so each row
+ * pays for one jump and then draws sequentially
+ *
+ * the update kernels take their draws from a row_draws buffer rather than from the engine: the
+ * buffer is refilled DRAW_BATCH draws at a time in a tight loop that keeps the engine's state in
+ * registers, and the kernel only reads the next entry; draws are used in the same order either
+ * way, so the buffer changes the cost of a draw but not the grids a seed produces (a refill may run
+ * past the end of the row's block, but those draws are never used)
+ *
+*/
+
+#ifndef FUNGI_STREAMS_H
+#define FUNGI_STREAMS_H
+
+#define INITIAL_STEP -1  // time step of the draws made by initializeGrid()
+#define DRAW_BATCH 32    // draws generated per refill of a row_draws buffer
+
+// a row's block of draws, generated a batch at a time
+struct row_draws {
+    trng::yarn2 stream;  // engine at the start of the next batch
+    unsigned long draws[DRAW_BATCH];  // the current batch
+    int next;  // index of the next unused draw (DRAW_BATCH when the batch is used up)
+};
+
+/* row_stream() */
+/* returns a copy of the seeded engine moved to the start of the block of draws for one row of one time step */
+static inline trng::yarn2 row_stream(trng::yarn2 * yarn, int * ROWS, int * COLUMNS, int time_step, int current_row) {
+    trng::yarn2 stream = *yarn;
+    stream.jump(((unsigned long long)(time_step + 1) * (*ROWS) + (current_row - 1)) * (*COLUMNS));
+    return stream;
+}
+
+/* row_draws_start() */
+/* points a draw buffer at the block of draws for one row of one time step */
+static inline void row_draws_start(struct row_draws * row, trng::yarn2 * yarn, int * ROWS, int * COLUMNS, int time_step, int current_row) {
+    row->stream = row_stream(yarn, ROWS, COLUMNS, time_step, current_row);
+    row->next = DRAW_BATCH;  // nothing generated yet
+}
+
+/* next_draw() */
+/* returns the next raw draw of a row, refilling the buffer when it runs out */
+static inline unsigned long next_draw(struct row_draws * row) {
+    if (row->next == DRAW_BATCH) {
+        trng::yarn2 stream = row->stream;  // local copy so the loop works in registers
+        for (int index = 0; index < DRAW_BATCH; index++) {
+            row->draws[index] = (unsigned long)stream();
+        }
+        row->stream = stream;
+        row->next = 0;
+    }
+    return row->draws[row->next++];
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*******************************************************************************************
+ * fungi_sweep.h
+ *******************************************************************************************
+ *
+ * parameter sweeps of the parallel engine (-w), which simulate every combination of a few
+ * transition probabilities in one process and report the final state of each in one table
+ *
+ * a sweep is a comma-separated list of name=start:stop:step ranges (or name=value for a single
+ * value) over the parameters of fungi_rules.h; the points are every combination of the ranges,
+ * numbered with the last range varying fastest, and the parameters that are not swept keep the
+ * values given by -p and -f (or the built-in ones)
+ *
+ * every point starts from the same initial grid, which initializeGrid() builds once and the points
+ * only read (each copies it into grids of its own before the first time step), and draws from the
+ * same seed, so two points differ only by their parameters; probSpore only shapes the initial grid,
+ * so it cannot be swept
+ *
+ * points are scheduled like ensemble replicas (see ensemble_split() in fungi_ensemble.h), and when
+ * they are all done each one's parameters, runtime, and final state fractions are reported to
+ * stderr, followed by the throughput in points per hour
+ *
+ * must be included after fungi_rules.h and fungi_ensemble.h
+ *
+*/
+
+#ifndef FUNGI_SWEEP_H
+#define FUNGI_SWEEP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SWEEP_MAX_POINTS 1000000  // most points one sweep may hold (each keeps a rule set and statistics of its own)
+
+// one swept parameter
+struct sweep_axis {
+    int rule;  // RULE_* index of the parameter
+    double start, step;  // first value and spacing
+    int count;  // number of values
+};
+
+// every swept parameter
+struct sweep {
+    struct sweep_axis axes[RULE_COUNT];
+    int axis_count;
+    int points;  // number of combinations
+    struct runtime_rules *point_rules;  // probabilities and thresholds of every point
+};
+
+/* sweep_parse() */
+/* reads a comma-separated list of name=start:stop:step ranges into a sweep; exits with a usage message if it is invalid */
+void sweep_parse(struct sweep * sweep, char * list, const char * program) {
+    sweep->axis_count = 0;
+    sweep->points = 1;
+    for (char *range = strtok(list, ","); range != NULL; range = strtok(NULL, ",")) {  // for each name=range...
+        struct sweep_axis *axis = &sweep->axes[sweep->axis_count];
+        char *equals = strchr(range, '=');
+        double stop;
+        int fields;
+        if (equals == NULL) {
+            fprintf(stderr, "Usage: %s -w sweep must be comma-separated name=start:stop:step ranges\n", program);
+            exit(EXIT_FAILURE);
+        }
+        *equals = '\0';
+        axis->rule = -1;
+        for (int rule = 0; rule < RULE_COUNT; rule++) {
+            if (strcmp(range, rule_names[rule]) == 0) { axis->rule = rule; }
+        }
+        if (axis->rule < 0) {
+            fprintf(stderr, "Usage: %s -w unknown parameter %s (known: probSporeToYoung, probSpread, probMaturingToMushrooms, probDepletedToSpore, probDepletedToEmpty)\n", program, range);
+            exit(EXIT_FAILURE);
+        }
+        if (axis->rule == RULE_SPORE) {
+            fprintf(stderr, "Usage: %s -w probSpore cannot be swept (every point starts from the same initial grid)\n", program);
+            exit(EXIT_FAILURE);
+        }
+        for (int other = 0; other < sweep->axis_count; other++) {
+            if (sweep->axes[other].rule == axis->rule) {
+                fprintf(stderr, "Usage: %s -w %s is swept more than once\n", program, range);
+                exit(EXIT_FAILURE);
+            }
+        }
+        fields = sscanf(equals + 1, "%lf:%lf:%lf", &axis->start, &stop, &axis->step);
+        if (fields == 1) {  // a single value
+            stop = axis->start;
+            axis->step = 1.0;
+        } else if (fields != 3 || axis->step <= 0.0 || stop < axis->start) {
+            fprintf(stderr, "Usage: %s -w %s must be start:stop:step with start <= stop and step > 0\n", program, range);
+            exit(EXIT_FAILURE);
+        }
+        if (axis->start < 0.0 || stop > 1.0) {
+            fprintf(stderr, "Usage: %s -w %s must stay between 0 and 1\n", program, range);
+            exit(EXIT_FAILURE);
+        }
+        double values = floor((stop - axis->start) / axis->step + 1e-9) + 1;  // the tolerance keeps stop itself in despite rounding
+        if (values * sweep->points > SWEEP_MAX_POINTS) {  // (checked in double, before any int can overflow)
+            fprintf(stderr, "Usage: %s -w sweep has more than %d points (use larger steps or fewer ranges)\n", program, SWEEP_MAX_POINTS);
+            exit(EXIT_FAILURE);
+        }
+        axis->count = (int)values;
+        sweep->points *= axis->count;
+        sweep->axis_count++;
+    }
+}
+
+/* sweep_points() */
+/* fills in the probabilities and thresholds of every point of the sweep, starting from the base probabilities; exits with a usage message if a point is invalid */
+void sweep_points(struct sweep * sweep, struct runtime_rules * base, const char * program) {
+    sweep->point_rules = new struct runtime_rules[sweep->points];
+    for (int point = 0; point < sweep->points; point++) {
+        struct runtime_rules *rules = &sweep->point_rules[point];
+        int remaining = point;
+        *rules = *base;
+        for (int axis = sweep->axis_count - 1; axis >= 0; axis--) {  // the last range varies fastest
+            int index = remaining % sweep->axes[axis].count;
+            remaining /= sweep->axes[axis].count;
+            rules->probabilities[sweep->axes[axis].rule] = sweep->axes[axis].start + index * sweep->axes[axis].step;
+        }
+        rules_finish(rules, program);
+    }
+}
+
+/* report_sweep() */
+/* prints every point's parameters and final state fractions, and the throughput, to stderr */
+void report_sweep(struct sweep * sweep, struct replica_stats * stats, int * ROWS, int * COLUMNS, int * TIME_STEPS, int groups, int inner_threads, double total_time) {
+    double cells = (double)(*ROWS) * (*COLUMNS);
+
+    fprintf(stderr, "\nsweep: %d points of %d x %d for %d time steps from seed %ld, %d at a time with %d thread(s) each\n", sweep->points, *ROWS, *COLUMNS, *TIME_STEPS, stats[0].seed, groups, inner_threads);
+    fprintf(stderr, "point");
+    for (int axis = 0; axis < sweep->axis_count; axis++) { fprintf(stderr, "\t%s", rule_names[sweep->axes[axis].rule]); }
+    fprintf(stderr, "\truntime");
+    for (int state = 0; state < CENSUS_STATES; state++) { fprintf(stderr, "\t%s", census_names[state]); }
+    fprintf(stderr, "\n");
+
+    for (int point = 0; point < sweep->points; point++) {
+        fprintf(stderr, "%d", point);
+        for (int axis = 0; axis < sweep->axis_count; axis++) { fprintf(stderr, "\t%g", sweep->point_rules[point].probabilities[sweep->axes[axis].rule]); }
+        fprintf(stderr, "\t%.6f", stats[point].runtime);
+        for (int state = 0; state < CENSUS_STATES; state++) { fprintf(stderr, "\t%.6f", stats[point].counts[state] / cells); }
+        fprintf(stderr, "\n");
+    }
+
+    fprintf(stderr, "throughput: %.1f points per hour (%.3e cell updates per second)\n", sweep->points * 3600.0 / total_time, sweep->points * cells * ((*TIME_STEPS) + 1) / total_time);
+}
+
+#endif
@@ -0,0 +1,167 @@
+/*******************************************************************************************
+ * fungi_terrain.h
+ *******************************************************************************************
+ *
+ * terrain masks for the engines (-m FILE): a raster of the site, one byte per cell, in which every
+ * nonzero byte marks an INERT cell (a road, a rock, a building) where nothing can grow
+ *
+ * the file is either raw bytes (exactly ROWS * COLUMNS of them, row by row, whatever they start with)
+ * or a binary PGM (P5, COLUMNS wide, ROWS high, maxval below 256); it is memory-mapped rather than read, and
+ * terrain_apply() copies the INERT cells straight from the mapped pages into the grid, rows in
+ * parallel when built with OpenMP, so multi-GB maps are paged in once with no intermediate copy;
+ * terrain_open() maps any raster in these formats, so other per-cell maps (fungi_soil.h) load the
+ * same way
+ *
+ * the mask is applied over the initial grid, so cells off the mask start as SPORE with probability
+ * probSpore just as before; INERT cells never change, never draw, and are never a YOUNG neighbor, so
+ * the kernels pass over them with a single store
+ *
+ * with -m states:FILE the raster is a whole initial grid instead: every byte is the state (EMPTY to
+ * INERT, 0 to 10) its cell starts in, replacing the random SPOREs; the bytes are checked once when the
+ * file is opened, and applied through the same row copy, so every grid layout loads them the same way
+ *
+ * must be included after the cell states are defined
+ *
+*/
+
+#ifndef FUNGI_TERRAIN_H
+#define FUNGI_TERRAIN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// a mapped terrain mask
+struct terrain {
+    unsigned char *map;  // the whole mapped file
+    size_t length;  // bytes mapped
+    const unsigned char *cells;  // first cell of the raster (past any header)
+    int maxval;  // largest value a cell can hold (255 for raw bytes)
+    int states;  // 1 if every byte is a cell state (-m states:FILE), 0 if nonzero bytes mark INERT cells
+};
+
+// prefix of a -m argument naming a raster of initial cell states rather than an INERT mask
+#define TERRAIN_STATES "states:"
+
+/* pgm_number() */
+/* reads one header number of a PGM file, skipping whitespace and # comments; returns -1 if there is none */
+static long pgm_number(const unsigned char * map, size_t length, size_t * position) {
+    long value = -1;
+    while (*position < length && (isspace(map[*position]) || map[*position] == '#')) {
+        if (map[*position] == '#') {  // comments run to the end of the line
+            while (*position < length && map[*position] != '\n') { (*position)++; }
+        } else {
+            (*position)++;
+        }
+    }
+    while (*position < length && isdigit(map[*position])) {
+        value = ((value < 0) ? 0 : value * 10) + (map[*position] - '0');
+        (*position)++;
+    }
+    return value;
+}
+
+/* terrain_open() */
+/* maps a raster given with an option and checks that it fits the grid; exits with a usage message if it doesn't */
+struct terrain * terrain_open(const char * path, int * ROWS, int * COLUMNS, const char * option, const char * program) {
+    struct terrain *terrain = new struct terrain;
+    size_t cells = (size_t)(*ROWS) * (*COLUMNS);
+    struct stat status;
+    int file = open(path, O_RDONLY);
+    if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0) {
+        fprintf(stderr, "Usage: %s %s could not open raster %s\n", program, option, path);
+        exit(EXIT_FAILURE);
+    }
+    terrain->length = (size_t)status.st_size;
+    terrain->map = (unsigned char *)mmap(NULL, terrain->length, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);  // the mapping keeps the file open
+    if (terrain->map == MAP_FAILED) {
+        fprintf(stderr, "Usage: %s %s could not map raster %s\n", program, option, path);
+        exit(EXIT_FAILURE);
+    }
+    madvise(terrain->map, terrain->length, MADV_SEQUENTIAL);  // read once, front to back
+
+    // a file of exactly one byte per cell is raw, even if its first bytes happen to read "P5"
+    if (terrain->length != cells && terrain->length >= 2 && terrain->map[0] == 'P' && terrain->map[1] == '5') {  // binary PGM
+        size_t position = 2;
+        long width = pgm_number(terrain->map, terrain->length, &position);
+        long height = pgm_number(terrain->map, terrain->length, &position);
+        long maxval = pgm_number(terrain->map, terrain->length, &position);
+        if (position >= terrain->length) {  // the file ends inside the header
+            fprintf(stderr, "Usage: %s %s raster %s is a PGM with no cells after its header\n", program, option, path);
+            exit(EXIT_FAILURE);
+        }
+        position++;  // a single whitespace byte ends the header
+        if (width != (*COLUMNS) || height != (*ROWS) || maxval < 1 || maxval > 255 || cells > terrain->length - position) {
+            fprintf(stderr, "Usage: %s %s raster %s must be a %d x %d PGM with maxval below 256\n", program, option, path, *COLUMNS, *ROWS);
+            exit(EXIT_FAILURE);
+        }
+        terrain->cells = terrain->map + position;
+        terrain->maxval = (int)maxval;
+    } else {  // raw bytes
+        if (terrain->length != cells) {
+            fprintf(stderr, "Usage: %s %s raster %s must hold %zu bytes (one per cell) or be a PGM\n", program, option, path, cells);
+            exit(EXIT_FAILURE);
+        }
+        terrain->cells = terrain->map;
+        terrain->maxval = 255;
+    }
+    terrain->states = 0;
+    return terrain;
+}
+
+/* terrain_open_mask() */
+/* maps the raster given with -m, either an INERT mask or (after the states: prefix) the cell states of the initial grid; exits with a usage message if it doesn't fit the grid or holds a byte that is no cell state */
+struct terrain * terrain_open_mask(const char * argument, int * ROWS, int * COLUMNS, const char * program) {
+    size_t prefix = strlen(TERRAIN_STATES);
+    if (strncmp(argument, TERRAIN_STATES, prefix) != 0) { return terrain_open(argument, ROWS, COLUMNS, "-m", program); }
+
+    struct terrain *terrain = terrain_open(argument + prefix, ROWS, COLUMNS, "-m", program);
+    size_t cells = (size_t)(*ROWS) * (*COLUMNS);
+    size_t invalid = 0;  // bytes above INERT
+    #pragma omp parallel for reduction(+:invalid)
+    for (size_t cell = 0; cell < cells; cell++) { invalid += (terrain->cells[cell] > INERT); }
+    if (invalid > 0) {
+        fprintf(stderr, "Usage: %s -m state raster %s holds %zu bytes that are no cell state (0 to %d)\n", program, argument + prefix, invalid, INERT);
+        exit(EXIT_FAILURE);
+    }
+    terrain->states = 1;
+    return terrain;
+}
+
+/* terrain_apply_row() */
+/* makes every cell of one row (row[1] to row[COLUMNS]) that the mask marks INERT, or with a state raster sets every cell of it to its state */
+static inline void terrain_apply_row(struct terrain * terrain, int * row, int current_row, int * COLUMNS) {
+    const unsigned char *mask = terrain->cells + (size_t)(current_row - 1) * (*COLUMNS);
+    if (terrain->states) {
+        for (int current_column = 1; current_column <= (*COLUMNS); current_column++) { row[current_column] = mask[current_column - 1]; }
+        return;
+    }
+    for (int current_column = 1; current_column <= (*COLUMNS); current_column++) {  // for each cell in that row...
+        if (mask[current_column - 1] != 0) { row[current_column] = INERT; }
+    }
+}
+
+/* terrain_apply() */
+/* makes every cell the mask marks INERT (or sets every cell to its state from a state raster) */
+void terrain_apply(struct terrain * terrain, int ***grid, int * ROWS, int * COLUMNS) {
+    #pragma omp parallel for
+    for (int current_row = 1; current_row <= (*ROWS); current_row++) {  // for each row in the grid...
+        terrain_apply_row(terrain, (*grid)[current_row], current_row, COLUMNS);
+    }
+}
+
+/* terrain_close() */
+/* unmaps a raster (does nothing if there is none) */
+void terrain_close(struct terrain * terrain) {
+    if (terrain == NULL) { return; }
+    munmap(terrain->map, terrain->length);
+    delete terrain;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*******************************************************************************************
+ * fungi_trace.h
+ *******************************************************************************************
+ *
+ * opt-in timeline tracing of the phases of mushrooms(), written at exit as Chrome trace-event
+ * JSON (open it at ui.perfetto.dev or chrome://tracing)
+ *
+ * build with -DTRACE; each thread records one span per parallel region it works in (its tile of
+ * the loop) and one span for the time it then waits at the region's barrier, so stragglers and
+ * barrier waits are visible thread by thread
+ *
+ * spans go into a ring buffer per thread that is allocated up front, so recording a span is two
+ * clock reads and a store; if a run records more than TRACE_SPANS spans on a thread, only the
+ * most recent ones are kept
+ *
+ * the phase hooks in fungi_profile.h call in here, so the engines need no hooks of their own
+ *
+*/
+
+#ifndef FUNGI_TRACE_H
+#define FUNGI_TRACE_H
+
+#ifdef TRACE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+// spans kept per thread (the most recent ones win)
+#define TRACE_SPANS (1 << 18)
+
+// file the trace is written to
+#define TRACE_FILE "fungi-trace.json"
+
+// kinds of span
+#define SPAN_WORK 0  // a thread working on its tile of a phase
+#define SPAN_WAIT 1  // a thread waiting at a phase's barrier
+
+// one recorded span
+struct trace_span {
+    long long start;  // nanoseconds since tracing started
+    long long end;  // nanoseconds since tracing started
+    short phase;  // phase of the time step (see fungi_profile.h)
+    short kind;  // SPAN_WORK or SPAN_WAIT
+};
+
+// one thread's ring buffer, padded so threads don't share cache lines
+struct trace_ring {
+    struct trace_span * spans;  // TRACE_SPANS spans
+    long long recorded;  // spans recorded so far (the ring holds the last TRACE_SPANS)
+    long long started;  // start of the current span
+    long long finished;  // end of the current phase's work
+    char padding[64];
+};
+
+// all threads' buffers
+struct trace_ring * trace_rings = NULL;
+int trace_threads = 0;
+long long trace_origin = 0;  // clock reading that is time zero in the trace
+
+const char * trace_phase_names[] = { "ghost rows", "ghost columns", "update", "copy", "output" };
+
+/* trace_thread() */
+/* returns the calling thread's ring index */
+static inline int trace_thread() {
+    #ifdef _OPENMP
+        return omp_get_thread_num();
+    #else
+        return 0;
+    #endif
+}
+
+/* trace_clock() */
+/* returns the monotonic clock in nanoseconds since tracing started */
+static inline long long trace_clock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec - trace_origin;
+}
+
+/* trace_record() */
+/* stores a span in the calling thread's ring */
+static inline void trace_record(struct trace_ring * ring, int phase, int kind, long long start, long long end) {
+    struct trace_span * span = &ring->spans[ring->recorded % TRACE_SPANS];
+    span->start = start;
+    span->end = end;
+    span->phase = (short)phase;
+    span->kind = (short)kind;
+    ring->recorded++;
+}
+
+/* trace_init() */
+/* allocates every thread's ring (each thread touches its own, so it lands in that thread's memory) */
+void trace_init() {
+    trace_threads = 1;
+    #ifdef _OPENMP
+        trace_threads = omp_get_max_threads();
+    #endif
+    trace_rings = new struct trace_ring[trace_threads];
+    memset(trace_rings, 0, sizeof(struct trace_ring) * trace_threads);
+    #pragma omp parallel num_threads(trace_threads)
+    {
+        struct trace_ring * ring = &trace_rings[trace_thread()];
+        ring->spans = new struct trace_span[TRACE_SPANS];
+        memset(ring->spans, 0, sizeof(struct trace_span) * TRACE_SPANS);
+    }
+    trace_origin = trace_clock();
+}
+
+/* trace_begin() */
+/* marks the start of the calling thread's work in a phase */
+static inline void trace_begin(int phase) {
+    trace_rings[trace_thread()].started = trace_clock();
+    (void)phase;
+}
+
+/* trace_work_done() */
+/* records the calling thread's work span for a phase */
+static inline void trace_work_done(int phase) {
+    struct trace_ring * ring = &trace_rings[trace_thread()];
+    ring->finished = trace_clock();
+    trace_record(ring, phase, SPAN_WORK, ring->started, ring->finished);
+}
+
+/* trace_end() */
+/* records the calling thread's wait span at a phase's barrier */
+static inline void trace_end(int phase) {
+    struct trace_ring * ring = &trace_rings[trace_thread()];
+    trace_record(ring, phase, SPAN_WAIT, ring->finished, trace_clock());
+}
+
+/* trace_write() */
+/* writes every thread's spans to TRACE_FILE as Chrome trace-event JSON and frees the rings */
+void trace_write() {
+    FILE * file = fopen(TRACE_FILE, "w");
+    if (file == NULL) {
+        fprintf(stderr, "trace: could not open %s for writing\n", TRACE_FILE);
+        return;
+    }
+    long long dropped = 0;  // spans overwritten in full rings
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"fungi\"}}");
+    for (int thread = 0; thread < trace_threads; thread++) {
+        struct trace_ring * ring = &trace_rings[thread];
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", thread, thread);
+
+        // oldest span first
+        long long first = (ring->recorded > TRACE_SPANS) ? ring->recorded - TRACE_SPANS : 0;
+        dropped += first;
+        for (long long i = first; i < ring->recorded; i++) {
+            struct trace_span * span = &ring->spans[i % TRACE_SPANS];
+            fprintf(file, ",\n{\"name\":\"%s%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    (span->kind == SPAN_WAIT) ? "barrier: " : "", trace_phase_names[span->phase], (span->kind == SPAN_WAIT) ? "wait" : "work",
+                    thread, span->start / 1000.0, (span->end - span->start) / 1000.0);
+        }
+        delete [] ring->spans;
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    delete [] trace_rings;
+
+    fprintf(stderr, "trace: wrote %s", TRACE_FILE);
+    if (dropped > 0) { fprintf(stderr, " (oldest %lld spans dropped; raise TRACE_SPANS to keep them)", dropped); }
+    fprintf(stderr, "\n");
+}
+
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+/*******************************************************************************************
+ * fungi_tune.h
+ *******************************************************************************************
+ *
+ * auto-tuning of the parallel engine (-a FILE): the thread count, the schedule of the update's
+ * row loop, and the layout (a current and a next grid, or one grid updated in place) that run a
+ * grid fastest on a machine, picked by timing a few time steps of each candidate and kept in a
+ * cache file so that later runs of the same shape on the same machine start with them at once
+ *
+ * the candidates are tried greedily, since the timings of one machine are smooth in each setting
+ *      thread counts 1, 2, 4, ... up to the processors available (and that count itself), with a
+ *          static schedule and two grids, stopping once a count is TUNE_WORSE times slower than
+ *          the fastest so far (past the point where the grid is too small for more threads)
+ *      schedules dynamic and guided at the fastest thread count
+ *      the in-place layout at the fastest thread count (it splits rows into fixed bands, so it
+ *          has no schedule of its own)
+ * and each is timed TUNE_REPEATS times over TUNE_STEPS time steps of a scratch grid of the run's
+ * size, keeping its fastest time; none of the settings changes what a seed simulates (every row
+ * draws from its own block), so the tuned run prints the same grids as any other
+ *
+ * the cache holds one tab-separated line per tuned shape: the machine (host name and processor
+ * count), rows, columns, threads, schedule, chunk, layout (1 in place, 0 two grids), and seconds
+ * per time step; the last line for a shape wins, so deleting the file (or its lines) retunes
+ *
+*/
+
+#ifndef FUNGI_TUNE_H
+#define FUNGI_TUNE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#define TUNE_STEPS 4       // time steps per timing (plus the one mushrooms() always adds)
+#define TUNE_REPEATS 2     // timings per candidate (the fastest is kept)
+#define TUNE_WORSE 1.25    // slowdown past the fastest thread count that ends the thread search
+#define TUNE_SEED 12345    // seed of the scratch grid
+#define TUNE_MACHINE 128   // longest machine name kept
+
+// one configuration of the engine
+struct tune_config {
+    int threads;
+    omp_sched_t schedule;  // of the update's row loop
+    int chunk;  // rows per chunk (0 for the schedule's default)
+    int in_place;  // update one grid in place (1) or a current and a next grid (0)
+    double seconds;  // per time step, as timed
+};
+
+/* tune_machine() */
+/* writes the name of this machine, its host name and processor count, as the cache keys it */
+void tune_machine(char * machine) {
+    char host[TUNE_MACHINE / 2];
+    if (gethostname(host, sizeof(host)) != 0) { strcpy(host, "unknown"); }
+    host[sizeof(host) - 1] = '\0';
+    snprintf(machine, TUNE_MACHINE, "%s/%d", host, omp_get_num_procs());
+}
+
+/* tune_schedule_name() */
+/* returns the name of a schedule, as the cache stores it */
+const char * tune_schedule_name(omp_sched_t schedule) {
+    switch (schedule) {
+        case omp_sched_dynamic: return "dynamic";
+        case omp_sched_guided: return "guided";
+        default: return "static";
+    }
+}
+
+/* tune_lookup() */
+/* finds the configuration cached for this machine and grid shape; returns 1 if there is one, otherwise 0 */
+int tune_lookup(const char * path, int * ROWS, int * COLUMNS, struct tune_config * config) {
+    char machine[TUNE_MACHINE], line_machine[TUNE_MACHINE], schedule[16], line[512];
+    int rows, columns, found = 0;
+    struct tune_config entry;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) { return 0; }  // nothing tuned yet
+    tune_machine(machine);
+    while (fgets(line, sizeof(line), file) != NULL) {  // for each cached shape... (the last match wins)
+        if (line[0] == '#') { continue; }
+        if (sscanf(line, "%127[^\t]\t%d\t%d\t%d\t%15s\t%d\t%d\t%lf", line_machine, &rows, &columns, &entry.threads, schedule, &entry.chunk, &entry.in_place, &entry.seconds) != 8) { continue; }
+        if (strcmp(line_machine, machine) != 0 || rows != (*ROWS) || columns != (*COLUMNS) || entry.threads < 1) { continue; }
+        entry.schedule = (strcmp(schedule, "dynamic") == 0) ? omp_sched_dynamic : (strcmp(schedule, "guided") == 0) ? omp_sched_guided : omp_sched_static;
+        *config = entry;
+        found = 1;
+    }
+    fclose(file);
+    return found;
+}
+
+/* tune_store() */
+/* appends the configuration tuned for this machine and grid shape to the cache (with a header if the cache is new); warns if it can't */
+void tune_store(const char * path, int * ROWS, int * COLUMNS, struct tune_config * config) {
+    char machine[TUNE_MACHINE];
+    FILE *file = fopen(path, "a");
+    if (file == NULL) {
+        fprintf(stderr, "tune: could not write %s, so the next run will tune again\n", path);
+        return;
+    }
+    tune_machine(machine);
+    if (ftell(file) == 0) { fprintf(file, "# machine\trows\tcolumns\tthreads\tschedule\tchunk\tin place\tseconds per step\n"); }
+    fprintf(file, "%s\t%d\t%d\t%d\t%s\t%d\t%d\t%.6f\n", machine, (*ROWS), (*COLUMNS), config->threads, tune_schedule_name(config->schedule), config->chunk, config->in_place, config->seconds);
+    fclose(file);
+}
+
+/* report_tune() */
+/* prints the configuration a run uses to stderr, and how it was found */
+void report_tune(struct tune_config * config, const char * path, int trials, double seconds) {
+    fprintf(stderr, "tune: %d threads, %s schedule", config->threads, tune_schedule_name(config->schedule));
+    if (config->chunk > 0) { fprintf(stderr, " (%d rows per chunk)", config->chunk); }
+    fprintf(stderr, ", %s, %.6f s per time step", config->in_place ? "in place" : "two grids", config->seconds);
+    if (trials > 0) {
+        fprintf(stderr, " (tuned in %.2f s over %d candidates, cached in %s)\n", seconds, trials, path);
+    } else {
+        fprintf(stderr, " (cached in %s)\n", path);
+    }
+}
+
+#endif